@@ -0,0 +1,344 @@
+#include "getopt.hpp"
+
+#include <algorithm> // min
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <fcntl.h> // NOLINT
+#include <sys/epoll.h> // NOLINT
+#include <sys/socket.h> // NOLINT
+#include <sys/stat.h> // NOLINT
+#include <sys/un.h> // NOLINT sockaddr_un
+#include <unistd.h> // NOLINT
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void onSignal(int /* signal */)
+{
+  g_stop = 1;
+}
+
+void showHelp()
+{
+  std::cout <<
+    "bcollect -- collect binlog streams of local processes\n"
+    "\n"
+    "Synopsis:\n"
+    "  bcollect [-d directory] socketpath\n"
+    "\n"
+    "Arguments:\n"
+    "  socketpath     Path of the UNIX domain socket to listen on\n"
+    "\n"
+    "Options:\n"
+    "  -d directory   Write the received logfiles to this directory (default: .)\n"
+    "  -h             Show this help\n"
+    "\n"
+    "Notes:\n"
+    "  Producers connect using binlog::UnixSocketOutputStream.\n"
+    "  The stream of each connection is written to a separate file,\n"
+    "  named after the process id of the producer and a connection counter:\n"
+    "  <directory>/<pid>-<counter>.blog. Each file is readable by bread.\n"
+    "  Streams of different processes are not merged into a single file,\n"
+    "  as their event source ids are independent.\n"
+    "\n"
+    "  Data is moved from the sockets to the files by splice, where possible.\n"
+    "  If the files cannot be written fast enough, the producers\n"
+    "  buffer, then drop data, without blocking their writers.\n"
+    "\n"
+    "  bcollect stops on SIGINT or SIGTERM, and removes the socket.\n"
+    "\n"
+    "Report bugs to:\n"
+    "  https://github.com/Morgan-Stanley/binlog/issues\n";
+}
+
+/** A connected producer, whose stream is written to a file */
+class Producer
+{
+public:
+  Producer(int socket, int file)
+    :_socket(socket),
+     _file(file)
+  {
+    if (::pipe2(_pipe.data(), O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      _pipe = {{-1, -1}};
+      _splice = false;
+    }
+  }
+
+  ~Producer()
+  {
+    ::close(_socket);
+    ::close(_file);
+    if (_pipe[0] >= 0) { ::close(_pipe[0]); }
+    if (_pipe[1] >= 0) { ::close(_pipe[1]); }
+  }
+
+  Producer(const Producer&) = delete;
+  void operator=(const Producer&) = delete;
+
+  Producer(Producer&&) = delete;
+  void operator=(Producer&&) = delete;
+
+  /**
+   * Move the available data of the socket to the file,
+   * at most a few chunks, to not starve other producers.
+   *
+   * @returns false if the producer disconnected, or the data cannot be written
+   */
+  bool transfer()
+  {
+    for (int i = 0; i < 16; ++i)
+    {
+      const ssize_t size = (_splice) ? spliceChunk() : copyChunk();
+      if (size == 0) { return false; } // disconnected
+      if (size < 0)
+      {
+        if (errno == EINTR) { continue; }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) { return true; }
+        return false;
+      }
+    }
+
+    return true; // epoll reports the rest again
+  }
+
+private:
+  // socket -> pipe -> file, without copying the data to userspace
+  ssize_t spliceChunk()
+  {
+    const ssize_t size = ::splice(_socket, nullptr, _pipe[1], nullptr, _chunk.size(), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (size <= 0) { return size; }
+
+    for (ssize_t left = size; left > 0;)
+    {
+      const ssize_t written = ::splice(_pipe[0], nullptr, _file, nullptr, std::size_t(left), SPLICE_F_MOVE);
+      if (written < 0 && errno == EINTR) { continue; }
+      if (written < 0 && errno == EINVAL)
+      {
+        // the file system does not support splice, copy the rest
+        _splice = false;
+        return copyPipe(left) ? size : -1;
+      }
+      if (written <= 0)
+      {
+        errno = EIO;
+        return -1;
+      }
+      left -= written;
+    }
+
+    return size;
+  }
+
+  // copy `size` bytes from the pipe to the file, returns false on error
+  bool copyPipe(ssize_t size)
+  {
+    while (size > 0)
+    {
+      const ssize_t readSize = ::read(_pipe[0], _chunk.data(), std::min(_chunk.size(), std::size_t(size)));
+      if (readSize < 0 && errno == EINTR) { continue; }
+      if (readSize <= 0 || ! writeFile(readSize)) { return false; }
+      size -= readSize;
+    }
+    return true;
+  }
+
+  // write the first `size` bytes of _chunk to the file, returns false on error
+  bool writeFile(ssize_t size)
+  {
+    for (ssize_t done = 0; done < size;)
+    {
+      const ssize_t written = ::write(_file, _chunk.data() + done, std::size_t(size - done));
+      if (written < 0 && errno == EINTR) { continue; }
+      if (written <= 0) { return false; }
+      done += written;
+    }
+    return true;
+  }
+
+  ssize_t copyChunk()
+  {
+    const ssize_t size = ::read(_socket, _chunk.data(), _chunk.size());
+    if (size <= 0) { return size; }
+
+    if (! writeFile(size))
+    {
+      errno = EIO;
+      return -1;
+    }
+
+    return size;
+  }
+
+  int _socket;
+  int _file;
+  std::array<int, 2> _pipe{{-1, -1}};
+  bool _splice = true;
+  std::array<char, 1 << 16> _chunk{}; /**< Used if splice is not available */
+};
+
+int listenOn(const std::string& path)
+{
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path))
+  {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, path.data(), path.size());
+
+  // remove the socket left behind by a previous run, but nothing else
+  struct stat st{};
+  if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+  {
+    ::unlink(path.c_str());
+  }
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) { return -1; }
+
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+   || ::listen(fd, SOMAXCONN) != 0)
+  {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    return -1;
+  }
+
+  return fd;
+}
+
+pid_t peerPid(int socket)
+{
+  ucred credentials{};
+  socklen_t size = sizeof(credentials);
+  if (::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0) { return 0; }
+  return credentials.pid;
+}
+
+} // namespace
+
+int main(int argc, /*const*/ char* argv[])
+{
+  std::string directory = ".";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd':
+      directory = optarg;
+      break;
+    case 'h':
+      showHelp();
+      return 0;
+    default:
+      // getopt prints a useful error message by default (opterr is set)
+      showHelp();
+      return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    showHelp();
+    return 1;
+  }
+  const std::string socketPath = argv[optind];
+
+  struct sigaction action{};
+  action.sa_handler = onSignal; // no SA_RESTART: interrupt epoll_wait
+  sigemptyset(&action.sa_mask);
+  ::sigaction(SIGINT, &action, nullptr);
+  ::sigaction(SIGTERM, &action, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const int listener = listenOn(socketPath);
+  if (listener < 0)
+  {
+    std::cerr << "[bcollect] Failed to listen on '" << socketPath << "': " << std::strerror(errno) << "\n";
+    return 2;
+  }
+
+  const int epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  epoll_event listenEvent{};
+  listenEvent.events = EPOLLIN;
+  listenEvent.data.fd = listener;
+  if (epoll < 0 || ::epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &listenEvent) != 0)
+  {
+    std::cerr << "[bcollect] Failed to create epoll instance: " << std::strerror(errno) << "\n";
+    return 2;
+  }
+
+  std::map<int, std::unique_ptr<Producer>> producers; // by socket
+  unsigned long connectionCount = 0;
+
+  std::array<epoll_event, 64> events{};
+  while (g_stop == 0)
+  {
+    const int eventCount = ::epoll_wait(epoll, events.data(), int(events.size()), -1);
+    if (eventCount < 0)
+    {
+      if (errno == EINTR) { continue; }
+      std::cerr << "[bcollect] Failed to wait for events: " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    for (int i = 0; i < eventCount; ++i)
+    {
+      const int fd = events[std::size_t(i)].data.fd;
+
+      if (fd == listener)
+      {
+        const int socket = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) { continue; }
+
+        const std::string path = directory + "/" + std::to_string(peerPid(socket))
+          + "-" + std::to_string(++connectionCount) + ".blog";
+        const int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0)
+        {
+          std::cerr << "[bcollect] Failed to open '" << path << "' for writing: " << std::strerror(errno) << "\n";
+          ::close(socket);
+          continue;
+        }
+
+        epoll_event producerEvent{};
+        producerEvent.events = EPOLLIN | EPOLLRDHUP;
+        producerEvent.data.fd = socket;
+        producers[socket].reset(new Producer(socket, file));
+        ::epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &producerEvent);
+        std::cerr << "[bcollect] Writing '" << path << "'\n";
+      }
+      else
+      {
+        auto it = producers.find(fd);
+        if (it != producers.end() && ! it->second->transfer())
+        {
+          ::epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+          producers.erase(it);
+        }
+      }
+    }
+  }
+
+  producers.clear();
+  ::close(epoll);
+  ::close(listener);
+  ::unlink(socketPath.c_str());
+
+  return 0;
+}
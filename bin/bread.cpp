@@ -1,6 +1,11 @@
 #include "getopt.hpp"
 #include "printers.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -21,19 +26,46 @@ std::istream& openFile(const std::string& path, std::ifstream& file)
   return file;
 }
 
+// days since 1970-01-01 of the given date of the proleptic Gregorian calendar
+std::int64_t daysFromCivil(int y, int m, int d)
+{
+  y -= (m <= 2) ? 1 : 0;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const int yoe = y - era * 400;
+  const int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return std::int64_t(era) * 146097 + doe - 719468;
+}
+
+// parse "YYYY-MM-DD HH:MM:SS" or "YYYY-MM-DDTHH:MM:SS", in UTC
+bool parseUtcTime(const char* str, std::chrono::nanoseconds& result)
+{
+  int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+  int length = 0;
+  const int n = std::sscanf(str, "%4d-%2d-%2d%*1[ T]%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &length);
+  if (n != 6 || str[length] != '\0') { return false; }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) { return false; }
+
+  const std::int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  result = std::chrono::seconds(seconds);
+  return true;
+}
+
 void showHelp()
 {
   std::cout <<
     "bread -- convert binary logfiles to human readable text\n"
     "\n"
     "Synopsis:\n"
-    "  bread [-f format] [-d date-format] [-s] filename\n"
+    "  bread [-f format] [-d date-format] [-s] [-t] [-j threads] [-a time] [-b time] filename\n"
     "\n"
     "Examples:\n"
     "  bread logfile.blog"                                 "\n"
     "  bread -f '%S %m (%G:%L)' logfile.blog"              "\n"
     "  zcat logfile.blog.gz | bread -f '%S %m (%G:%L)' -"  "\n"
     "  tail -c0 -F logfile.blog | bread"                   "\n"
+    "  bread -a '2020-01-31 12:00:00' -b '2020-01-31 12:30:00' logfile.blog\n"
+    "  bread -t logfile.blog > trace.json"                 "\n"
     "\n"
     "Arguments:\n"
     "  filename       Path to a logfile. If '-' or unspecified, read from stdin\n"
@@ -45,6 +77,10 @@ void showHelp()
     "  -f             Set a custom format string to write events, see 'Event Format'\n"
     "  -d             Set a custom format string to write timestamps, see 'Date Format'\n"
     "  -s             Sort events by time\n"
+    "  -t             Write events in the Chrome trace event format (JSON), see 'Trace Format'\n"
+    "  -j             Decompress compressed frames using the given number of threads\n"
+    "  -a             Only print events at or after the given time (UTC, YYYY-MM-DD HH:MM:SS)\n"
+    "  -b             Only print events at or before the given time (UTC, YYYY-MM-DD HH:MM:SS)\n"
     "\n"
     "Event Format\n"
     "  Log events are transformed to text by substituting placeholders"
@@ -86,6 +122,13 @@ void showHelp()
     "\n"
     "  Default date format string: \"" BINLOG_DEFAULT_DATE_FORMAT "\"\n"
     "\n"
+    "Trace Format\n"
+    "  With -t, events are written as a JSON array of Chrome trace events,"
+    " that can be opened by chrome://tracing or https://ui.perfetto.dev."
+    " Each writer is a thread track. Events of BINLOG_SCOPE_TIMER and BINLOG_SPAN"
+    " are shown with their duration, other events are instant events."
+    " The -f, -d and -s options are ignored.\n"
+    "\n"
     "Report bugs to:\n"
     "  https://github.com/Morgan-Stanley/binlog/issues\n";
 }
@@ -98,9 +141,12 @@ int main(int argc, /*const*/ char* argv[])
   std::string format = BINLOG_DEFAULT_FORMAT "\n";
   std::string dateFormat = BINLOG_DEFAULT_DATE_FORMAT;
   bool sorted = false;
+  bool trace = false;
+  unsigned threadCount = 1;
+  TimeRange timeRange;
 
   int opt;
-  while ((opt = getopt(argc, argv, "f:d:sh")) != -1)
+  while ((opt = getopt(argc, argv, "f:d:stj:a:b:h")) != -1)
   {
     switch (opt)
     {
@@ -114,6 +160,21 @@ int main(int argc, /*const*/ char* argv[])
     case 's':
       sorted = true;
       break;
+    case 't':
+      trace = true;
+      break;
+    case 'j':
+      threadCount = unsigned(std::max(1, std::atoi(optarg)));
+      break;
+    case 'a':
+    case 'b':
+      if (! parseUtcTime(optarg, (opt == 'a') ? timeRange.from : timeRange.to))
+      {
+        std::cerr << "[bread] Invalid time: '" << optarg << "', expected: YYYY-MM-DD HH:MM:SS\n";
+        return 1;
+      }
+      if (opt == 'b') { timeRange.to += std::chrono::seconds(1) - std::chrono::nanoseconds(1); }
+      break;
     case 'h':
       showHelp();
       return 0;
@@ -141,13 +202,15 @@ int main(int argc, /*const*/ char* argv[])
 
   try
   {
-    if (sorted)
-    {
-      printSortedEvents(input, std::cout, format, dateFormat);
-    }
-    else
+    const std::size_t skippedBytes = (trace)
+      ? printTraceEvents(input, std::cout, threadCount, timeRange)
+      : (sorted)
+      ? printSortedEvents(input, std::cout, format, dateFormat, threadCount, timeRange)
+      : printEvents(input, std::cout, format, dateFormat, threadCount, timeRange);
+
+    if (skippedBytes != 0)
     {
-      printEvents(input, std::cout, format, dateFormat);
+      std::cerr << "[bread] Skipped " << skippedBytes << " corrupt bytes\n";
     }
   }
   catch (const std::exception& ex)
@@ -4,32 +4,359 @@
 #include <binlog/EntryStream.hpp>
 #include <binlog/EventStream.hpp>
 #include <binlog/PrettyPrinter.hpp>
+#include <binlog/Severity.hpp>
+#include <binlog/Time.hpp>
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring> // strlen
 #include <istream>
+#include <map>
 #include <ostream>
 #include <sstream>
 #include <utility>
 #include <vector>
 
-void printEvents(std::istream& input, std::ostream& output, const std::string& format, const std::string& dateFormat)
+namespace {
+
+bool isFiltered(const TimeRange& range)
+{
+  return range.from != std::chrono::nanoseconds::min() || range.to != std::chrono::nanoseconds::max();
+}
+
+bool isInRange(const TimeRange& range, const binlog::ClockSync& clockSync, std::uint64_t clockValue)
 {
-  binlog::IstreamEntryStream entryStream(input);
+  if (clockSync.clockFrequency == 0) { return true; } // time unknown
+
+  const std::chrono::nanoseconds time = binlog::clockToNsSinceEpoch(clockSync, clockValue);
+  return range.from <= time && time <= range.to;
+}
+
+void setTimeFilter(const TimeRange& range, const binlog::EventStream& eventStream, binlog::DecompressedEntryStream& entryStream)
+{
+  if (! isFiltered(range)) { return; }
+
+  entryStream.setBlockFilter([&range, &eventStream](const binlog::BlockSummary& summary)
+  {
+    const binlog::ClockSync& clockSync = eventStream.clockSync();
+    if (clockSync.clockFrequency == 0 || summary.minClock > summary.maxClock) { return true; }
+
+    return binlog::clockToNsSinceEpoch(clockSync, summary.minClock) <= range.to
+        && binlog::clockToNsSinceEpoch(clockSync, summary.maxClock) >= range.from;
+  });
+}
+
+// Suffix of the event sources added by BINLOG_SCOPE_TIMER and BINLOG_SPAN, see timer_macros.hpp
+// Added by the timer macros to the event sources, see timer_macros.hpp.
+// The argument tags end with a zero size marker, that user events do not have.
+struct ScopeSuffix
+{
+  const char* formatString;
+  const char* argumentTags;
+  std::size_t argumentCount; // number of u64 arguments, the last one is the duration
+};
+
+const ScopeSuffix g_scopeSuffixes[] = {
+  {" (duration: {} ns)", "L{binlog::scope_timer}", 1},
+  {" (span: {}, parent: {}, duration: {} ns)", "LLL{binlog::span}", 3},
+};
+
+bool endsWith(const std::string& str, const char* suffix)
+{
+  const std::size_t size = strlen(suffix);
+  return str.size() >= size && str.compare(str.size() - size, size, suffix) == 0;
+}
+
+// @returns the size of the valid UTF-8 encoded multibyte character at the beginning of [p, end), or 0
+std::size_t utf8SequenceSize(const unsigned char* p, const unsigned char* end)
+{
+  const std::size_t left = std::size_t(end - p);
+  const auto isCont = [](unsigned char c) { return (c & 0xc0) == 0x80; };
+
+  // ranges of the second byte exclude overlong encodings, surrogates and code points above U+10FFFF
+  if (p[0] >= 0xc2 && p[0] <= 0xdf)
+  {
+    return (left >= 2 && isCont(p[1])) ? 2 : 0;
+  }
+  if (p[0] >= 0xe0 && p[0] <= 0xef)
+  {
+    const unsigned char lo = (p[0] == 0xe0) ? 0xa0 : 0x80;
+    const unsigned char hi = (p[0] == 0xed) ? 0x9f : 0xbf;
+    return (left >= 3 && p[1] >= lo && p[1] <= hi && isCont(p[2])) ? 3 : 0;
+  }
+  if (p[0] >= 0xf0 && p[0] <= 0xf4)
+  {
+    const unsigned char lo = (p[0] == 0xf0) ? 0x90 : 0x80;
+    const unsigned char hi = (p[0] == 0xf4) ? 0x8f : 0xbf;
+    return (left >= 4 && p[1] >= lo && p[1] <= hi && isCont(p[2]) && isCont(p[3])) ? 4 : 0;
+  }
+  return 0;
+}
+
+void printJsonString(std::ostream& out, const std::string& str)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  out.put('"');
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(str.data());
+  const unsigned char* const end = p + str.size();
+  while (p != end)
+  {
+    const char c = static_cast<char>(*p);
+    switch (c)
+    {
+    case '"':  out << "\\\""; break;
+    case '\\': out << "\\\\"; break;
+    case '\n': out << "\\n"; break;
+    case '\r': out << "\\r"; break;
+    case '\t': out << "\\t"; break;
+    default:
+      if (*p < 0x20)
+      {
+        out << "\\u00" << hex[(*p >> 4) & 0xf] << hex[*p & 0xf];
+      }
+      else if (*p < 0x80)
+      {
+        out.put(c);
+      }
+      else if (const std::size_t size = utf8SequenceSize(p, end))
+      {
+        out.write(reinterpret_cast<const char*>(p), std::streamsize(size));
+        p += size - 1;
+      }
+      else
+      {
+        // not valid UTF-8, JSON readers would reject it
+        out << "\\ufffd";
+      }
+      break;
+    }
+    ++p;
+  }
+  out.put('"');
+}
+
+// print `ns` nanoseconds as microseconds, keeping the nanosecond precision
+void printMicroseconds(std::ostream& out, std::int64_t ns)
+{
+  std::uint64_t abs = std::uint64_t(ns);
+  if (ns < 0)
+  {
+    out.put('-');
+    abs = ~abs + 1;
+  }
+
+  const unsigned fraction = unsigned(abs % 1000);
+  out << abs / 1000 << '.'
+      << char('0' + fraction / 100) << char('0' + fraction / 10 % 10) << char('0' + fraction % 10);
+}
+
+/**
+ * Print events as Chrome trace events, see printTraceEvents.
+ *
+ * Keeps state proportional to the number of
+ * writers and event sources, not the number of events.
+ */
+class TracePrinter
+{
+public:
+  explicit TracePrinter(std::ostream& out)
+    :_out(out),
+     _pp("%m", "")
+  {
+    _out << "[";
+  }
+
+  TracePrinter(const TracePrinter&) = delete;
+  void operator=(const TracePrinter&) = delete;
+
+  /** Close the array of trace events */
+  void close()
+  {
+    _out << "\n]\n";
+  }
+
+  void printEvent(const binlog::Event& event, const binlog::EventStream& eventStream)
+  {
+    const binlog::WriterProp& writerProp = eventStream.writerProp();
+    const binlog::ClockSync& clockSync = eventStream.clockSync();
+
+    const auto writer = _writerNames.find(writerProp.id);
+    if (writer == _writerNames.end() || writer->second != writerProp.name)
+    {
+      _writerNames[writerProp.id] = writerProp.name;
+      printThreadName(writerProp);
+    }
+
+    // the message of scope events is printed without the suffix
+    const ScopeSource& scopeSource = findScopeSource(*event.source);
+    binlog::Event strippedEvent = event;
+    std::uint64_t scopeArgs[3] = {};
+    if (scopeSource.suffix != nullptr && readScopeArgs(event, scopeSource.suffix->argumentCount, scopeArgs))
+    {
+      strippedEvent.source = &scopeSource.stripped;
+    }
+    else
+    {
+      strippedEvent.source = event.source;
+    }
+
+    _message.str({}); // reset stream
+    _pp.printEvent(_message, strippedEvent, eventStream);
+
+    beginEntry();
+    _out << "{\"name\":";
+    printJsonString(_out, _message.str());
+    _out << ",\"cat\":";
+    printJsonString(_out, event.source->category);
+
+    if (strippedEvent.source == event.source)
+    {
+      _out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":";
+      printMicroseconds(_out, timestamp(clockSync, event.clockValue));
+    }
+    else
+    {
+      const std::size_t argumentCount = scopeSource.suffix->argumentCount;
+      _out << ",\"ph\":\"X\",\"ts\":";
+      printMicroseconds(_out, timestamp(clockSync, event.clockValue));
+      _out << ",\"dur\":";
+      printMicroseconds(_out, duration(clockSync, scopeArgs[argumentCount - 1]));
+    }
+
+    _out << ",\"pid\":1,\"tid\":" << writerProp.id
+         << ",\"args\":{\"severity\":\"" << binlog::severityToString(event.source->severity).data() << '"';
+    if (strippedEvent.source != event.source && scopeSource.suffix->argumentCount == 3)
+    {
+      _out << ",\"span\":" << scopeArgs[0] << ",\"parent\":" << scopeArgs[1];
+    }
+    _out << "}}";
+  }
+
+private:
+  struct ScopeSource
+  {
+    std::string formatString;  // of the original source, to detect reused source ids
+    std::string argumentTags;  // of the original source, to detect reused source ids
+    const ScopeSuffix* suffix = nullptr; // nullptr, if not a source of a scope event
+    binlog::EventSource stripped; // original source, without the suffix
+  };
+
+  const ScopeSource& findScopeSource(const binlog::EventSource& source)
+  {
+    ScopeSource& result = _scopeSources[source.id];
+    if (result.formatString == source.formatString && result.argumentTags == source.argumentTags)
+    {
+      return result;
+    }
+
+    result.formatString = source.formatString;
+    result.argumentTags = source.argumentTags;
+    result.suffix = nullptr;
+
+    for (const ScopeSuffix& suffix : g_scopeSuffixes)
+    {
+      if (endsWith(source.formatString, suffix.formatString) && endsWith(source.argumentTags, suffix.argumentTags))
+      {
+        result.suffix = &suffix;
+        result.stripped = source;
+        result.stripped.formatString.resize(source.formatString.size() - strlen(suffix.formatString));
+        result.stripped.argumentTags.resize(source.argumentTags.size() - strlen(suffix.argumentTags));
+        break;
+      }
+    }
+
+    return result;
+  }
+
+  // read the last `count` u64 arguments of `event` to `result`
+  static bool readScopeArgs(const binlog::Event& event, std::size_t count, std::uint64_t* result)
+  {
+    binlog::Range args = event.arguments;
+    const std::size_t size = count * sizeof(std::uint64_t);
+    if (args.size() < size) { return false; }
+
+    args.view(args.size() - size);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      result[i] = args.read<std::uint64_t>();
+    }
+    return true;
+  }
+
+  // nanoseconds since epoch, or the clock value as is, if the time is unknown
+  static std::int64_t timestamp(const binlog::ClockSync& clockSync, std::uint64_t clockValue)
+  {
+    if (clockSync.clockFrequency == 0) { return std::int64_t(clockValue); }
+    return binlog::clockToNsSinceEpoch(clockSync, clockValue).count();
+  }
+
+  // nanoseconds, or the clock difference as is, if the clock frequency is unknown
+  static std::int64_t duration(const binlog::ClockSync& clockSync, std::uint64_t clockDiff)
+  {
+    if (clockSync.clockFrequency == 0) { return std::int64_t(clockDiff); }
+    return std::int64_t(double(clockDiff) * 1e9 / double(clockSync.clockFrequency));
+  }
+
+  void printThreadName(const binlog::WriterProp& writerProp)
+  {
+    beginEntry();
+    _out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << writerProp.id
+         << ",\"args\":{\"name\":";
+    printJsonString(_out, writerProp.name);
+    _out << "}}";
+  }
+
+  void beginEntry()
+  {
+    _out << (_empty ? "\n" : ",\n");
+    _empty = false;
+  }
+
+  std::ostream& _out;
+  binlog::PrettyPrinter _pp;
+  std::ostringstream _message;
+  bool _empty = true;
+  std::map<std::uint64_t, std::string> _writerNames;
+  std::map<std::uint64_t, ScopeSource> _scopeSources;
+};
+
+} // namespace
+
+std::size_t printEvents(
+  std::istream& input, std::ostream& output,
+  const std::string& format, const std::string& dateFormat,
+  unsigned threadCount, const TimeRange& timeRange
+)
+{
+  binlog::CheckedIstreamEntryStream checkedEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(checkedEntryStream, threadCount);
   binlog::EventStream eventStream;
   binlog::PrettyPrinter pp(format, dateFormat);
+  setTimeFilter(timeRange, eventStream, entryStream);
+  const bool filtered = isFiltered(timeRange);
 
   while (const binlog::Event* event = eventStream.nextEvent(entryStream))
   {
-    pp.printEvent(output, *event, eventStream.writerProp(), eventStream.clockSync());
+    if (filtered && ! isInRange(timeRange, eventStream.clockSync(), event->clockValue)) { continue; }
+    pp.printEvent(output, *event, eventStream);
   }
+
+  return checkedEntryStream.skippedBytes();
 }
 
-void printSortedEvents(std::istream& input, std::ostream& output, const std::string& format, const std::string& dateFormat)
+std::size_t printSortedEvents(
+  std::istream& input, std::ostream& output,
+  const std::string& format, const std::string& dateFormat,
+  unsigned threadCount, const TimeRange& timeRange
+)
 {
-  binlog::IstreamEntryStream entryStream(input);
+  binlog::CheckedIstreamEntryStream checkedEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(checkedEntryStream, threadCount);
   binlog::EventStream eventStream;
   binlog::PrettyPrinter pp(format, dateFormat);
+  setTimeFilter(timeRange, eventStream, entryStream);
+  const bool filtered = isFiltered(timeRange);
 
   using Pair = std::pair<std::uint64_t /* clock */, std::string /* pretty printed event */>;
   std::vector<Pair> buffer;
@@ -38,8 +365,10 @@ void printSortedEvents(std::istream& input, std::ostream& output, const std::str
   // buffer every event in input
   while (const binlog::Event* event = eventStream.nextEvent(entryStream))
   {
+    if (filtered && ! isInRange(timeRange, eventStream.clockSync(), event->clockValue)) { continue; }
+
     stream.str({}); // reset stream
-    pp.printEvent(stream, *event, eventStream.writerProp(), eventStream.clockSync());
+    pp.printEvent(stream, *event, eventStream);
     buffer.emplace_back(event->clockValue, stream.str());
   }
 
@@ -50,4 +379,28 @@ void printSortedEvents(std::istream& input, std::ostream& output, const std::str
   {
     output << p.second;
   }
+
+  return checkedEntryStream.skippedBytes();
+}
+
+std::size_t printTraceEvents(
+  std::istream& input, std::ostream& output,
+  unsigned threadCount, const TimeRange& timeRange
+)
+{
+  binlog::CheckedIstreamEntryStream checkedEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(checkedEntryStream, threadCount);
+  binlog::EventStream eventStream;
+  setTimeFilter(timeRange, eventStream, entryStream);
+  const bool filtered = isFiltered(timeRange);
+
+  TracePrinter tp(output);
+  while (const binlog::Event* event = eventStream.nextEvent(entryStream))
+  {
+    if (filtered && ! isInRange(timeRange, eventStream.clockSync(), event->clockValue)) { continue; }
+    tp.printEvent(*event, eventStream);
+  }
+  tp.close();
+
+  return checkedEntryStream.skippedBytes();
 }
@@ -1,27 +1,80 @@
 #ifndef BINLOG_BIN_PRINTERS_HPP
 #define BINLOG_BIN_PRINTERS_HPP
 
+#include <chrono>
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 
+/** Closed interval of event timestamps, in nanoseconds since epoch */
+struct TimeRange
+{
+  std::chrono::nanoseconds from = std::chrono::nanoseconds::min();
+  std::chrono::nanoseconds to = std::chrono::nanoseconds::max();
+};
+
 /**
  * Print the events in `input` to output, according to
  * `format` and `dateFormat`.
  *
+ * Compressed frames are decompressed using up to `threadCount` threads.
+ * Corrupt frames are skipped, if `input` is checksummed.
+ * Only events in `timeRange` are printed. Compressed frames
+ * outside of `timeRange` are skipped without decompression.
+ *
  * @see PrettyPrinter on `format` and `dateFormat`.
+ * @returns the number of corrupt bytes skipped
  * @throws std::runtime_error if invalid binlog entry found in `input`.
  */
-void printEvents(std::istream& input, std::ostream& output, const std::string& format, const std::string& dateFormat);
+std::size_t printEvents(
+  std::istream& input, std::ostream& output,
+  const std::string& format, const std::string& dateFormat,
+  unsigned threadCount = 1, const TimeRange& timeRange = {}
+);
 
 /**
  * Print the events in `input` to output, according to
  * `format` and `dateFormat`, sorted by event clock.
  *
  * First buffer every event in `input`, then sort and print them.
+ * Compressed frames are decompressed using up to `threadCount` threads.
+ * Corrupt frames are skipped, if `input` is checksummed.
+ * Only events in `timeRange` are printed. Compressed frames
+ * outside of `timeRange` are skipped without decompression.
  *
  * @see PrettyPrinter on `format` and `dateFormat`.
+ * @returns the number of corrupt bytes skipped
+ * @throws std::runtime_error if invalid binlog entry found in `input`.
+ */
+std::size_t printSortedEvents(
+  std::istream& input, std::ostream& output,
+  const std::string& format, const std::string& dateFormat,
+  unsigned threadCount = 1, const TimeRange& timeRange = {}
+);
+
+/**
+ * Write the events in `input` to `output` as a JSON array
+ * of the Chrome trace event format, viewable by chrome://tracing or Perfetto.
+ *
+ * Each writer is a thread track, named by a metadata event.
+ * Events of BINLOG_SCOPE_TIMER and BINLOG_SPAN are written as
+ * complete events ("ph":"X"), with their duration,
+ * other events are written as thread scoped instant events.
+ * Timestamps are microseconds since epoch, converted by the ClockSync
+ * of the input, or raw clock values, if there is no ClockSync.
+ *
+ * Events are written as they are read, memory usage
+ * does not depend on the size of `input`.
+ * Compressed frames are decompressed using up to `threadCount` threads.
+ * Corrupt frames are skipped, if `input` is checksummed.
+ * Only events in `timeRange` are written.
+ *
+ * @returns the number of corrupt bytes skipped
  * @throws std::runtime_error if invalid binlog entry found in `input`.
  */
-void printSortedEvents(std::istream& input, std::ostream& output, const std::string& format, const std::string& dateFormat);
+std::size_t printTraceEvents(
+  std::istream& input, std::ostream& output,
+  unsigned threadCount = 1, const TimeRange& timeRange = {}
+);
 
 #endif // BINLOG_BIN_PRINTERS_HPP
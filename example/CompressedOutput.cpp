@@ -0,0 +1,21 @@
+#include <binlog/CompressedOutputStream.hpp> // requires binlog library to be linked
+#include <binlog/binlog.hpp>
+
+#include <fstream>
+#include <iostream>
+
+int main()
+{
+  //[compress
+  std::ofstream logfile("compressed.blog", std::ofstream::out|std::ofstream::binary);
+  binlog::CompressedOutputStream output(logfile, binlog::Codec::lz4);
+
+  BINLOG_INFO("Hello Compressed Output!");
+
+  binlog::consume(output);
+  output.flush();
+  //]
+
+  std::cout << "Binary log written to compressed.blog\n";
+  return 0;
+}
@@ -19,7 +19,7 @@ public:
   MultiOutputStream(std::ostream& binary, std::ostream& text)
     :_binary(binary),
      _text(text),
-     _filter([](const binlog::EventSource& source) {
+     _filter([](const binlog::EventSourceView& source) {
         return source.severity >= binlog::Severity::error;
      })
   {}
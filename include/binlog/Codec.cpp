@@ -0,0 +1,292 @@
+#include <binlog/Codec.hpp>
+
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <string>
+
+#ifdef BINLOG_HAS_ZLIB
+  #include <zlib.h>
+#endif
+
+namespace binlog {
+
+namespace {
+
+/*
+ * LZ4 block format, see:
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * The compressor below is a simple, greedy one,
+ * using a single hash table of recent 4 byte sequences.
+ */
+
+constexpr std::size_t lz4MinMatch = 4;
+constexpr std::size_t lz4LastLiterals = 5;   // last bytes of the block are always literals
+constexpr std::size_t lz4MatchSafeDistance = 12; // last match must start this far from the end
+constexpr std::size_t lz4MaxOffset = 65535;
+constexpr unsigned lz4HashLog = 12;
+
+std::uint32_t read32(const unsigned char* p)
+{
+  std::uint32_t result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+unsigned char* writeLength(std::size_t length, unsigned char* op)
+{
+  for (; length >= 255; length -= 255) { *op++ = 255; }
+  *op++ = static_cast<unsigned char>(length);
+  return op;
+}
+
+unsigned char* writeSequence(
+  const unsigned char* literals, std::size_t literalLength,
+  std::size_t offset, std::size_t matchLength,
+  unsigned char* op
+)
+{
+  unsigned char* token = op++;
+  *token = 0;
+
+  if (literalLength >= 15)
+  {
+    *token = 15 << 4;
+    op = writeLength(literalLength - 15, op);
+  }
+  else
+  {
+    *token = static_cast<unsigned char>(literalLength << 4);
+  }
+
+  memcpy(op, literals, literalLength);
+  op += literalLength;
+
+  if (matchLength == 0) { return op; } // last sequence
+
+  *op++ = static_cast<unsigned char>(offset & 0xFF);
+  *op++ = static_cast<unsigned char>(offset >> 8);
+
+  const std::size_t ml = matchLength - lz4MinMatch;
+  if (ml >= 15)
+  {
+    *token = static_cast<unsigned char>(*token | 15);
+    op = writeLength(ml - 15, op);
+  }
+  else
+  {
+    *token = static_cast<unsigned char>(*token | ml);
+  }
+
+  return op;
+}
+
+std::size_t lz4Compress(const char* src, std::size_t srcSize, char* dst)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+
+  std::size_t anchor = 0;
+
+  if (srcSize > lz4MatchSafeDistance)
+  {
+    std::uint32_t table[std::size_t(1) << lz4HashLog] = {0};
+
+    const std::size_t matchLimit = srcSize - lz4LastLiterals;
+    const std::size_t ipLimit = srcSize - lz4MatchSafeDistance;
+
+    std::size_t ip = 0;
+    while (ip < ipLimit)
+    {
+      const std::uint32_t sequence = read32(in + ip);
+      const std::uint32_t hash = (sequence * 2654435761U) >> (32 - lz4HashLog);
+      const std::size_t ref = table[hash];
+      table[hash] = std::uint32_t(ip);
+
+      if (ref < ip && ip - ref <= lz4MaxOffset && read32(in + ref) == sequence)
+      {
+        std::size_t length = lz4MinMatch;
+        while (ip + length < matchLimit && in[ref + length] == in[ip + length]) { ++length; }
+
+        op = writeSequence(in + anchor, ip - anchor, ip - ref, length, op);
+        ip += length;
+        anchor = ip;
+      }
+      else
+      {
+        ++ip;
+      }
+    }
+  }
+
+  op = writeSequence(in + anchor, srcSize - anchor, 0, 0, op);
+  return std::size_t(op - reinterpret_cast<unsigned char*>(dst));
+}
+
+[[noreturn]] void throwInvalidLz4Block()
+{
+  throw std::runtime_error("Invalid LZ4 block");
+}
+
+std::size_t readLength(const unsigned char*& ip, const unsigned char* iend)
+{
+  std::size_t result = 0;
+  unsigned char b = 255;
+  while (b == 255)
+  {
+    if (ip == iend) { throwInvalidLz4Block(); }
+    b = *ip++;
+    result += b;
+  }
+  return result;
+}
+
+void lz4Decompress(const char* src, std::size_t srcSize, char* dst, std::size_t dstSize)
+{
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const iend = ip + srcSize;
+  unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+  unsigned char* const ostart = op;
+  unsigned char* const oend = op + dstSize;
+
+  while (ip != iend)
+  {
+    const unsigned token = *ip++;
+
+    std::size_t literalLength = token >> 4;
+    if (literalLength == 15) { literalLength += readLength(ip, iend); }
+    if (std::size_t(iend - ip) < literalLength || std::size_t(oend - op) < literalLength) { throwInvalidLz4Block(); }
+
+    memcpy(op, ip, literalLength);
+    ip += literalLength;
+    op += literalLength;
+
+    if (ip == iend) { break; } // last sequence has no match
+
+    if (iend - ip < 2) { throwInvalidLz4Block(); }
+    const std::size_t offset = std::size_t(ip[0]) | (std::size_t(ip[1]) << 8);
+    ip += 2;
+    if (offset == 0 || std::size_t(op - ostart) < offset) { throwInvalidLz4Block(); }
+
+    std::size_t matchLength = token & 15;
+    if (matchLength == 15) { matchLength += readLength(ip, iend); }
+    matchLength += lz4MinMatch;
+    if (std::size_t(oend - op) < matchLength) { throwInvalidLz4Block(); }
+
+    // match and output might overlap: copy byte by byte
+    const unsigned char* match = op - offset;
+    for (std::size_t i = 0; i < matchLength; ++i) { *op++ = *match++; }
+  }
+
+  if (op != oend) { throwInvalidLz4Block(); }
+}
+
+[[noreturn]] void throwCodecNotAvailable(Codec codec)
+{
+  throw std::runtime_error("Codec not available: " + std::to_string(int(codec)));
+}
+
+} // namespace
+
+bool isCodecAvailable(Codec codec)
+{
+  switch (codec)
+  {
+  case Codec::none:
+  case Codec::lz4:
+    return true;
+  case Codec::zlib:
+    #ifdef BINLOG_HAS_ZLIB
+      return true;
+    #else
+      return false;
+    #endif
+  }
+
+  return false;
+}
+
+namespace detail {
+
+std::size_t compressBound(Codec codec, std::size_t size)
+{
+  switch (codec)
+  {
+  case Codec::none:
+    return size;
+  case Codec::lz4:
+    return size + size / 255 + 16;
+  case Codec::zlib:
+    #ifdef BINLOG_HAS_ZLIB
+      return std::size_t(::compressBound(uLong(size)));
+    #else
+      break;
+    #endif
+  }
+
+  throwCodecNotAvailable(codec);
+}
+
+std::size_t compress(Codec codec, const char* src, std::size_t srcSize, char* dst, std::size_t dstCapacity)
+{
+  switch (codec)
+  {
+  case Codec::none:
+    if (dstCapacity < srcSize) { break; }
+    memcpy(dst, src, srcSize);
+    return srcSize;
+  case Codec::lz4:
+    if (dstCapacity < compressBound(codec, srcSize)) { break; }
+    return lz4Compress(src, srcSize, dst);
+  case Codec::zlib:
+  {
+    #ifdef BINLOG_HAS_ZLIB
+      uLongf dstSize = uLongf(dstCapacity);
+      const int rc = ::compress2(
+        reinterpret_cast<Bytef*>(dst), &dstSize,
+        reinterpret_cast<const Bytef*>(src), uLong(srcSize),
+        Z_DEFAULT_COMPRESSION
+      );
+      if (rc != Z_OK) { break; }
+      return std::size_t(dstSize);
+    #else
+      throwCodecNotAvailable(codec);
+    #endif
+  }
+  }
+
+  throw std::runtime_error("Failed to compress " + std::to_string(srcSize) + " bytes");
+}
+
+void decompress(Codec codec, const char* src, std::size_t srcSize, char* dst, std::size_t dstSize)
+{
+  switch (codec)
+  {
+  case Codec::none:
+    if (srcSize != dstSize) { throw std::runtime_error("Invalid uncompressed data size"); }
+    memcpy(dst, src, srcSize);
+    return;
+  case Codec::lz4:
+    lz4Decompress(src, srcSize, dst, dstSize);
+    return;
+  case Codec::zlib:
+  {
+    #ifdef BINLOG_HAS_ZLIB
+      uLongf size = uLongf(dstSize);
+      const int rc = ::uncompress(
+        reinterpret_cast<Bytef*>(dst), &size,
+        reinterpret_cast<const Bytef*>(src), uLong(srcSize)
+      );
+      if (rc != Z_OK || size != dstSize) { throw std::runtime_error("Invalid zlib data"); }
+      return;
+    #else
+      break;
+    #endif
+  }
+  }
+
+  throwCodecNotAvailable(codec);
+}
+
+} // namespace detail
+} // namespace binlog
@@ -0,0 +1,45 @@
+#ifndef BINLOG_CODEC_HPP
+#define BINLOG_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace binlog {
+
+/** Compression algorithms of CompressedFrame entries */
+enum class Codec : std::uint8_t
+{
+  none = 0, /**< Data is stored as is */
+  lz4 = 1,  /**< LZ4 block format, fast, built-in */
+  zlib = 2, /**< zlib (deflate) format, stronger, available if binlog is built with zlib */
+};
+
+/** @returns true if data can be compressed and decompressed using `codec` */
+bool isCodecAvailable(Codec codec);
+
+namespace detail {
+
+/** @returns the maximum size of the data of `size` bytes compressed by `codec` */
+std::size_t compressBound(Codec codec, std::size_t size);
+
+/**
+ * Compress [src, src+srcSize) to `dst` using `codec`.
+ *
+ * @pre dstCapacity >= compressBound(codec, srcSize)
+ * @returns the size of the compressed data
+ * @throws std::runtime_error if `codec` is not available, or compression fails
+ */
+std::size_t compress(Codec codec, const char* src, std::size_t srcSize, char* dst, std::size_t dstCapacity);
+
+/**
+ * Decompress [src, src+srcSize) to [dst, dst+dstSize) using `codec`.
+ *
+ * @throws std::runtime_error if `codec` is not available, the input is invalid,
+ *         or the decompressed size is not `dstSize`.
+ */
+void decompress(Codec codec, const char* src, std::size_t srcSize, char* dst, std::size_t dstSize);
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_CODEC_HPP
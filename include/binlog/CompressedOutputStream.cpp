@@ -0,0 +1,311 @@
+#include <binlog/CompressedOutputStream.hpp>
+
+#include <binlog/Entries.hpp> // CompressedFrame
+#include <binlog/detail/Crc32c.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <mserialize/detail/varint.hpp>
+
+#include <cstddef> // ptrdiff_t
+#include <cstdint>
+#include <cstring> // memcpy
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility> // move
+
+namespace binlog {
+
+namespace {
+
+// Maximum number of submitted but not yet written frames.
+// If the helper thread falls behind, `write` blocks.
+constexpr std::size_t maxPendingFrames = 4;
+
+template <typename T>
+char* writeInteger(T value, char* out)
+{
+  memcpy(out, &value, sizeof(value));
+  return out + sizeof(value);
+}
+
+bool isSpecial(std::uint64_t tag)
+{
+  return (tag & (std::uint64_t(1) << 63)) != 0;
+}
+
+bool isMetadata(std::uint64_t tag)
+{
+  return tag == EventSource::Tag || tag == ClockSync::Tag
+      || tag == LiteralString::Tag || tag == InternedString::Tag || tag == ErrorCodeMessage::Tag;
+}
+
+// Set `tag` to the tag of the entry at `entry`, and @returns the end of the entry,
+// or `end`, if the entry is not complete.
+const char* readEntry(const char* entry, const char* end, std::uint64_t& tag)
+{
+  std::uint32_t entrySize;
+  tag = 0;
+  if (end - entry < std::ptrdiff_t(sizeof(entrySize) + sizeof(tag))) { return end; }
+  memcpy(&entrySize, entry, sizeof(entrySize));
+  memcpy(&tag, entry + sizeof(entrySize), sizeof(tag));
+  if (std::size_t(end - entry) - sizeof(entrySize) < entrySize) { return end; }
+  return entry + sizeof(entrySize) + entrySize;
+}
+
+void addEvent(std::uint64_t sourceId, std::uint64_t clock, BlockSummary& summary)
+{
+  if (clock < summary.minClock) { summary.minClock = clock; }
+  if (clock > summary.maxClock) { summary.maxClock = clock; }
+  summary.sources[(sourceId % 256) / 64] |= std::uint64_t(1) << (sourceId % 64);
+}
+
+void summarizeEntries(Range entries, BlockSummary& summary)
+{
+  while (! entries.empty())
+  {
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range entry{entries.view(size), size};
+    const std::uint64_t tag = entry.read<std::uint64_t>();
+
+    if (isMetadata(tag))
+    {
+      summary.hasMetadata = true;
+    }
+    else if (tag == EventBatch::Tag)
+    {
+      const std::uint64_t clockBase = entry.read<std::uint64_t>();
+      while (! entry.empty())
+      {
+        const std::uint32_t batchEntrySize = entry.read<std::uint32_t>();
+        Range batchEntry{entry.view(batchEntrySize), batchEntrySize};
+        const std::uint64_t batchTag = batchEntry.read<std::uint64_t>();
+        if (isMetadata(batchTag))
+        {
+          summary.hasMetadata = true;
+        }
+        else if (! isSpecial(batchTag))
+        {
+          const std::int64_t delta = mserialize::detail::zigzag_decode(mserialize::detail::read_varint(batchEntry));
+          addEvent(batchTag, clockBase + std::uint64_t(delta), summary);
+        }
+      }
+    }
+    else if (! isSpecial(tag))
+    {
+      addEvent(tag, entry.read<std::uint64_t>(), summary);
+    }
+  }
+}
+
+BlockSummary summarize(const std::vector<char>& frame)
+{
+  BlockSummary summary;
+  summary.minClock = std::numeric_limits<std::uint64_t>::max();
+
+  try
+  {
+    summarizeEntries(Range{frame.data(), frame.size()}, summary);
+  }
+  catch (const std::runtime_error&)
+  {
+    // not a valid sequence of entries, make sure it is never skipped
+    summary.minClock = 0;
+    summary.maxClock = std::numeric_limits<std::uint64_t>::max();
+    summary.hasMetadata = true;
+  }
+
+  return summary;
+}
+
+} // namespace
+
+CompressedOutputStream::CompressedOutputStream(std::ostream& out, Codec codec, std::size_t frameSize)
+  :_out(out),
+   _codec(codec),
+   _frameSize(frameSize)
+{
+  if (! isCodecAvailable(codec))
+  {
+    throw std::runtime_error("Codec not available: " + std::to_string(int(codec)));
+  }
+
+  _frame.reserve(frameSize);
+  _thread = std::thread(&CompressedOutputStream::compressLoop, this);
+}
+
+CompressedOutputStream::~CompressedOutputStream()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (! _frame.empty())
+    {
+      _pendingFrames.push_back(std::move(_frame));
+    }
+    _stop = true;
+  }
+
+  _cv.notify_all();
+  _thread.join();
+  _out.flush();
+}
+
+CompressedOutputStream& CompressedOutputStream::write(const char* data, std::streamsize size)
+{
+  rethrowError();
+
+  // Do not separate a WriterProp from the following events:
+  // readers skipping the frame of the WriterProp would attribute
+  // the events to a different writer. Close the frame only before a WriterProp,
+  // or before any entry, if the stream has no WriterProp.
+  const char* const end = data + size;
+  const char* begin = data;
+  for (const char* entry = data; entry != end;)
+  {
+    std::uint64_t tag;
+    const char* next = readEntry(entry, end, tag);
+    const bool writerProp = (tag == WriterProp::Tag);
+
+    if ((writerProp || ! _hasWriterProp) && _frame.size() + std::size_t(entry - begin) >= _frameSize)
+    {
+      _frame.insert(_frame.end(), begin, entry);
+      begin = entry;
+      if (! _frame.empty()) { submitFrame(); }
+    }
+
+    _hasWriterProp = _hasWriterProp || writerProp;
+    entry = next;
+  }
+
+  _frame.insert(_frame.end(), begin, end);
+  return *this;
+}
+
+void CompressedOutputStream::flush()
+{
+  if (! _frame.empty())
+  {
+    submitFrame();
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return _pendingFrames.empty() && ! _busy; });
+  }
+
+  rethrowError();
+  _out.flush();
+}
+
+void CompressedOutputStream::submitFrame()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return _pendingFrames.size() < maxPendingFrames; });
+    _pendingFrames.push_back(std::move(_frame));
+  }
+
+  _cv.notify_all();
+
+  _frame.clear(); // moved-from vector is valid but unspecified
+  _frame.reserve(_frameSize);
+}
+
+void CompressedOutputStream::rethrowError()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_error)
+  {
+    std::rethrow_exception(_error);
+  }
+}
+
+void CompressedOutputStream::compressLoop()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  while (true)
+  {
+    _cv.wait(lock, [this]() { return _stop || ! _pendingFrames.empty(); });
+    if (_pendingFrames.empty()) { return; } // stopped, and every frame is written
+
+    std::vector<char> frame = std::move(_pendingFrames.front());
+    _pendingFrames.pop_front();
+    _busy = true;
+    lock.unlock();
+
+    std::exception_ptr error;
+    try
+    {
+      writeFrame(frame);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    if (error && ! _error) { _error = error; }
+    _busy = false;
+    _cv.notify_all();
+  }
+}
+
+void CompressedOutputStream::writeFrame(const std::vector<char>& frame)
+{
+  Codec codec = _codec;
+  _compressed.resize(detail::compressBound(codec, frame.size()));
+  std::size_t compressedSize = detail::compress(codec, frame.data(), frame.size(), _compressed.data(), _compressed.size());
+
+  const char* data = _compressed.data();
+  if (compressedSize >= frame.size())
+  {
+    // incompressible data, store it as is
+    codec = Codec::none;
+    data = frame.data();
+    compressedSize = frame.size();
+  }
+
+  // u32 size | u64 tag | u8 codec | u32 uncompressedSize | u32 compressedSize | data | u32 checksum
+  char header[sizeof(std::uint32_t) + sizeof(std::uint64_t) + sizeof(std::uint8_t) + 2 * sizeof(std::uint32_t)];
+  const std::uint32_t entrySize = std::uint32_t(sizeof(header) - sizeof(std::uint32_t) + compressedSize + sizeof(std::uint32_t));
+  const std::uint64_t tag = CompressedFrame::Tag;
+
+  char* p = header;
+  p = writeInteger(entrySize, p);
+  p = writeInteger(tag, p);
+  p = writeInteger(static_cast<std::uint8_t>(codec), p);
+  p = writeInteger(std::uint32_t(frame.size()), p);
+  writeInteger(std::uint32_t(compressedSize), p);
+
+  // the checksum covers everything but the size, that is validated by the reader
+  std::uint32_t checksum = detail::crc32c(header + sizeof(std::uint32_t), sizeof(header) - sizeof(std::uint32_t));
+  checksum = detail::crc32c(data, compressedSize, checksum);
+  char trailer[sizeof(std::uint32_t)];
+  writeInteger(checksum, trailer);
+
+  writeSummary(frame, std::uint32_t(entrySize + sizeof(std::uint32_t)));
+
+  _out.write(header, std::streamsize(sizeof(header)));
+  _out.write(data, std::streamsize(compressedSize));
+  _out.write(trailer, std::streamsize(sizeof(trailer)));
+}
+
+void CompressedOutputStream::writeSummary(const std::vector<char>& frame, std::uint32_t blockSize)
+{
+  BlockSummary summary = summarize(frame);
+  summary.blockSize = blockSize;
+
+  detail::VectorOutputStream& out = _summary;
+  out.clear();
+  serializeSizePrefixedTagged(summary, out);
+
+  // the checksum is the last field, covers the payload before it
+  const std::size_t checkedSize = out.vector.size() - 2 * sizeof(std::uint32_t);
+  const std::uint32_t checksum = detail::crc32c(out.data() + sizeof(std::uint32_t), checkedSize);
+  memcpy(out.vector.data() + sizeof(std::uint32_t) + checkedSize, &checksum, sizeof(checksum));
+
+  _out.write(out.data(), out.ssize());
+}
+
+} // namespace binlog
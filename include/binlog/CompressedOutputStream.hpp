@@ -0,0 +1,128 @@
+#ifndef BINLOG_COMPRESSED_OUTPUT_STREAM_HPP
+#define BINLOG_COMPRESSED_OUTPUT_STREAM_HPP
+
+#include <binlog/Codec.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <ios> // streamsize
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace binlog {
+
+/**
+ * Compress a binlog stream into CompressedFrame entries.
+ *
+ * Models mserialize::OutputStream.
+ * Suitable to compress data consumed from Session directly.
+ *
+ * Written data is buffered until the buffer reaches `frameSize`,
+ * then it is compressed and written to the underlying ostream
+ * by a helper thread, so `write` is not slowed down by the compression.
+ * Because Session::consume always writes complete entries,
+ * each frame starts at an entry boundary, and can be
+ * decompressed independently of the others.
+ * If the stream has WriterProp entries, a frame is only closed
+ * before a WriterProp, therefore events are never separated
+ * from the WriterProp describing their writer, and a frame
+ * can exceed `frameSize` by the entries of a single writer.
+ *
+ * Each frame is preceded by a BlockSummary entry,
+ * that allows readers to skip frames without decompressing them.
+ *
+ * The output is a valid binlog stream, readable by
+ * bread, or by DecompressedEntryStream.
+ *
+ * The underlying ostream must not be accessed while
+ * the helper thread may write it, i.e: only after
+ * a call to `flush` and before the next `write`.
+ */
+class CompressedOutputStream
+{
+public:
+  /**
+   * Will write compressed data to `out`, using `codec`.
+   *
+   * `out` must remain valid as long as *this is valid.
+   *
+   * @throws std::runtime_error if `codec` is not available
+   */
+  explicit CompressedOutputStream(
+    std::ostream& out,
+    Codec codec = Codec::lz4,
+    std::size_t frameSize = 1 << 20
+  );
+
+  /** Write the buffered data to the underlying ostream (see `flush`) */
+  ~CompressedOutputStream();
+
+  CompressedOutputStream(const CompressedOutputStream&) = delete;
+  void operator=(const CompressedOutputStream&) = delete;
+
+  CompressedOutputStream(CompressedOutputStream&&) = delete;
+  void operator=(CompressedOutputStream&&) = delete;
+
+  /**
+   * Add the binlog entries in [data, data+size) to the current frame.
+   *
+   * If the size of the current frame reaches `frameSize`,
+   * the frame is handed over to the helper thread
+   * at the next frame boundary (see the class description).
+   * Blocks if the helper thread falls behind by too many frames.
+   *
+   * The entries in the buffer must be complete,
+   * no partial entry is allowed.
+   *
+   * @throws std::runtime_error if an earlier compression failed
+   */
+  CompressedOutputStream& write(const char* data, std::streamsize size);
+
+  /**
+   * Compress and write the current frame (even if it is not full),
+   * wait until every frame is written, then flush the underlying ostream.
+   *
+   * @throws std::runtime_error if an earlier compression failed
+   */
+  void flush();
+
+private:
+  void submitFrame();
+
+  void rethrowError();
+
+  void compressLoop();
+
+  void writeFrame(const std::vector<char>& frame);
+
+  void writeSummary(const std::vector<char>& frame, std::uint32_t blockSize);
+
+  std::ostream& _out;
+  const Codec _codec;
+  const std::size_t _frameSize;
+
+  std::vector<char> _frame; /**< Current frame, not yet submitted */
+  bool _hasWriterProp = false; /**< True if a WriterProp was written */
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::vector<char>> _pendingFrames; /**< Submitted frames, not yet written */
+  bool _busy = false;                           /**< True if the helper thread is writing a frame */
+  bool _stop = false;
+  std::exception_ptr _error;
+
+  std::vector<char> _compressed;       /**< Used by the helper thread only */
+  detail::VectorOutputStream _summary; /**< Used by the helper thread only */
+
+  std::thread _thread; // must be the last member
+};
+
+} // namespace binlog
+
+#endif // BINLOG_COMPRESSED_OUTPUT_STREAM_HPP
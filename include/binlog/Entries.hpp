@@ -7,9 +7,15 @@
 #include <mserialize/make_struct_deserializable.hpp>
 #include <mserialize/make_struct_serializable.hpp>
 #include <mserialize/serialize.hpp>
+#include <mserialize/string_view.hpp>
 
+#include <array>
 #include <cstdint>
+#include <map>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility> // pair
 
 /*
  * The structures below represent the entries
@@ -46,6 +52,26 @@ struct EventSource
   std::string argumentTags; /**< mserialize::tag of the arguments */
 };
 
+/**
+ * Same as EventSource, but the strings are not owned,
+ * they refer to an external buffer (e.g: the serialized entry).
+ *
+ * Allows inspecting EventSources without allocating memory.
+ *
+ * @see deserializeEventSourceView
+ */
+struct EventSourceView
+{
+  std::uint64_t id = {};
+  Severity severity = Severity::info;
+  mserialize::string_view category;
+  mserialize::string_view function;
+  mserialize::string_view file;
+  std::uint64_t line = {};
+  mserialize::string_view formatString;
+  mserialize::string_view argumentTags; /**< mserialize::tag of the arguments */
+};
+
 /**
  * Represents a writer (thread, fiber, coroutine, task)
  * that triggers EventSources to produce events.
@@ -107,6 +133,141 @@ struct ClockSync
   std::string tzName;                /**< Time zone name */
 };
 
+/**
+ * Represents a batch of entries (usually Events)
+ * with delta encoded clock values.
+ *
+ * The batch is serialized as `clockBase`, followed by
+ * the contained entries, until the end of the payload.
+ * Contained entries are serialized as any other entry,
+ * except that the `clockValue` of Events is encoded as
+ * the difference of the clock value and `clockBase`,
+ * zigzag varint encoded (see the `z` mserialize tag),
+ * instead of a fixed size 64 bit integer.
+ * Therefore events of the batch must be read in the context of the batch.
+ *
+ * Readers not aware of this entry skip the whole batch.
+ */
+struct EventBatch
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-4);
+
+  std::uint64_t clockBase = {};
+};
+
+/**
+ * Represents a sequence of complete entries, compressed.
+ *
+ * The frame is serialized as `codec` (u8), `uncompressedSize` (u32),
+ * followed by the size (u32) and bytes of the compressed data.
+ * The uncompressed data is a sequence of complete entries,
+ * that can be read in the context of the preceding entries of the stream.
+ * Each frame can be decompressed independently of the others.
+ *
+ * The data is followed by `checksum` (u32), the CRC-32C of the payload
+ * from the tag to the end of the data. The tag also serves as
+ * a sync marker: after a corruption, readers can find the next frame
+ * by looking for it (see CheckedIstreamEntryStream).
+ *
+ * Readers not aware of this entry skip the compressed entries.
+ * @see CompressedOutputStream and DecompressedEntryStream
+ */
+struct CompressedFrame
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-5);
+
+  std::uint8_t codec = {};            /**< binlog::Codec used to compress the data */
+  std::uint32_t uncompressedSize = {}; /**< Size of the entries before compression */
+  Range data;                          /**< Compressed entries */
+  std::uint32_t checksum = {};         /**< CRC-32C of the tag, header fields and data */
+};
+
+/**
+ * Summarizes the CompressedFrame that immediately follows it.
+ *
+ * Allows readers to skip frames that surely do not contain
+ * interesting events (e.g: events outside of a time range, or
+ * events of a specific source), without decompressing them.
+ *
+ * `sources` is a bitmap of the event source ids in the frame:
+ * if the frame contains an event of source `id`,
+ * bit `id % 256` is set (bit `n` is `sources[n / 64] >> (n % 64) & 1`).
+ * If the frame contains no events, `minClock` > `maxClock`.
+ *
+ * Frames with `hasMetadata` set (e.g: EventSource or ClockSync
+ * entries, that later events depend on) must not be skipped.
+ *
+ * `checksum` is the CRC-32C of the preceding part of the payload (from the tag).
+ */
+struct BlockSummary
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-6);
+
+  std::uint64_t minClock = {};     /**< Smallest clock value of the events in the frame */
+  std::uint64_t maxClock = {};     /**< Largest clock value of the events in the frame */
+  std::uint32_t blockSize = {};    /**< Size of the frame entry in bytes, including its size field */
+  bool hasMetadata = {};           /**< True if the frame contains metadata that must not be skipped */
+  std::array<std::uint64_t, 4> sources = {}; /**< Bitmap of event source ids */
+  std::uint32_t checksum = {};
+};
+
+/**
+ * Value of a string logged by address, see binlog::literal.
+ *
+ * The entry precedes the first event that refers to `address`.
+ * Readers resolve the addresses logged by events
+ * to strings using these entries, see LiteralTable.
+ */
+struct LiteralString
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-7);
+
+  std::uint64_t address = {}; /**< Address of the string in the producer program */
+  std::string value;          /**< The string pointed by `address` */
+};
+
+/** Maps addresses to strings, as read from LiteralString entries */
+using LiteralTable = std::unordered_map<std::uint64_t, std::string>;
+
+/**
+ * Value of an interned string, see binlog::interned.
+ *
+ * Written by the producer to its queue, before the first
+ * event that refers to `id`. Ids are unique in a Session.
+ * Readers resolve the ids logged by events
+ * to strings using these entries, see InternedTable.
+ */
+struct InternedString
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-8);
+
+  std::uint64_t id = {}; /**< Id of the string, referred to by events */
+  std::string value;
+};
+
+/** Maps ids to strings, as read from InternedString entries */
+using InternedTable = std::unordered_map<std::uint64_t, std::string>;
+
+/**
+ * Message of a logged std::error_code, see adapt_stderrorcode.hpp.
+ *
+ * The entry precedes the first event that refers to
+ * the error code of `category` and `value`.
+ * Readers resolve the error codes logged by events
+ * to messages using these entries, see ErrorCodeMessageTable.
+ */
+struct ErrorCodeMessage
+{
+  static constexpr std::uint64_t Tag = std::uint64_t(-9);
+
+  std::uint64_t category = {}; /**< Address of the std::error_category in the producer program */
+  std::int32_t value = {};
+  std::string message;         /**< category.message(value) */
+};
+
+/** Maps (category, value) pairs to messages, as read from ErrorCodeMessage entries */
+using ErrorCodeMessageTable = std::map<std::pair<std::uint64_t, std::int32_t>, std::string>;
+
 /**
  * Represents a log event (one line in a logfile).
  *
@@ -147,6 +308,48 @@ std::size_t serializeSizePrefixedTagged(const Entry& entry, OutputStream& out)
   return size + sizeof(size);
 }
 
+namespace detail {
+
+inline mserialize::string_view readStringView(Range& input)
+{
+  const std::uint32_t size = input.read<std::uint32_t>();
+  return mserialize::string_view(input.view(size), size);
+}
+
+} // namespace detail
+
+/**
+ * Deserialize an EventSource from `input` (the payload of
+ * an EventSource entry, after the tag) without copying:
+ * the strings of the result refer to the buffer of `input`.
+ *
+ * @throws std::runtime_error if `input` does not contain a complete EventSource
+ */
+inline EventSourceView deserializeEventSourceView(Range& input)
+{
+  EventSourceView result;
+  result.id = input.read<std::uint64_t>();
+  result.severity = static_cast<Severity>(input.read<std::underlying_type<Severity>::type>());
+  result.category = detail::readStringView(input);
+  result.function = detail::readStringView(input);
+  result.file = detail::readStringView(input);
+  result.line = input.read<std::uint64_t>();
+  result.formatString = detail::readStringView(input);
+  result.argumentTags = detail::readStringView(input);
+  return result;
+}
+
+/** @returns an EventSource that owns a copy of the strings of `view` */
+inline EventSource toEventSource(const EventSourceView& view)
+{
+  return EventSource{
+    view.id, view.severity,
+    view.category.to_string(), view.function.to_string(), view.file.to_string(),
+    view.line,
+    view.formatString.to_string(), view.argumentTags.to_string()
+  };
+}
+
 } // namespace binlog
 
 MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::EventSource, id, severity, category, function, file, line, formatString, argumentTags)
@@ -158,4 +361,19 @@ MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::WriterProp, id, name, batchSize)
 MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::ClockSync, clockValue, clockFrequency, nsSinceEpoch, tzOffset, tzName)
 MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::ClockSync, clockValue, clockFrequency, nsSinceEpoch, tzOffset, tzName)
 
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::EventBatch, clockBase)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::EventBatch, clockBase)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::BlockSummary, minClock, maxClock, blockSize, hasMetadata, sources, checksum)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::BlockSummary, minClock, maxClock, blockSize, hasMetadata, sources, checksum)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::LiteralString, address, value)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::LiteralString, address, value)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::ErrorCodeMessage, category, value, message)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::ErrorCodeMessage, category, value, message)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(  binlog::InternedString, id, value)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(binlog::InternedString, id, value)
+
 #endif // BINLOG_ENTRIES_HPP
@@ -1,8 +1,17 @@
 #include <binlog/EntryStream.hpp>
 
+#include <binlog/Codec.hpp>
+#include <binlog/Entries.hpp> // CompressedFrame
+#include <binlog/detail/Crc32c.hpp>
+
+#include <mserialize/deserialize.hpp>
+
+#include <algorithm> // search
 #include <cstdint>
+#include <cstring> // memcpy
 #include <istream>
 #include <stdexcept>
+#include <utility> // move
 
 namespace binlog {
 
@@ -56,4 +65,312 @@ Range RangeEntryStream::nextEntryPayload()
   return Range{_input.view(size), size};
 }
 
+namespace {
+
+bool isCompressedFrame(Range payload)
+{
+  return payload.size() >= sizeof(std::uint64_t)
+      && payload.read<std::uint64_t>() == CompressedFrame::Tag;
+}
+
+enum class EntryCheck { notChecked, noChecksum, valid, invalid };
+
+// u64 tag | u8 codec | u32 uncompressedSize | u32 compressedSize | data | u32 checksum
+constexpr std::size_t frameHeaderSize = sizeof(std::uint64_t) + sizeof(std::uint8_t) + 2 * sizeof(std::uint32_t);
+
+// BlockSummary entries have a fixed size, the checksum is the last field
+const std::size_t summarySize = sizeof(std::uint64_t) + mserialize::serialized_size(BlockSummary{});
+
+EntryCheck checkSummary(Range payload)
+{
+  const std::size_t size = payload.size();
+  const char* p = payload.view(size);
+  if (size < summarySize) { return EntryCheck::invalid; }
+
+  const std::size_t checkedSize = summarySize - sizeof(std::uint32_t);
+  std::uint32_t checksum;
+  memcpy(&checksum, p + checkedSize, sizeof(checksum));
+  return (detail::crc32c(p, checkedSize) == checksum) ? EntryCheck::valid : EntryCheck::invalid;
+}
+
+EntryCheck checkEntry(Range payload)
+{
+  if (payload.size() >= sizeof(std::uint64_t))
+  {
+    Range tagRange = payload;
+    if (tagRange.read<std::uint64_t>() == BlockSummary::Tag) { return checkSummary(payload); }
+  }
+
+  if (! isCompressedFrame(payload)) { return EntryCheck::notChecked; }
+
+  const std::size_t size = payload.size();
+  const char* p = payload.view(size);
+  if (size < frameHeaderSize) { return EntryCheck::invalid; }
+
+  std::uint32_t compressedSize;
+  memcpy(&compressedSize, p + frameHeaderSize - sizeof(compressedSize), sizeof(compressedSize));
+  const std::size_t checkedSize = frameHeaderSize + compressedSize;
+  if (size == checkedSize) { return EntryCheck::noChecksum; }
+  if (size < checkedSize + sizeof(std::uint32_t)) { return EntryCheck::invalid; }
+
+  std::uint32_t checksum;
+  memcpy(&checksum, p + checkedSize, sizeof(checksum));
+  return (detail::crc32c(p, checkedSize) == checksum) ? EntryCheck::valid : EntryCheck::invalid;
+}
+
+std::vector<char> decompressFrame(Codec codec, const std::vector<char>& compressed, std::uint32_t uncompressedSize)
+{
+  std::vector<char> result(uncompressedSize);
+  detail::decompress(codec, compressed.data(), compressed.size(), result.data(), result.size());
+  return result;
+}
+
+} // namespace
+
+DecompressedEntryStream::DecompressedEntryStream(EntryStream& input, unsigned threadCount)
+  :_input(input),
+   _threadCount(threadCount ? threadCount : 1)
+{}
+
+Range DecompressedEntryStream::nextEntryPayload()
+{
+  while (true)
+  {
+    if (! _frame.empty())
+    {
+      try
+      {
+        const std::uint32_t size = _frame.read<std::uint32_t>();
+        return Range{_frame.view(size), size};
+      }
+      catch (...)
+      {
+        _frame = Range{}; // drop the rest of the invalid frame
+        throw;
+      }
+    }
+
+    if (_pending.empty())
+    {
+      const Range payload = _input.nextEntryPayload();
+      if (skipFrame(payload)) { continue; }
+      if (! isCompressedFrame(payload)) { return payload; } // also covers eof
+      push(payload);
+    }
+
+    readAhead();
+
+    Pending pending = std::move(_pending.front());
+    _pending.pop_front();
+    if (pending.isFrame) { --_pendingFrames; }
+
+    if (pending.error) { std::rethrow_exception(pending.error); }
+    _buffer = (pending.asyncData.valid()) ? pending.asyncData.get() : std::move(pending.data);
+
+    const Range data{_buffer.data(), _buffer.size()};
+    if (! pending.isFrame) { return data; }
+    _frame = data;
+  }
+}
+
+void DecompressedEntryStream::push(Range payload)
+{
+  Pending pending;
+
+  if (isCompressedFrame(payload))
+  {
+    payload.read<std::uint64_t>(); // tag
+    const Codec codec = static_cast<Codec>(payload.read<std::uint8_t>());
+    const std::uint32_t uncompressedSize = payload.read<std::uint32_t>();
+    const std::uint32_t compressedSize = payload.read<std::uint32_t>();
+    const char* compressed = payload.view(compressedSize);
+
+    pending.isFrame = true;
+    if (_threadCount > 1)
+    {
+      pending.asyncData = std::async(std::launch::async, decompressFrame,
+        codec, std::vector<char>(compressed, compressed + compressedSize), uncompressedSize);
+    }
+    else
+    {
+      pending.data.resize(uncompressedSize);
+      detail::decompress(codec, compressed, compressedSize, pending.data.data(), pending.data.size());
+    }
+  }
+  else
+  {
+    const std::size_t size = payload.size();
+    const char* data = payload.view(size);
+    pending.data.assign(data, data + size);
+  }
+
+  _pending.push_back(std::move(pending));
+  if (_pending.back().isFrame) { ++_pendingFrames; }
+}
+
+void DecompressedEntryStream::readAhead()
+{
+  // stop at the first error, report it only after the preceding entries
+  while (_pendingFrames < _threadCount && ! _pending.back().error)
+  {
+    try
+    {
+      const Range payload = _input.nextEntryPayload();
+      if (payload.empty()) { break; } // eof
+      if (! skipFrame(payload)) { push(payload); }
+    }
+    catch (...)
+    {
+      Pending pending;
+      pending.error = std::current_exception();
+      _pending.push_back(std::move(pending));
+    }
+  }
+}
+
+void DecompressedEntryStream::setBlockFilter(std::function<bool(const BlockSummary&)> filter)
+{
+  _blockFilter = std::move(filter);
+}
+
+bool DecompressedEntryStream::skipFrame(Range payload)
+{
+  const bool skipThis = _skipNextFrame;
+  _skipNextFrame = false;
+  if (! _blockFilter || payload.size() < sizeof(std::uint64_t)) { return false; }
+
+  const std::uint64_t tag = payload.read<std::uint64_t>();
+  if (tag == BlockSummary::Tag)
+  {
+    BlockSummary summary;
+    mserialize::deserialize(summary, payload);
+    _skipNextFrame = ! summary.hasMetadata && ! _blockFilter(summary);
+  }
+  else if (tag == CompressedFrame::Tag && skipThis)
+  {
+    ++_skippedFrames;
+    return true;
+  }
+
+  return false;
+}
+
+CheckedIstreamEntryStream::CheckedIstreamEntryStream(std::istream& input)
+  :_input(input)
+{}
+
+Range CheckedIstreamEntryStream::nextEntryPayload()
+{
+  // the previously returned entry is not needed anymore
+  _buffer.erase(_buffer.begin(), _buffer.begin() + std::ptrdiff_t(_pos));
+  _pos = 0;
+
+  // reject implausible sizes, do not read the whole input looking for the end of a corrupt entry
+  constexpr std::uint32_t maxCheckedEntrySize = std::uint32_t(1) << 30;
+
+  while (true)
+  {
+    const std::size_t available = fill(sizeof(std::uint32_t));
+    if (available == 0) { return {}; } // eof
+
+    std::size_t expected = sizeof(std::uint32_t);
+    if (available >= expected)
+    {
+      std::uint32_t size;
+      memcpy(&size, _buffer.data() + _pos, sizeof(size));
+      expected += size;
+
+      if ((! _checked || size <= maxCheckedEntrySize) && fill(expected) >= expected)
+      {
+        const Range payload{_buffer.data() + _pos + sizeof(size), size};
+        const EntryCheck check = checkEntry(payload);
+        if (check == EntryCheck::valid || (! _checked && check != EntryCheck::invalid))
+        {
+          _checked = _checked || check == EntryCheck::valid;
+          _pos += expected;
+          return payload;
+        }
+
+        // an entry with invalid checksum: this is a checked stream, recover
+        _checked = true;
+      }
+    }
+
+    if (! _checked)
+    {
+      throw std::runtime_error("Failed to read entry from istream, only got "
+        + std::to_string(fill(expected)) + " bytes, expected " + std::to_string(expected));
+    }
+
+    skipToNextCheckedEntry();
+  }
+}
+
+std::size_t CheckedIstreamEntryStream::fill(std::size_t size)
+{
+  const std::size_t available = _buffer.size() - _pos;
+  if (available < size)
+  {
+    readMore(size - available);
+  }
+  return _buffer.size() - _pos;
+}
+
+bool CheckedIstreamEntryStream::readMore(std::size_t size)
+{
+  const std::size_t oldSize = _buffer.size();
+  _buffer.resize(oldSize + size);
+  _input.read(_buffer.data() + oldSize, std::streamsize(size));
+  _buffer.resize(oldSize + std::size_t(_input.gcount()));
+  return _buffer.size() != oldSize;
+}
+
+void CheckedIstreamEntryStream::skipToNextCheckedEntry()
+{
+  const std::uint64_t frameTag = CompressedFrame::Tag;
+  const std::uint64_t summaryTag = BlockSummary::Tag;
+  char frameTagBytes[sizeof(frameTag)];
+  char summaryTagBytes[sizeof(summaryTag)];
+  memcpy(frameTagBytes, &frameTag, sizeof(frameTag));
+  memcpy(summaryTagBytes, &summaryTag, sizeof(summaryTag));
+
+  // an entry starts with the size, followed by the tag
+  constexpr std::size_t tagOffset = sizeof(std::uint32_t);
+  constexpr std::size_t tagSize = sizeof(std::uint64_t);
+
+  std::size_t from = _pos + 1; // skip the corrupt entry at _pos
+  while (true)
+  {
+    if (_buffer.size() >= from + tagOffset)
+    {
+      const auto first = _buffer.begin() + std::ptrdiff_t(from + tagOffset);
+      const auto it = std::min(
+        std::search(first, _buffer.end(), frameTagBytes, frameTagBytes + tagSize),
+        std::search(first, _buffer.end(), summaryTagBytes, summaryTagBytes + tagSize)
+      );
+      if (it != _buffer.end())
+      {
+        const std::size_t next = std::size_t(it - _buffer.begin()) - tagOffset;
+        _skippedBytes += next - _pos;
+        _pos = next;
+        return;
+      }
+
+      // tag not found, drop everything but the bytes that might be the start of an entry
+      from = std::max(from, _buffer.size() - std::min(_buffer.size(), tagOffset + tagSize - 1));
+    }
+
+    _skippedBytes += from - _pos;
+    _buffer.erase(_buffer.begin(), _buffer.begin() + std::ptrdiff_t(from));
+    _pos = from = 0;
+
+    if (! readMore(1 << 12))
+    {
+      _skippedBytes += _buffer.size(); // no more entries, the rest is garbage
+      _buffer.clear();
+      return;
+    }
+  }
+}
+
 } // namespace binlog
@@ -3,11 +3,18 @@
 
 #include <binlog/Range.hpp>
 
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iosfwd>
 #include <vector>
 
 namespace binlog {
 
+struct BlockSummary;
+
 /**
  * Interface of extracting entries from an underlying device.
  *
@@ -77,6 +84,135 @@ private:
   Range _input;
 };
 
+/**
+ * Entry stream that expands CompressedFrame entries of another EntryStream.
+ *
+ * Entries of the underlying stream that are not compressed frames
+ * are passed through unchanged, therefore this stream can read
+ * both compressed and uncompressed (or mixed) binlog streams.
+ *
+ * If `threadCount` is greater than one, up to `threadCount`
+ * frames are read ahead and decompressed in parallel.
+ *
+ * @see CompressedOutputStream
+ */
+class DecompressedEntryStream : public EntryStream
+{
+public:
+  /**
+   * Stores a reference to `input`: it must remain valid
+   * as long as *this is valid
+   */
+  explicit DecompressedEntryStream(EntryStream& input, unsigned threadCount = 1);
+
+  /**
+   * @see EntryStream::nextEntryPayload
+   *
+   * The returned range remains valid until the next call.
+   *
+   * Errors of the underlying stream are reported
+   * in order, after the entries that preceded them.
+   *
+   * @throw std::runtime_error if a compressed frame
+   *        is invalid and cannot be decompressed.
+   *        The invalid frame is skipped.
+   */
+  Range nextEntryPayload() override;
+
+  /**
+   * Skip compressed frames that are not needed, without decompressing them.
+   *
+   * `filter` is called with each BlockSummary found in the input:
+   * if it returns false, the frame that follows the summary is skipped.
+   * Frames that contain metadata are never skipped.
+   * Because of read ahead, `filter` might be called before
+   * the entries preceding the summary are returned.
+   */
+  void setBlockFilter(std::function<bool(const BlockSummary&)> filter);
+
+  /** @returns the number of frames skipped by the block filter so far */
+  std::size_t skippedFrames() const { return _skippedFrames; }
+
+private:
+  /** Entry read from the underlying stream */
+  struct Pending
+  {
+    bool isFrame = false;
+    std::vector<char> data; /**< Decompressed frame or entry payload */
+    std::future<std::vector<char>> asyncData; /**< Decompressed frame, if valid() */
+    std::exception_ptr error; /**< Error of the underlying stream */
+  };
+
+  void push(Range payload);
+
+  void readAhead();
+
+  bool skipFrame(Range payload);
+
+  EntryStream& _input;
+  const unsigned _threadCount;
+  std::deque<Pending> _pending;
+  unsigned _pendingFrames = 0;
+
+  std::function<bool(const BlockSummary&)> _blockFilter;
+  bool _skipNextFrame = false;
+  std::size_t _skippedFrames = 0;
+
+  std::vector<char> _buffer; /**< Last popped Pending::data */
+  Range _frame;              /**< Remaining entries of the current frame */
+};
+
+/**
+ * Entry stream with a std::istream as the underlying device,
+ * that verifies the checksum of CompressedFrame entries,
+ * and recovers from corruption by skipping to the next valid frame.
+ *
+ * Streams without checksummed frames (e.g: not written by CompressedOutputStream)
+ * are read as IstreamEntryStream would, without recovery.
+ * After the first valid checksummed frame, every entry
+ * is expected to be such a frame, or a BlockSummary. Other entries,
+ * and entries with an invalid checksum or size are considered to be corrupt:
+ * the stream is searched for the next frame or summary tag (the sync marker),
+ * that starts a valid entry, and the bytes in between are skipped.
+ *
+ * Use DecompressedEntryStream to expand the returned frames.
+ */
+class CheckedIstreamEntryStream : public EntryStream
+{
+public:
+  /**
+   * Stores a reference to `input`: it must remain valid
+   * as long as *this is valid
+   */
+  explicit CheckedIstreamEntryStream(std::istream& input);
+
+  /**
+   * @see EntryStream::nextEntryPayload
+   *
+   * The returned range remains valid until the next call.
+   *
+   * @throw std::runtime_error if a complete entry cannot be read,
+   *        and there was no valid checksummed frame in the stream so far.
+   */
+  Range nextEntryPayload() override;
+
+  /** @returns the number of corrupt bytes skipped so far */
+  std::size_t skippedBytes() const { return _skippedBytes; }
+
+private:
+  std::size_t fill(std::size_t size);
+
+  bool readMore(std::size_t size);
+
+  void skipToNextCheckedEntry();
+
+  std::istream& _input;
+  std::vector<char> _buffer; /**< Bytes read from `input` */
+  std::size_t _pos = 0;      /**< Start of the next entry in `_buffer` */
+  bool _checked = false;     /**< True if a valid checksummed frame was found */
+  std::size_t _skippedBytes = 0;
+};
+
 } // namespace binlog
 
 #endif // BINLOG_ENTRY_STREAM_HPP
@@ -3,15 +3,19 @@
 
 #include <binlog/Entries.hpp> // EventSource
 #include <binlog/Range.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
 
 #include <mserialize/deserialize.hpp>
+#include <mserialize/serialize.hpp>
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring> // memcpy
 #include <functional>
 #include <ios> // streamsize
 #include <set>
 #include <stdexcept> // runtime_error
+#include <type_traits>
 #include <utility> // move
 
 namespace binlog {
@@ -23,11 +27,25 @@ namespace binlog {
 class EventFilter
 {
 public:
-  using Predicate = std::function<bool(const EventSource&)>;
+  using Predicate = std::function<bool(const EventSourceView&)>;
 
-  /** @param isAllowed should return true for allowed EventSources */
+  /**
+   * @param isAllowed should return true for allowed EventSources.
+   *        The strings of its argument are valid only during the call.
+   */
   explicit EventFilter(Predicate isAllowed);
 
+  /**
+   * Same as above, but with a predicate that takes an EventSource,
+   * that is constructed for each call: prefer taking EventSourceView
+   * to avoid the allocations.
+   */
+  template <typename SourcePredicate, typename = typename std::enable_if<
+    ! std::is_convertible<SourcePredicate, Predicate>::value
+    && std::is_convertible<SourcePredicate, std::function<bool(const EventSource&)>>::value
+  >::type>
+  explicit EventFilter(SourcePredicate isAllowed);
+
   /**
    * From the sequence of entries in [buffer, buffer+bufferSize),
    * write special entries and events produced allowed EventSources
@@ -38,9 +56,12 @@ public:
    *  - EventSources are categorized by the Predicate given in the constructor
    *    as either allowed or disallowed sources.
    *  - Events are written to `out` only if produced by allowed EventSources.
+   *  - EventBatches are written to `out` with only the events produced by
+   *    allowed EventSources. Batches without such events are not written.
    *
    * The predicate is invoked for each EventSource, but not for Events.
-   * Only EventSources are deserialized, other entries are categorized by their tags.
+   * Only EventSources are deserialized (without copying the strings),
+   * other entries are categorized by their tags.
    *
    * @requires OutputStream must model the mserialize::OutputStream concept
    * @throws std::runtime_error if `buffer` contains an invalid entry
@@ -49,14 +70,28 @@ public:
   std::size_t writeAllowed(const char* buffer, std::size_t bufferSize, OutputStream& out);
 
 private:
+  /**
+   * Write the EventBatch in `payload` to `_batchBuffer`,
+   * keeping only special entries and allowed events.
+   *
+   * @returns true if at least one entry was kept
+   */
+  bool filterEventBatch(Range payload);
+
   Predicate _isAllowed;
   std::set<std::uint64_t> _allowedSourceIds; // TODO(benedek) perf: use a more efficient set
+  detail::VectorOutputStream _batchBuffer;
 };
 
 inline EventFilter::EventFilter(Predicate isAllowed)
   :_isAllowed(std::move(isAllowed))
 {}
 
+template <typename SourcePredicate, typename>
+EventFilter::EventFilter(SourcePredicate isAllowed)
+  :_isAllowed([isAllowed](const EventSourceView& view) { return isAllowed(toEventSource(view)); })
+{}
+
 template <typename OutputStream>
 std::size_t EventFilter::writeAllowed(const char* buffer, std::size_t bufferSize, OutputStream& out)
 {
@@ -77,8 +112,7 @@ std::size_t EventFilter::writeAllowed(const char* buffer, std::size_t bufferSize
       // event sources are inspected to populate _allowedSourceIds
       if (tag == EventSource::Tag)
       {
-        EventSource eventSource;
-        mserialize::deserialize(eventSource, payload);
+        const EventSourceView eventSource = deserializeEventSourceView(payload);
         if (_isAllowed(eventSource))
         {
           _allowedSourceIds.insert(eventSource.id);
@@ -86,6 +120,16 @@ std::size_t EventFilter::writeAllowed(const char* buffer, std::size_t bufferSize
         // else: event source is not allowed, events referencing it
         // will not be written.
       }
+      else if (tag == EventBatch::Tag)
+      {
+        // events of the batch are filtered one by one
+        if (filterEventBatch(payload))
+        {
+          out.write(_batchBuffer.data(), _batchBuffer.ssize());
+          totalWriteSize += _batchBuffer.vector.size();
+        }
+        continue;
+      }
     }
     else if (_allowedSourceIds.count(tag) == 0)
     {
@@ -103,6 +147,42 @@ std::size_t EventFilter::writeAllowed(const char* buffer, std::size_t bufferSize
   return totalWriteSize;
 }
 
+inline bool EventFilter::filterEventBatch(Range payload)
+{
+  EventBatch batch;
+  mserialize::deserialize(batch, payload);
+
+  // size is not known yet, written below
+  const std::uint32_t placeholderSize = 0;
+  const std::uint64_t batchTag = EventBatch::Tag;
+  _batchBuffer.clear();
+  mserialize::serialize(placeholderSize, _batchBuffer);
+  mserialize::serialize(batchTag, _batchBuffer);
+  mserialize::serialize(batch, _batchBuffer);
+
+  bool hasEntries = false;
+  while (! payload.empty())
+  {
+    Range entry = payload;
+    const std::uint32_t size = payload.read<std::uint32_t>();
+    Range entryPayload(payload.view(size), size);
+    const std::uint64_t tag = entryPayload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+
+    if (special || _allowedSourceIds.count(tag) != 0)
+    {
+      const std::size_t sizePrefixedSize = size + sizeof(size);
+      _batchBuffer.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+      hasEntries = true;
+    }
+  }
+
+  const std::uint32_t batchSize = std::uint32_t(_batchBuffer.vector.size() - sizeof(batchSize));
+  memcpy(_batchBuffer.vector.data(), &batchSize, sizeof(batchSize));
+
+  return hasEntries;
+}
+
 } // namespace binlog
 
 #endif // BINLOG_EVENT_FILTER_HPP
@@ -1,6 +1,9 @@
 #include <binlog/EventStream.hpp>
 
 #include <mserialize/deserialize.hpp>
+#include <mserialize/detail/varint.hpp>
+
+#include <utility> // make_pair, move
 
 namespace binlog {
 
@@ -8,7 +11,8 @@ const Event* EventStream::nextEvent(EntryStream& input)
 {
   while (true)
   {
-    Range range = input.nextEntryPayload();
+    const bool inBatch = ! _batchEntries.empty();
+    Range range = inBatch ? nextBatchEntryPayload() : input.nextEntryPayload();
     if (range.empty()) { return nullptr; }
 
     const std::uint64_t tag = range.read<std::uint64_t>();
@@ -27,23 +31,55 @@ const Event* EventStream::nextEvent(EntryStream& input)
         case ClockSync::Tag:
           readClockSync(range);
           break;
+        case EventBatch::Tag:
+          readEventBatch(range);
+          break;
+        case LiteralString::Tag:
+          readLiteralString(range);
+          break;
+        case InternedString::Tag:
+          readInternedString(range);
+          break;
+        case ErrorCodeMessage::Tag:
+          readErrorCodeMessage(range);
+          break;
         // default: ignore unkown special entries
         // to be forward compatible.
       }
     }
     else
     {
-      readEvent(tag, range);
+      readEvent(tag, range, inBatch);
       return &_event;
     }
   }
 }
 
+namespace {
+
+void assignString(std::string& dst, mserialize::string_view src)
+{
+  dst.assign(src.data(), src.size()); // reuses the capacity of dst, if possible
+}
+
+} // namespace
+
 void EventStream::readEventSource(Range range)
 {
-  EventSource eventSource;
-  mserialize::deserialize(eventSource, range);
-  _eventSources[eventSource.id] = std::move(eventSource);
+  // Deserialize a view first, and assign the strings in place:
+  // sources seen again (e.g: metadata repeated after log rotation)
+  // do not allocate memory.
+  const EventSourceView view = deserializeEventSourceView(range);
+
+  EventSource& eventSource = _eventSources[view.id];
+  eventSource.id = view.id;
+  eventSource.severity = view.severity;
+  assignString(eventSource.category, view.category);
+  assignString(eventSource.function, view.function);
+  assignString(eventSource.file, view.file);
+  eventSource.line = view.line;
+  assignString(eventSource.formatString, view.formatString);
+  assignString(eventSource.argumentTags, view.argumentTags);
 }
 
 void EventStream::readWriterProp(Range range)
@@ -62,7 +98,51 @@ void EventStream::readClockSync(Range range)
   _clockSync = std::move(clockSync);
 }
 
-void EventStream::readEvent(std::uint64_t eventSourceId, Range range)
+void EventStream::readEventBatch(Range range)
+{
+  // Make sure _eventBatch is updated only if deserialize does not throw
+  EventBatch eventBatch;
+  mserialize::deserialize(eventBatch, range);
+  _eventBatch = eventBatch;
+  _batchEntries = range;
+}
+
+void EventStream::readLiteralString(Range range)
+{
+  LiteralString literal;
+  mserialize::deserialize(literal, range);
+  _literals[literal.address] = std::move(literal.value);
+}
+
+void EventStream::readInternedString(Range range)
+{
+  InternedString interned;
+  mserialize::deserialize(interned, range);
+  _interned[interned.id] = std::move(interned.value);
+}
+
+void EventStream::readErrorCodeMessage(Range range)
+{
+  ErrorCodeMessage ecm;
+  mserialize::deserialize(ecm, range);
+  _errorCodeMessages[std::make_pair(ecm.category, ecm.value)] = std::move(ecm.message);
+}
+
+Range EventStream::nextBatchEntryPayload()
+{
+  // drop the rest of the batch if the entry is invalid
+  Range entries = _batchEntries;
+  _batchEntries = Range{};
+
+  const std::uint32_t size = entries.read<std::uint32_t>();
+  if (size == 0) { throw std::runtime_error("Empty entry in EventBatch"); }
+  const Range payload(entries.view(size), size);
+
+  _batchEntries = entries;
+  return payload;
+}
+
+void EventStream::readEvent(std::uint64_t eventSourceId, Range range, bool inBatch)
 {
   auto it = _eventSources.find(eventSourceId);
   if (it == _eventSources.end())
@@ -71,7 +151,15 @@ void EventStream::readEvent(std::uint64_t eventSourceId, Range range)
   }
 
   _event.source = &it->second;
-  _event.clockValue = range.read<std::uint64_t>();
+  if (inBatch)
+  {
+    const std::int64_t delta = mserialize::detail::zigzag_decode(mserialize::detail::read_varint(range));
+    _event.clockValue = _eventBatch.clockBase + std::uint64_t(delta);
+  }
+  else
+  {
+    _event.clockValue = range.read<std::uint64_t>();
+  }
   _event.arguments = range;
 }
 
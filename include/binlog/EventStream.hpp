@@ -25,6 +25,11 @@ public:
    * it is droppend, *this remains unchanged
    * and an exception is thrown.
    *
+   * Entries of an EventBatch are read one by one,
+   * `input` is advanced only after the last one.
+   * If an entry of an EventBatch is invalid,
+   * the rest of the batch is dropped.
+   *
    * @param input contains binlog entries
    * @returns pointer to the next event
    *          or nullptr on `input` returns an empty entry
@@ -46,6 +51,24 @@ public:
    */
   const ClockSync& clockSync() const { return _clockSync; }
 
+  /**
+   * @return the strings of binlog::literal arguments,
+   *         by address, consumed from the stream so far.
+   */
+  const LiteralTable& literals() const { return _literals; }
+
+  /**
+   * @return the strings of binlog::interned arguments,
+   *         by id, consumed from the stream so far.
+   */
+  const InternedTable& interned() const { return _interned; }
+
+  /**
+   * @return the messages of std::error_code arguments,
+   *         by category and value, consumed from the stream so far.
+   */
+  const ErrorCodeMessageTable& errorCodeMessages() const { return _errorCodeMessages; }
+
 private:
   void readEventSource(Range range);
 
@@ -53,11 +76,26 @@ private:
 
   void readClockSync(Range range);
 
-  void readEvent(std::uint64_t eventSourceId, Range range);
+  void readEventBatch(Range range);
+
+  void readLiteralString(Range range);
+
+  void readInternedString(Range range);
+
+  void readErrorCodeMessage(Range range);
+
+  Range nextBatchEntryPayload();
+
+  void readEvent(std::uint64_t eventSourceId, Range range, bool inBatch);
 
   std::map<std::uint64_t, EventSource> _eventSources; // TODO(benedek) perf: use SegmentedMap
   WriterProp _writerProp;
   ClockSync _clockSync;
+  EventBatch _eventBatch;
+  LiteralTable _literals;
+  InternedTable _interned;
+  ErrorCodeMessageTable _errorCodeMessages;
+  Range _batchEntries; /**< Unread entries of the current EventBatch */
   Event _event;
 };
 
@@ -0,0 +1,267 @@
+#include <binlog/FanoutOutputStream.hpp>
+
+#include <binlog/Entries.hpp> // EventBatch, WriterProp
+#include <binlog/Range.hpp>
+
+#include <cstdint>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <utility> // move
+
+namespace binlog {
+
+namespace {
+
+bool isSpecial(std::uint64_t tag)
+{
+  return (tag & (std::uint64_t(1) << 63)) != 0;
+}
+
+// Session::consume writes a WriterProp, then the batch it describes
+bool isWriterProp(const char* data, std::streamsize size)
+{
+  std::uint32_t entrySize;
+  std::uint64_t tag;
+  if (size < std::streamsize(sizeof(entrySize) + sizeof(tag))) { return false; }
+  memcpy(&entrySize, data, sizeof(entrySize));
+  memcpy(&tag, data + sizeof(entrySize), sizeof(tag));
+  return tag == WriterProp::Tag && std::streamsize(sizeof(entrySize) + entrySize) == size;
+}
+
+// Append the special entries of `entries` to `out`, except event batches,
+// but including the special entries of the batches.
+void appendSpecialEntries(Range entries, std::vector<char>& out)
+{
+  while (! entries.empty())
+  {
+    Range entry = entries;
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range payload(entries.view(size), size);
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+
+    if (tag == EventBatch::Tag)
+    {
+      payload.read<std::uint64_t>(); // clockBase, batched events are dropped
+      appendSpecialEntries(payload, out);
+    }
+    else if (isSpecial(tag))
+    {
+      const char* begin = entry.view(sizeof(size) + size);
+      out.insert(out.end(), begin, begin + sizeof(size) + size);
+    }
+  }
+}
+
+} // namespace
+
+FanoutOutputStream::FanoutOutputStream(std::size_t chunkSize)
+  :_chunkSize(chunkSize)
+{
+  _chunk.reserve(chunkSize);
+}
+
+FanoutOutputStream::~FanoutOutputStream()
+{
+  publish();
+
+  for (const std::unique_ptr<SinkState>& state : _sinks)
+  {
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->stop = true;
+    }
+    state->cv.notify_all();
+  }
+
+  for (const std::unique_ptr<SinkState>& state : _sinks)
+  {
+    state->thread.join();
+  }
+}
+
+std::size_t FanoutOutputStream::addSink(Sink sink, OverflowPolicy policy, std::size_t backlogCapacity)
+{
+  if (_written)
+  {
+    throw std::logic_error("FanoutOutputStream: sinks must be added before the first write");
+  }
+
+  std::unique_ptr<SinkState> state(new SinkState);
+  state->sink = std::move(sink);
+  state->policy = policy;
+  state->backlogCapacity = backlogCapacity;
+  state->thread = std::thread(&FanoutOutputStream::sinkLoop, std::ref(*state));
+
+  _sinks.push_back(std::move(state));
+  return _sinks.size() - 1;
+}
+
+FanoutOutputStream& FanoutOutputStream::write(const char* data, std::streamsize size)
+{
+  _written = true;
+  _chunk.insert(_chunk.end(), data, data + size);
+
+  // do not separate a WriterProp from the following events:
+  // if only the next chunk is dropped, the WriterProp is still retained,
+  // but if only this chunk is dropped, the events are attributed to a different writer.
+  if (_chunk.size() >= _chunkSize && ! isWriterProp(data, size))
+  {
+    publish();
+  }
+
+  return *this;
+}
+
+void FanoutOutputStream::flush()
+{
+  publish();
+}
+
+void FanoutOutputStream::drain()
+{
+  publish();
+
+  for (const std::unique_ptr<SinkState>& state : _sinks)
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&state]() { return state->backlog.empty() && ! state->busy; });
+  }
+}
+
+std::size_t FanoutOutputStream::droppedBytes(std::size_t sinkIndex) const
+{
+  const SinkState& state = *_sinks.at(sinkIndex);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.droppedBytes;
+}
+
+std::exception_ptr FanoutOutputStream::error(std::size_t sinkIndex) const
+{
+  const SinkState& state = *_sinks.at(sinkIndex);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.error;
+}
+
+void FanoutOutputStream::publish()
+{
+  if (_chunk.empty()) { return; }
+
+  const Chunk chunk = std::make_shared<const std::vector<char>>(std::move(_chunk));
+  _chunk.clear(); // moved-from vector is valid but unspecified
+  _chunk.reserve(_chunkSize);
+
+  std::vector<char> retained;
+  bool hasRetained = false;
+  for (const std::unique_ptr<SinkState>& state : _sinks)
+  {
+    handOver(*state, chunk, retained, hasRetained);
+  }
+}
+
+void FanoutOutputStream::handOver(SinkState& state, const Chunk& chunk, std::vector<char>& retained, bool& hasRetained)
+{
+  const std::size_t size = chunk->size();
+  const auto fits = [&state, size]() { return state.backlog.empty() || state.backlogSize + size <= state.backlogCapacity; };
+
+  {
+    std::unique_lock<std::mutex> lock(state.mutex);
+
+    if (state.error)
+    {
+      // the sink failed, and is not called anymore
+      state.droppedBytes += size;
+      return;
+    }
+
+    if (state.policy == OverflowPolicy::block)
+    {
+      state.cv.wait(lock, [&state, &fits]() { return fits() || state.error; });
+      if (state.error)
+      {
+        state.droppedBytes += size;
+        return;
+      }
+    }
+
+    if (fits())
+    {
+      state.backlog.push_back(SinkState::Item{chunk, {}});
+      state.backlogSize += size;
+    }
+    else
+    {
+      // drop the chunk, but retain the special entries,
+      // they are required to read the rest of the stream.
+      // The retained entries are collected by a single item at the end,
+      // the backlog exceeds the capacity by at most that item.
+      if (! hasRetained)
+      {
+        try
+        {
+          appendSpecialEntries(Range(chunk->data(), size), retained);
+        }
+        catch (const std::runtime_error&)
+        {
+          // invalid entries, nothing can be retained
+        }
+        hasRetained = true;
+      }
+
+      if (! retained.empty())
+      {
+        if (state.backlog.back().chunk)
+        {
+          state.backlog.push_back(SinkState::Item{});
+        }
+        std::vector<char>& back = state.backlog.back().retained;
+        back.insert(back.end(), retained.begin(), retained.end());
+        state.backlogSize += retained.size();
+      }
+      state.droppedBytes += size - retained.size();
+    }
+  }
+
+  state.cv.notify_all();
+}
+
+void FanoutOutputStream::sinkLoop(SinkState& state)
+{
+  std::unique_lock<std::mutex> lock(state.mutex);
+
+  while (true)
+  {
+    state.cv.wait(lock, [&state]() { return state.stop || ! state.backlog.empty(); });
+    if (state.backlog.empty()) { return; } // stopped, and every chunk is processed
+
+    SinkState::Item item = std::move(state.backlog.front());
+    state.backlog.pop_front();
+    state.busy = true;
+    lock.unlock();
+
+    const std::vector<char>& data = (item.chunk) ? *item.chunk : item.retained;
+    std::exception_ptr error;
+    try
+    {
+      state.sink(data.data(), data.size());
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    state.backlogSize -= item.size();
+    state.busy = false;
+    if (error)
+    {
+      // stop calling the sink, drop the rest
+      state.error = error;
+      state.droppedBytes += state.backlogSize;
+      state.backlog.clear();
+      state.backlogSize = 0;
+    }
+    state.cv.notify_all();
+  }
+}
+
+} // namespace binlog
@@ -0,0 +1,168 @@
+#ifndef BINLOG_FANOUT_OUTPUT_STREAM_HPP
+#define BINLOG_FANOUT_OUTPUT_STREAM_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <ios> // streamsize
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace binlog {
+
+/**
+ * Write a binlog stream to multiple sinks, each on its own thread.
+ *
+ * Models mserialize::OutputStream.
+ * Suitable to write data consumed from Session directly.
+ *
+ * Written data is copied once, to a chunk. When the chunk reaches
+ * `chunkSize`, or `flush` is called, the chunk is handed over
+ * to every sink, shared by reference count (i.e: not copied again).
+ * Each sink is called by a dedicated thread, in the order of the chunks,
+ * so a slow sink (e.g: text conversion) does not slow down the others,
+ * and `write` is not slowed down by the sinks - except by the ones
+ * with the `block` policy, whose backlog is full.
+ *
+ * Each sink has a bounded backlog, the total size of the chunks
+ * handed over but not yet processed. If a chunk does not fit the backlog,
+ * depending on the policy of the sink, `write` either waits for the
+ * sink to catch up (`block`), or the chunk is dropped for that sink (`drop`).
+ * Entries of dropped chunks, that are required to read the rest
+ * of the stream (i.e: special entries other than event batches, e.g: EventSources),
+ * are still handed over to the sink, only the events are dropped.
+ *
+ * Sinks can filter the stream, e.g: by EventFilter.
+ * If a sink throws, it is not called again, the rest of the stream is
+ * dropped for that sink, and the exception is available by `error`.
+ * Other sinks are not affected.
+ */
+class FanoutOutputStream
+{
+public:
+  /**
+   * Called by the thread of the sink, with a sequence of complete entries.
+   * The buffer is valid only during the call.
+   */
+  using Sink = std::function<void(const char* buffer, std::size_t size)>;
+
+  enum class OverflowPolicy
+  {
+    block, /**< Wait until the backlog has room for the chunk */
+    drop,  /**< Drop the events of the chunk */
+  };
+
+  /** @param chunkSize size of the chunks handed over to the sinks */
+  explicit FanoutOutputStream(std::size_t chunkSize = 1 << 20);
+
+  /** Hand over the current chunk, wait until each sink processed its backlog */
+  ~FanoutOutputStream();
+
+  FanoutOutputStream(const FanoutOutputStream&) = delete;
+  void operator=(const FanoutOutputStream&) = delete;
+
+  FanoutOutputStream(FanoutOutputStream&&) = delete;
+  void operator=(FanoutOutputStream&&) = delete;
+
+  /**
+   * Add a sink, and start its thread.
+   *
+   * Sinks must be added before the first `write`,
+   * otherwise they would miss the metadata written earlier.
+   *
+   * @param backlogCapacity maximum number of bytes handed over but not yet
+   *        processed by `sink`. A chunk larger than this is handed over
+   *        if the backlog is empty.
+   * @returns the index of the sink
+   * @throws std::logic_error if called after `write`
+   */
+  std::size_t addSink(Sink sink, OverflowPolicy policy, std::size_t backlogCapacity = 1 << 26);
+
+  /**
+   * Add the binlog entries in [data, data+size) to the current chunk.
+   *
+   * If the size of the current chunk reaches `chunkSize`,
+   * the chunk is handed over to the sinks.
+   * Blocks if the backlog of a sink with the `block` policy is full.
+   *
+   * The entries in the buffer must be complete,
+   * no partial entry is allowed.
+   */
+  FanoutOutputStream& write(const char* data, std::streamsize size);
+
+  /** Hand over the current chunk to the sinks (even if it is not full), do not wait */
+  void flush();
+
+  /**
+   * Hand over the current chunk to the sinks,
+   * then wait until each sink processed its backlog.
+   */
+  void drain();
+
+  /** @returns the number of sinks */
+  std::size_t sinkCount() const { return _sinks.size(); }
+
+  /**
+   * @returns the number of bytes dropped for the sink at `sinkIndex` so far,
+   *          excluding the retained special entries.
+   * @pre sinkIndex < sinkCount()
+   */
+  std::size_t droppedBytes(std::size_t sinkIndex) const;
+
+  /**
+   * @returns the exception thrown by the sink at `sinkIndex`, or nullptr
+   * @pre sinkIndex < sinkCount()
+   */
+  std::exception_ptr error(std::size_t sinkIndex) const;
+
+private:
+  using Chunk = std::shared_ptr<const std::vector<char>>;
+
+  struct SinkState
+  {
+    /** Either a shared chunk, or the retained entries of dropped chunks */
+    struct Item
+    {
+      Chunk chunk;
+      std::vector<char> retained;
+
+      std::size_t size() const { return (chunk) ? chunk->size() : retained.size(); }
+    };
+
+    Sink sink;
+    OverflowPolicy policy;
+    std::size_t backlogCapacity;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Item> backlog;
+    std::size_t backlogSize = 0;     /**< Total size of `backlog` */
+    bool busy = false;               /**< True if the sink is being called */
+    bool stop = false;
+    std::size_t droppedBytes = 0;
+    std::exception_ptr error;
+
+    std::thread thread; // must be the last member
+  };
+
+  void publish();
+
+  /** Hand over `chunk` to `state`, or drop it; `retained` is computed lazily */
+  void handOver(SinkState& state, const Chunk& chunk, std::vector<char>& retained, bool& hasRetained);
+
+  static void sinkLoop(SinkState& state);
+
+  const std::size_t _chunkSize;
+  std::vector<char> _chunk; /**< Current chunk, not yet handed over */
+  bool _written = false;    /**< True if `write` was called */
+
+  std::vector<std::unique_ptr<SinkState>> _sinks;
+};
+
+} // namespace binlog
+
+#endif // BINLOG_FANOUT_OUTPUT_STREAM_HPP
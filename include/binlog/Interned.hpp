@@ -0,0 +1,54 @@
+#ifndef BINLOG_INTERNED_HPP
+#define BINLOG_INTERNED_HPP
+
+#include <binlog/adapt_struct.hpp>
+
+#include <mserialize/string_view.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace binlog {
+
+/**
+ * Logging a string wrapped by this type serializes
+ * the string only the first time the writer sees it,
+ * then only an 8 byte id afterwards.
+ *
+ * Useful for strings that repeat a lot (e.g: symbols, venue names):
+ * events become smaller, and the string is not copied again.
+ * SessionWriter keeps a small cache of recently seen strings.
+ * A string not found in the cache is given a new id,
+ * and written to the queue as an InternedString entry,
+ * before the event that refers to it.
+ * bread shows the string, as if it was logged as usual.
+ *
+ * The wrapped string is not copied: it must remain valid
+ * until the log call returns. Only direct log arguments are interned,
+ * interned strings in containers or structures are not resolved.
+ *
+ *    BINLOG_INFO("Order received, symbol: {}", binlog::interned(order.symbol));
+ */
+struct interned
+{
+  explicit interned(const std::string& str)
+    :value(str)
+  {}
+
+  explicit interned(const char* str)
+    :value(str != nullptr ? str : "{null}")
+  {}
+
+  interned(const char* str, std::size_t size)
+    :value(str, size)
+  {}
+
+  mserialize::string_view value; /**< The string to intern, not serialized */
+  std::uint64_t id = 0;          /**< Set by SessionWriter, refers to an InternedString entry */
+};
+
+} // namespace binlog
+
+BINLOG_ADAPT_STRUCT(binlog::interned, id)
+
+#endif // BINLOG_INTERNED_HPP
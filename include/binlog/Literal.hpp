@@ -0,0 +1,47 @@
+#ifndef BINLOG_LITERAL_HPP
+#define BINLOG_LITERAL_HPP
+
+#include <binlog/adapt_struct.hpp>
+
+#include <cstdint>
+#include <cstring> // memcpy
+
+namespace binlog {
+
+/**
+ * Logging a string of static storage duration wrapped
+ * by this type serializes only the address of the string.
+ *
+ * This is faster and takes less space than logging the
+ * string itself, as the string is not measured and copied.
+ * When the session consumes an event with a literal, whose address
+ * was not consumed before, it reads the string and writes it
+ * to the output once, as a LiteralString entry.
+ * bread shows the string, as if it was logged as usual.
+ *
+ * The pointed string must be null terminated, and must remain
+ * valid and unchanged until the program ends, e.g:
+ * a string literal, or an element of a static table.
+ * The session assumes that different strings have different addresses.
+ *
+ *    BINLOG_INFO("Order state: {}", binlog::literal("NEW"));
+ */
+struct literal
+{
+  explicit literal(const char* str)
+  {
+    memcpy(&value, &str, sizeof(str));
+  }
+
+  // Like binlog::address, store the address in a u64,
+  // to make the binary representation platform agnostic.
+  static_assert(sizeof(const char*) <= sizeof(std::uint64_t), "");
+
+  std::uint64_t value = 0;
+};
+
+} // namespace binlog
+
+BINLOG_ADAPT_STRUCT(binlog::literal, value)
+
+#endif // BINLOG_LITERAL_HPP
@@ -0,0 +1,557 @@
+#ifndef BINLOG_METRIC_AGGREGATOR_HPP
+#define BINLOG_METRIC_AGGREGATOR_HPP
+
+#include <binlog/Entries.hpp>
+#include <binlog/Range.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <mserialize/Visitor.hpp>
+#include <mserialize/deserialize.hpp>
+#include <mserialize/detail/tag_util.hpp>
+#include <mserialize/detail/varint.hpp>
+#include <mserialize/serialize.hpp>
+#include <mserialize/string_view.hpp>
+#include <mserialize/visit.hpp>
+
+#include <chrono>
+#include <cmath> // ceil
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <functional>
+#include <ios> // streamsize
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility> // move
+
+namespace binlog {
+
+/**
+ * From a stream of entries, aggregate a numeric argument
+ * of events produced by selected event sources, and write
+ * a summary event for each source and interval.
+ *
+ * Meant for metric-style logging (e.g: "latency={}"),
+ * where the distribution of the values is interesting,
+ * not each value:
+ *
+ *    binlog::MetricAggregator aggregator(
+ *      [](const binlog::EventSourceView& source) {
+ *        return (source.category == "latency") ? 0 : -1; // aggregate the first argument
+ *      },
+ *      std::chrono::seconds(1)
+ *    );
+ *
+ *    // in the write method of the OutputStream passed to Session::consume:
+ *    aggregator.write(buffer, size, out);
+ *
+ * For each selected source, a summary source is added,
+ * with the same severity, category, function, file and line,
+ * the format string of the original source with its placeholders replaced by `*`,
+ * followed by " (count: {}, min: {}, max: {}, mean: {}, p50: {}, p90: {}, p99: {})".
+ * A summary event has the clock of the start of its interval.
+ * Percentiles are approximate, their relative error is less than 4%.
+ *
+ * The interval of a source is summarized when an event of the same source
+ * is seen in a later interval, or any event is seen after the end of the interval,
+ * or by `flush`. Events seen late, after the start of a later interval
+ * of the same source, are counted in the later interval.
+ */
+class MetricAggregator
+{
+public:
+  /**
+   * Returns the zero based index of the argument to aggregate,
+   * or a negative number, if the source is not aggregated.
+   * The strings of its argument are valid only during the call.
+   */
+  using Selector = std::function<int(const EventSourceView&)>;
+
+  /**
+   * @param selectArgument selects the aggregated sources and their arguments.
+   *        Sources whose selected argument is not an arithmetic
+   *        value (e.g: a string or a structure) are not aggregated.
+   * @param interval the length of the aggregated intervals.
+   *        Converted to clock ticks using the last seen ClockSync,
+   *        clock values are taken as nanoseconds, if there is none.
+   * @param keepEvents if false, events of aggregated sources are not written.
+   */
+  MetricAggregator(Selector selectArgument, std::chrono::nanoseconds interval, bool keepEvents = false);
+
+  /**
+   * From the sequence of entries in [buffer, buffer+bufferSize),
+   * write every entry to `out`, except the events of aggregated sources,
+   * if `keepEvents` is false, and write the summaries of completed intervals.
+   *
+   * The summary events are written before WriterProp entries,
+   * preceded by an empty WriterProp, to keep every event
+   * of the input associated with its writer.
+   * EventBatches are rewritten without the events of aggregated sources,
+   * batches left without entries are not written.
+   * The batchSize of WriterProp entries is set to zero (unknown),
+   * as the events following them are changed.
+   *
+   * @requires OutputStream must model the mserialize::OutputStream concept
+   * @returns the number of bytes written to `out`
+   * @throws std::runtime_error if `buffer` contains an invalid entry
+   */
+  template <typename OutputStream>
+  std::size_t write(const char* buffer, std::size_t bufferSize, OutputStream& out);
+
+  /**
+   * Write the summaries of every interval not yet summarized to `out`,
+   * including the current, incomplete ones.
+   *
+   * Must not be called between a WriterProp and the events it describes.
+   * Call it after Session::consume, e.g: before closing the output.
+   *
+   * @returns the number of bytes written to `out`
+   */
+  template <typename OutputStream>
+  std::size_t flush(OutputStream& out);
+
+private:
+  /** Aggregated values of an interval */
+  struct Interval
+  {
+    std::uint64_t index = 0;  /**< Start of the interval, in units of interval length */
+    std::uint64_t count = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    std::map<std::uint16_t, std::uint64_t> buckets; /**< Number of values, by bucket, see bucketOf */
+  };
+
+  struct Metric
+  {
+    std::uint64_t summarySourceId = 0;
+    std::size_t argumentIndex = 0;
+    std::string argumentTags;
+    Interval interval;
+  };
+
+  // Visit the selected argument, read its value as double
+  struct ValueVisitor
+  {
+    double value = std::numeric_limits<double>::quiet_NaN();
+
+    template <typename T>
+    std::enable_if_t<std::is_arithmetic<T>::value> visit(T v) { value = double(v); }
+
+    template <typename T>
+    std::enable_if_t<! std::is_arithmetic<T>::value> visit(T) {}
+
+    template <typename T>
+    bool visit(T, Range&) { return false; }
+  };
+
+  // Visit the arguments before the selected one, without looking at them
+  struct SkipVisitor
+  {
+    template <typename T>
+    void visit(T) {}
+
+    template <typename T>
+    bool visit(T, Range&) { return false; }
+  };
+
+  void addEventSource(Range payload);
+
+  /** Aggregate the event in `payload` (after the clock). @returns true if aggregated */
+  bool addEvent(std::uint64_t sourceId, std::uint64_t clock, Range payload);
+
+  /** Write the summary of `metric` to `_summaries`, if it has values */
+  void summarize(Metric& metric);
+
+  /** Summarize every interval that ended before `_maxClock` */
+  void summarizeCompleted();
+
+  /**
+   * Write the EventBatch in `payload` to `_batchBuffer`,
+   * keeping only special entries and not aggregated events.
+   *
+   * @returns true if at least one entry was kept
+   */
+  bool aggregateEventBatch(Range payload);
+
+  /** Write the pending summaries, preceded by an empty WriterProp, to `out` */
+  template <typename OutputStream>
+  std::size_t writeSummaries(OutputStream& out);
+
+  std::uint64_t intervalTicks() const;
+
+  /** @returns a 16 bit key, monotonic in `value`: sign, exponent and the top 4 bits of mantissa */
+  static std::uint16_t bucketOf(double value);
+
+  /** @returns the value in the middle of `bucket` */
+  static double bucketValue(std::uint16_t bucket);
+
+  static double percentile(const Interval& interval, double p);
+
+  static bool isAggregatable(mserialize::string_view tag);
+
+  Selector _selectArgument;
+  std::chrono::nanoseconds _interval;
+  bool _keepEvents;
+
+  ClockSync _clockSync;
+  std::uint64_t _maxClock = 0;
+  std::uint64_t _nextSummarySourceId = std::uint64_t(1) << 62; /**< Not used by Session */
+  std::map<std::uint64_t, Metric> _metrics; /**< By the id of the aggregated source */
+
+  detail::VectorOutputStream _sources;   /**< Summary sources to be written */
+  detail::VectorOutputStream _summaries; /**< Summary events to be written */
+  detail::VectorOutputStream _batchBuffer;
+};
+
+inline MetricAggregator::MetricAggregator(Selector selectArgument, std::chrono::nanoseconds interval, bool keepEvents)
+  :_selectArgument(std::move(selectArgument)),
+   _interval(interval),
+   _keepEvents(keepEvents)
+{}
+
+template <typename OutputStream>
+std::size_t MetricAggregator::write(const char* buffer, std::size_t bufferSize, OutputStream& out)
+{
+  std::size_t totalWriteSize = 0;
+
+  Range entries(buffer, bufferSize);
+
+  while (! entries.empty())
+  {
+    Range entry = entries;
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range payload(entries.view(size), size);
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+    const std::size_t sizePrefixedSize = size + sizeof(size);
+
+    if (special)
+    {
+      if (tag == EventBatch::Tag)
+      {
+        if (aggregateEventBatch(payload))
+        {
+          out.write(_batchBuffer.data(), _batchBuffer.ssize());
+          totalWriteSize += _batchBuffer.vector.size();
+        }
+        continue;
+      }
+
+      if (tag == WriterProp::Tag)
+      {
+        summarizeCompleted();
+        totalWriteSize += writeSummaries(out);
+
+        WriterProp writerProp;
+        mserialize::deserialize(writerProp, payload);
+        writerProp.batchSize = 0; // events are dropped
+        _batchBuffer.clear();
+        totalWriteSize += serializeSizePrefixedTagged(writerProp, _batchBuffer);
+        out.write(_batchBuffer.data(), _batchBuffer.ssize());
+        continue;
+      }
+
+      if (tag == ClockSync::Tag)
+      {
+        mserialize::deserialize(_clockSync, payload);
+      }
+
+      out.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+      totalWriteSize += sizePrefixedSize;
+
+      // summary sources follow the sources they summarize
+      if (tag == EventSource::Tag)
+      {
+        addEventSource(payload);
+        out.write(_sources.data(), _sources.ssize());
+        totalWriteSize += _sources.vector.size();
+        _sources.clear();
+      }
+    }
+    else
+    {
+      const std::uint64_t clock = payload.read<std::uint64_t>();
+      if (! addEvent(tag, clock, payload) || _keepEvents)
+      {
+        out.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+        totalWriteSize += sizePrefixedSize;
+      }
+    }
+  }
+
+  return totalWriteSize;
+}
+
+template <typename OutputStream>
+std::size_t MetricAggregator::flush(OutputStream& out)
+{
+  for (auto& idAndMetric : _metrics)
+  {
+    summarize(idAndMetric.second);
+  }
+
+  return writeSummaries(out);
+}
+
+inline void MetricAggregator::addEventSource(Range payload)
+{
+  const EventSourceView source = deserializeEventSourceView(payload);
+  const int argumentIndex = _selectArgument(source);
+  if (argumentIndex < 0)
+  {
+    _metrics.erase(source.id); // a source of a different session might reuse the id
+    return;
+  }
+
+  // find the tag of the selected argument
+  mserialize::string_view tags = source.argumentTags;
+  mserialize::string_view tag = mserialize::detail::tag_pop(tags);
+  for (int i = 0; i < argumentIndex && ! tag.empty(); ++i)
+  {
+    tag = mserialize::detail::tag_pop(tags);
+  }
+  if (! isAggregatable(tag))
+  {
+    _metrics.erase(source.id);
+    return;
+  }
+
+  // if the source is seen again (e.g: metadata is reconsumed after log rotation),
+  // its summary source is written again, but its interval is kept.
+  Metric& metric = _metrics[source.id];
+  if (metric.summarySourceId == 0)
+  {
+    metric.summarySourceId = _nextSummarySourceId++;
+  }
+  metric.argumentIndex = std::size_t(argumentIndex);
+  metric.argumentTags.assign(source.argumentTags.data(), source.argumentTags.size());
+
+  std::string format;
+  format.reserve(source.formatString.size() + 80);
+  for (std::size_t i = 0; i < source.formatString.size(); ++i)
+  {
+    if (source.formatString[i] == '{' && i + 1 < source.formatString.size() && source.formatString[i+1] == '}')
+    {
+      format += '*';
+      ++i; // skip }
+    }
+    else
+    {
+      format += source.formatString[i];
+    }
+  }
+  format += " (count: {}, min: {}, max: {}, mean: {}, p50: {}, p90: {}, p99: {})";
+
+  const EventSource summarySource{
+    metric.summarySourceId, source.severity,
+    source.category.to_string(), source.function.to_string(), source.file.to_string(), source.line,
+    std::move(format), "Ldddddd"
+  };
+  serializeSizePrefixedTagged(summarySource, _sources);
+}
+
+inline bool MetricAggregator::addEvent(std::uint64_t sourceId, std::uint64_t clock, Range payload)
+{
+  if (clock > _maxClock) { _maxClock = clock; }
+
+  const auto it = _metrics.find(sourceId);
+  if (it == _metrics.end()) { return false; }
+
+  Metric& metric = it->second;
+
+  mserialize::string_view tags = metric.argumentTags;
+  SkipVisitor skip;
+  for (std::size_t i = 0; i < metric.argumentIndex; ++i)
+  {
+    mserialize::visit(mserialize::detail::tag_pop(tags), skip, payload);
+  }
+  ValueVisitor visitor;
+  mserialize::visit(mserialize::detail::tag_pop(tags), visitor, payload);
+
+  const double value = visitor.value;
+  if (std::isnan(value)) { return true; }
+
+  const std::uint64_t index = clock / intervalTicks();
+  Interval& interval = metric.interval;
+  if (index > interval.index && interval.count != 0)
+  {
+    summarize(metric);
+  }
+  if (interval.count == 0)
+  {
+    interval.index = index;
+    interval.min = interval.max = value;
+  }
+
+  ++interval.count;
+  if (value < interval.min) { interval.min = value; }
+  if (value > interval.max) { interval.max = value; }
+  interval.sum += value;
+  ++interval.buckets[bucketOf(value)];
+
+  return true;
+}
+
+inline void MetricAggregator::summarize(Metric& metric)
+{
+  Interval& interval = metric.interval;
+  if (interval.count == 0) { return; }
+
+  // u32 size | u64 source id | u64 clock | L count | d min | d max | d mean | d p50 | d p90 | d p99
+  const std::uint32_t size = sizeof(std::uint64_t) * 3 + sizeof(double) * 6;
+  const std::uint64_t clock = interval.index * intervalTicks();
+  const double mean = interval.sum / double(interval.count);
+
+  mserialize::serialize(size, _summaries);
+  mserialize::serialize(metric.summarySourceId, _summaries);
+  mserialize::serialize(clock, _summaries);
+  mserialize::serialize(interval.count, _summaries);
+  mserialize::serialize(interval.min, _summaries);
+  mserialize::serialize(interval.max, _summaries);
+  mserialize::serialize(mean, _summaries);
+  mserialize::serialize(percentile(interval, 0.50), _summaries);
+  mserialize::serialize(percentile(interval, 0.90), _summaries);
+  mserialize::serialize(percentile(interval, 0.99), _summaries);
+
+  interval = Interval{};
+}
+
+inline void MetricAggregator::summarizeCompleted()
+{
+  const std::uint64_t index = _maxClock / intervalTicks();
+  for (auto& idAndMetric : _metrics)
+  {
+    Metric& metric = idAndMetric.second;
+    if (metric.interval.count != 0 && metric.interval.index < index)
+    {
+      summarize(metric);
+    }
+  }
+}
+
+inline bool MetricAggregator::aggregateEventBatch(Range payload)
+{
+  EventBatch batch;
+  mserialize::deserialize(batch, payload);
+
+  // size is not known yet, written below
+  const std::uint32_t placeholderSize = 0;
+  const std::uint64_t batchTag = EventBatch::Tag;
+  _batchBuffer.clear();
+  mserialize::serialize(placeholderSize, _batchBuffer);
+  mserialize::serialize(batchTag, _batchBuffer);
+  mserialize::serialize(batch, _batchBuffer);
+
+  bool hasEntries = false;
+  while (! payload.empty())
+  {
+    Range entry = payload;
+    const std::uint32_t size = payload.read<std::uint32_t>();
+    Range entryPayload(payload.view(size), size);
+    const std::uint64_t tag = entryPayload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+
+    bool keep = true;
+    if (! special)
+    {
+      const std::int64_t delta = mserialize::detail::zigzag_decode(mserialize::detail::read_varint(entryPayload));
+      keep = ! addEvent(tag, batch.clockBase + std::uint64_t(delta), entryPayload) || _keepEvents;
+    }
+
+    if (keep)
+    {
+      const std::size_t sizePrefixedSize = size + sizeof(size);
+      _batchBuffer.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+      hasEntries = true;
+    }
+  }
+
+  const std::uint32_t batchSize = std::uint32_t(_batchBuffer.vector.size() - sizeof(batchSize));
+  memcpy(_batchBuffer.vector.data(), &batchSize, sizeof(batchSize));
+
+  return hasEntries;
+}
+
+template <typename OutputStream>
+std::size_t MetricAggregator::writeSummaries(OutputStream& out)
+{
+  if (_summaries.vector.empty()) { return 0; }
+
+  detail::VectorOutputStream writerProp;
+  serializeSizePrefixedTagged(WriterProp{}, writerProp);
+  out.write(writerProp.data(), writerProp.ssize());
+  out.write(_summaries.data(), _summaries.ssize());
+
+  const std::size_t result = writerProp.vector.size() + _summaries.vector.size();
+  _summaries.clear();
+  return result;
+}
+
+inline std::uint64_t MetricAggregator::intervalTicks() const
+{
+  const std::uint64_t ns = std::uint64_t(_interval.count());
+  const std::uint64_t ticks = (_clockSync.clockFrequency == 0)
+    ? ns
+    : std::uint64_t(double(ns) * double(_clockSync.clockFrequency) / 1e9);
+  return (ticks != 0) ? ticks : 1;
+}
+
+inline std::uint16_t MetricAggregator::bucketOf(double value)
+{
+  std::uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  // make the bits of negative values increase with the value
+  const std::uint64_t sign = std::uint64_t(1) << 63;
+  bits = (bits & sign) ? ~bits : (bits | sign);
+  return std::uint16_t(bits >> 48);
+}
+
+inline double MetricAggregator::bucketValue(std::uint16_t bucket)
+{
+  const std::uint64_t sign = std::uint64_t(1) << 63;
+  std::uint64_t bits = (std::uint64_t(bucket) << 48) | (std::uint64_t(1) << 47);
+  bits = (bits & sign) ? (bits & ~sign) : ~bits;
+
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline double MetricAggregator::percentile(const Interval& interval, double p)
+{
+  const std::uint64_t rank = std::uint64_t(std::ceil(p * double(interval.count)));
+  std::uint64_t seen = 0;
+  for (const auto& bucketAndCount : interval.buckets)
+  {
+    seen += bucketAndCount.second;
+    if (seen >= rank)
+    {
+      const double value = bucketValue(bucketAndCount.first);
+      return (value < interval.min) ? interval.min : (value > interval.max) ? interval.max : value;
+    }
+  }
+  return interval.max;
+}
+
+inline bool MetricAggregator::isAggregatable(mserialize::string_view tag)
+{
+  if (tag.size() != 1) { return false; }
+  switch (tag[0])
+  {
+    case 'b': case 's': case 'i': case 'l':
+    case 'B': case 'S': case 'I': case 'L':
+    case 'f': case 'd': case 'D':
+    case 'v': case 'z':
+      return true;
+    default:
+      return false;
+  }
+}
+
+} // namespace binlog
+
+#endif // BINLOG_METRIC_AGGREGATOR_HPP
@@ -0,0 +1,68 @@
+#ifndef BINLOG_NUMA_NODE_HPP
+#define BINLOG_NUMA_NODE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+  #include <sys/syscall.h> // NOLINT SYS_getcpu
+  #include <unistd.h> // NOLINT syscall
+#endif
+
+namespace binlog {
+
+/**
+ * @returns the NUMA node of the CPU the calling thread runs on,
+ *          or zero, if it cannot be determined (e.g: not on Linux).
+ *
+ * The thread might be moved to a different CPU right after the call.
+ * Can be used to select the shard of new channels,
+ * see Session::setChannelShardSelector.
+ */
+inline std::size_t currentNumaNode()
+{
+  #ifdef __linux__
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+      return node;
+    }
+  #endif
+
+  return 0;
+}
+
+/**
+ * @returns the number of NUMA nodes of the system (the highest possible node + 1),
+ *          or one, if it cannot be determined (e.g: not on Linux).
+ */
+inline std::size_t numaNodeCount()
+{
+  #ifdef __linux__
+    // list of node ranges, e.g: "0-3" or "0,2-3"
+    std::ifstream possible("/sys/devices/system/node/possible");
+    std::string nodes;
+    if (std::getline(possible, nodes) && ! nodes.empty())
+    {
+      const std::size_t lastBegin = nodes.find_last_of(",-");
+      const std::string last = nodes.substr(lastBegin == std::string::npos ? 0 : lastBegin + 1);
+      try
+      {
+        return std::stoul(last) + 1;
+      }
+      catch (const std::logic_error&)
+      {
+        // unexpected format
+      }
+    }
+  #endif
+
+  return 1;
+}
+
+} // namespace binlog
+
+#endif // BINLOG_NUMA_NODE_HPP
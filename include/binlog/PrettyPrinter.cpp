@@ -1,5 +1,6 @@
 #include <binlog/PrettyPrinter.hpp>
 
+#include <binlog/EventStream.hpp>
 #include <binlog/ToStringVisitor.hpp>
 
 #include <mserialize/detail/Visit.hpp> // IntegerToHex
@@ -13,6 +14,7 @@
 #include <cstdlib> // abs
 #include <iomanip> // setw
 #include <ostream>
+#include <utility> // make_pair
 
 namespace {
 
@@ -86,7 +88,10 @@ PrettyPrinter::PrettyPrinter(std::string eventFormat, std::string timeFormat)
   :_eventFormat(std::move(eventFormat)),
    _timeFormat(std::move(timeFormat)),
    _useLocaltime(useLocaltime(_eventFormat)),
-   _clockSync(nullptr)
+   _clockSync(nullptr),
+   _literals(nullptr),
+   _interned(nullptr),
+   _errorCodeMessages(nullptr)
 {}
 
 void PrettyPrinter::printEvent(
@@ -96,8 +101,25 @@ void PrettyPrinter::printEvent(
   const ClockSync& clockSync
 )
 {
-  detail::OstreamBuffer out(ostr);
   _clockSync = &clockSync;
+  _literals = nullptr;
+  _interned = nullptr;
+  _errorCodeMessages = nullptr;
+  printEventFields(ostr, event, writerProp);
+}
+
+void PrettyPrinter::printEvent(std::ostream& ostr, const Event& event, const EventStream& eventStream)
+{
+  _clockSync = &eventStream.clockSync();
+  _literals = &eventStream.literals();
+  _interned = &eventStream.interned();
+  _errorCodeMessages = &eventStream.errorCodeMessages();
+  printEventFields(ostr, event, eventStream.writerProp());
+}
+
+void PrettyPrinter::printEventFields(std::ostream& ostr, const Event& event, const WriterProp& writerProp)
+{
+  detail::OstreamBuffer out(ostr);
 
   for (std::size_t i = 0; i < _eventFormat.size(); ++i)
   {
@@ -125,6 +147,63 @@ bool PrettyPrinter::printStruct(detail::OstreamBuffer& out, mserialize::Visitor:
     return true;
   }
 
+  if (sb.name == "binlog::literal" && sb.tag == "`value'L")
+  {
+    const std::uint64_t value = input.read<std::uint64_t>();
+    if (_literals != nullptr)
+    {
+      const auto it = _literals->find(value);
+      if (it != _literals->end())
+      {
+        out << it->second;
+        return true;
+      }
+    }
+
+    // string not found, show the address
+    mserialize::detail::IntegerToHex tohex;
+    tohex.visit(value);
+    out << "0x" << tohex.value();
+    return true;
+  }
+
+  if (sb.name == "binlog::interned" && sb.tag == "`id'L")
+  {
+    const std::uint64_t id = input.read<std::uint64_t>();
+    if (_interned != nullptr)
+    {
+      const auto it = _interned->find(id);
+      if (it != _interned->end())
+      {
+        out << it->second;
+        return true;
+      }
+    }
+
+    // string not found, show the id
+    out << "{interned:" << id << "}";
+    return true;
+  }
+
+  if (sb.name == "std::error_code" && sb.tag == "`category'L`value'i")
+  {
+    const std::uint64_t category = input.read<std::uint64_t>();
+    const std::int32_t value = input.read<std::int32_t>();
+    if (_errorCodeMessages != nullptr)
+    {
+      const auto it = _errorCodeMessages->find(std::make_pair(category, value));
+      if (it != _errorCodeMessages->end())
+      {
+        out << it->second;
+        return true;
+      }
+    }
+
+    // message not found, show the value
+    out << "{error_code:" << value << "}";
+    return true;
+  }
+
   if (sb.name == "std::chrono::system_clock::time_point" && sb.tag == "`ns'l")
   {
     if (_clockSync == nullptr) { return false; }
@@ -14,6 +14,8 @@
 
 namespace binlog {
 
+class EventStream;
+
 /**
  * Convert Events to string, according to the specified format.
  *
@@ -55,6 +57,9 @@ public:
    * as: "no_clock_sync?", as there's not enough context to
    * render them. The raw clock value remains accessible via %r.
    *
+   * binlog::literal, binlog::interned and std::error_code arguments
+   * are shown as addresses, ids and values, respectively.
+   *
    * @pre event.source must be valid
    */
   void printEvent(
@@ -64,6 +69,21 @@ public:
     const ClockSync& clockSync = {}
   );
 
+  /**
+   * Same as above, using the writerProp and clockSync of `eventStream`,
+   * and the strings it read:
+   *
+   * binlog::literal arguments are shown as the matching
+   * string of eventStream.literals(), or as an address, if not found.
+   * binlog::interned arguments are shown as the matching
+   * string of eventStream.interned(), or as their id, if not found.
+   * std::error_code arguments are shown as the matching
+   * message of eventStream.errorCodeMessages(), or as their value, if not found.
+   *
+   * @pre event.source must be valid
+   */
+  void printEvent(std::ostream& ostr, const Event& event, const EventStream& eventStream);
+
   /**
    * If the type indicated by `sb` is known, deserialize it from `input`,
    * and print it to `out`, then return true.
@@ -75,6 +95,8 @@ public:
   bool printStruct(detail::OstreamBuffer& out, mserialize::Visitor::StructBegin sb, Range& input) const;
 
 private:
+  void printEventFields(std::ostream& ostr, const Event& event, const WriterProp& writerProp);
+
   void printEventField(
     detail::OstreamBuffer& out,
     char spec,
@@ -94,6 +116,9 @@ private:
   std::string _timeFormat;
   bool _useLocaltime; // true if timestamps in messages should be rendered in producer-localtime
   const ClockSync* _clockSync;
+  const LiteralTable* _literals;
+  const InternedTable* _interned;
+  const ErrorCodeMessageTable* _errorCodeMessages;
 };
 
 } // namespace binlog
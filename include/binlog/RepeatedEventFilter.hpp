@@ -0,0 +1,430 @@
+#ifndef BINLOG_REPEATED_EVENT_FILTER_HPP
+#define BINLOG_REPEATED_EVENT_FILTER_HPP
+
+#include <binlog/Entries.hpp>
+#include <binlog/Range.hpp>
+#include <binlog/Time.hpp> // requires binlog library to be linked
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <mserialize/deserialize.hpp>
+#include <mserialize/detail/varint.hpp>
+#include <mserialize/serialize.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcmp, memcpy
+#include <ios> // streamsize
+#include <map>
+#include <string>
+#include <utility> // move, pair
+
+namespace binlog {
+
+/**
+ * From a stream of entries, drop the events that repeat
+ * the previous event of the same writer, and add a note
+ * of the dropped events instead.
+ *
+ * An event repeats the previous event of its writer, if it has
+ * the same source and the same argument bytes, and its clock
+ * is in the window started by the first event of the run.
+ * Arguments are compared by a hash and their bytes,
+ * nothing is deserialized.
+ *
+ * When a run of repeated events ends, an event is added,
+ * with the clock of the last dropped event, and the message:
+ * "Previous event repeated {} times, last at {}".
+ * The note has the severity, category, function, file and line
+ * of the repeated event, its source is added to the stream before the note.
+ *
+ * Writers are identified by the id and name of WriterProp entries.
+ */
+class RepeatedEventFilter
+{
+public:
+  /**
+   * @param window the maximum time between the first and the last event of a run.
+   *        Converted to clock ticks using the last seen ClockSync,
+   *        clock values are taken as nanoseconds, if there is none.
+   */
+  explicit RepeatedEventFilter(std::chrono::nanoseconds window);
+
+  RepeatedEventFilter(const RepeatedEventFilter&) = delete;
+  void operator=(const RepeatedEventFilter&) = delete;
+
+  /**
+   * From the sequence of entries in [buffer, buffer+bufferSize),
+   * write every entry to `out`, except the repeated events,
+   * and write notes of the runs ended by a different event of the same writer,
+   * or by an event of any writer after the window of the run.
+   *
+   * Notes of runs of other writers are written before WriterProp entries,
+   * preceded by the WriterProp of their writer.
+   * EventBatches are rewritten without the repeated events,
+   * batches left without entries are not written.
+   * The batchSize of WriterProp entries is set to zero (unknown),
+   * as the events following them are changed.
+   *
+   * @requires OutputStream must model the mserialize::OutputStream concept
+   * @returns the number of bytes written to `out`
+   * @throws std::runtime_error if `buffer` contains an invalid entry
+   */
+  template <typename OutputStream>
+  std::size_t write(const char* buffer, std::size_t bufferSize, OutputStream& out);
+
+  /**
+   * Write the notes of every run with dropped events to `out`,
+   * each preceded by the WriterProp of its writer.
+   *
+   * Must not be called between a WriterProp and the events it describes.
+   * Call it after Session::consume, e.g: before closing the output.
+   *
+   * @returns the number of bytes written to `out`
+   */
+  template <typename OutputStream>
+  std::size_t flush(OutputStream& out);
+
+private:
+  /** The last event of a writer written to the output, and its dropped repetitions */
+  struct Run
+  {
+    bool active = false;
+    std::uint64_t sourceId = 0;
+    std::uint64_t hash = 0;
+    std::string arguments;
+    std::uint64_t firstClock = 0;
+    std::uint64_t lastClock = 0;
+    std::uint64_t count = 0; /**< Number of dropped events */
+  };
+
+  struct Writer
+  {
+    WriterProp writerProp;
+    Run run;
+  };
+
+  /**
+   * If the event repeats the previous one of the current writer, count it.
+   * Otherwise, write the note of the previous run to `_notes`,
+   * encoded relative to `clockBase`, if `batched`, and start a new run.
+   *
+   * @returns true if the event is repeated, and must be dropped
+   */
+  bool addEvent(std::uint64_t sourceId, std::uint64_t clock, Range arguments, bool batched, std::uint64_t clockBase);
+
+  /** Write the note of `run` to `_notes`, and end it. Write the source of the note to `_sources` if needed. */
+  void endRun(Run& run, bool batched, std::uint64_t clockBase);
+
+  /**
+   * Write the EventBatch in `payload` to `_batchBuffer`,
+   * keeping only special entries, not repeated events and notes.
+   *
+   * @returns true if at least one entry was kept
+   */
+  bool filterEventBatch(Range payload);
+
+  /** End every run with dropped events, if `all` or if their window is over */
+  template <typename OutputStream>
+  std::size_t endRuns(bool all, OutputStream& out);
+
+  /** Write the pending sources, then the pending notes to `out` */
+  template <typename OutputStream>
+  std::size_t writeNotes(OutputStream& out);
+
+  std::uint64_t windowTicks() const;
+
+  static std::uint64_t hashOf(Range arguments);
+
+  std::chrono::nanoseconds _window;
+
+  ClockSync _clockSync;
+  std::uint64_t _maxClock = 0;
+  std::map<std::pair<std::uint64_t, std::string>, Writer> _writers; /**< By writer id and name */
+  Writer* _writer; /**< Writer of the current events */
+
+  std::map<std::uint64_t, EventSource> _eventSources; /**< Sources of the input, by id */
+  std::map<std::uint64_t, std::uint64_t> _noteSourceIds; /**< Id of note source, by id of the repeated source */
+  std::uint64_t _nextNoteSourceId = std::uint64_t(3) << 61; /**< Not used by Session or MetricAggregator */
+
+  detail::VectorOutputStream _sources; /**< Note sources to be written */
+  detail::VectorOutputStream _notes;   /**< Notes to be written */
+  detail::VectorOutputStream _batchBuffer;
+};
+
+inline RepeatedEventFilter::RepeatedEventFilter(std::chrono::nanoseconds window)
+  :_window(window),
+   _writer(&_writers[{0, std::string{}}])
+{}
+
+template <typename OutputStream>
+std::size_t RepeatedEventFilter::write(const char* buffer, std::size_t bufferSize, OutputStream& out)
+{
+  std::size_t totalWriteSize = 0;
+
+  Range entries(buffer, bufferSize);
+
+  while (! entries.empty())
+  {
+    Range entry = entries;
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range payload(entries.view(size), size);
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+    const std::size_t sizePrefixedSize = size + sizeof(size);
+
+    if (special)
+    {
+      if (tag == EventBatch::Tag)
+      {
+        if (filterEventBatch(payload))
+        {
+          totalWriteSize += writeNotes(out); // sources of the notes in the batch
+          out.write(_batchBuffer.data(), _batchBuffer.ssize());
+          totalWriteSize += _batchBuffer.vector.size();
+        }
+        continue;
+      }
+
+      if (tag == WriterProp::Tag)
+      {
+        totalWriteSize += endRuns(false, out);
+
+        WriterProp writerProp;
+        mserialize::deserialize(writerProp, payload);
+        writerProp.batchSize = 0; // events are dropped, notes are added
+        Writer& writer = _writers[{writerProp.id, writerProp.name}];
+        writer.writerProp = std::move(writerProp);
+        _writer = &writer;
+
+        _batchBuffer.clear();
+        totalWriteSize += serializeSizePrefixedTagged(writer.writerProp, _batchBuffer);
+        out.write(_batchBuffer.data(), _batchBuffer.ssize());
+        continue;
+      }
+      else if (tag == EventSource::Tag)
+      {
+        EventSource eventSource;
+        mserialize::deserialize(eventSource, payload);
+        _noteSourceIds.erase(eventSource.id); // metadata is reconsumed, e.g: after log rotation
+        _eventSources[eventSource.id] = std::move(eventSource);
+      }
+      else if (tag == ClockSync::Tag)
+      {
+        mserialize::deserialize(_clockSync, payload);
+      }
+    }
+    else
+    {
+      const std::uint64_t clock = payload.read<std::uint64_t>();
+      if (addEvent(tag, clock, payload, false, 0)) { continue; }
+      totalWriteSize += writeNotes(out);
+    }
+
+    out.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+    totalWriteSize += sizePrefixedSize;
+  }
+
+  return totalWriteSize;
+}
+
+template <typename OutputStream>
+std::size_t RepeatedEventFilter::flush(OutputStream& out)
+{
+  return endRuns(true, out);
+}
+
+inline bool RepeatedEventFilter::addEvent(std::uint64_t sourceId, std::uint64_t clock, Range arguments, bool batched, std::uint64_t clockBase)
+{
+  if (clock > _maxClock) { _maxClock = clock; }
+
+  Run& run = _writer->run;
+  const std::uint64_t hash = hashOf(arguments);
+
+  if (run.active && run.sourceId == sourceId && run.hash == hash
+   && clock >= run.firstClock && clock - run.firstClock <= windowTicks()
+   && run.arguments.size() == arguments.size()
+   && memcmp(run.arguments.data(), arguments.view(arguments.size()), run.arguments.size()) == 0)
+  {
+    ++run.count;
+    if (clock > run.lastClock) { run.lastClock = clock; }
+    return true;
+  }
+
+  endRun(run, batched, clockBase);
+
+  run.active = true;
+  run.sourceId = sourceId;
+  run.hash = hash;
+  run.arguments.assign(arguments.view(arguments.size()), arguments.size());
+  run.firstClock = run.lastClock = clock;
+  run.count = 0;
+  return false;
+}
+
+inline void RepeatedEventFilter::endRun(Run& run, bool batched, std::uint64_t clockBase)
+{
+  const bool hasNote = run.active && run.count != 0;
+  run.active = false;
+  if (! hasNote) { return; }
+
+  const auto source = _eventSources.find(run.sourceId);
+  if (source == _eventSources.end()) { return; } // source is not known, the note could not be read
+
+  auto noteSourceId = _noteSourceIds.find(run.sourceId);
+  if (noteSourceId == _noteSourceIds.end())
+  {
+    noteSourceId = _noteSourceIds.emplace(run.sourceId, _nextNoteSourceId++).first;
+
+    const EventSource& s = source->second;
+    const EventSource noteSource{
+      noteSourceId->second, s.severity, s.category, s.function, s.file, s.line,
+      "Previous event repeated {} times, last at {}", "L{std::chrono::system_clock::time_point`ns'l}"
+    };
+    serializeSizePrefixedTagged(noteSource, _sources);
+  }
+
+  const std::int64_t lastTime = (_clockSync.clockFrequency != 0)
+    ? clockToNsSinceEpoch(_clockSync, run.lastClock).count()
+    : std::int64_t(run.lastClock);
+
+  // u32 size | u64 source id | u64 clock, or varint clock delta, if batched | L count | l time
+  char clock[mserialize::detail::max_varint_size];
+  std::size_t clockSize = sizeof(run.lastClock);
+  if (batched)
+  {
+    const std::uint64_t delta = mserialize::detail::zigzag_encode(std::int64_t(run.lastClock - clockBase));
+    clockSize = std::size_t(mserialize::detail::write_varint(delta, clock) - clock);
+  }
+  else
+  {
+    memcpy(clock, &run.lastClock, sizeof(run.lastClock));
+  }
+
+  const std::uint32_t size = std::uint32_t(sizeof(std::uint64_t) + clockSize + sizeof(run.count) + sizeof(lastTime));
+  mserialize::serialize(size, _notes);
+  mserialize::serialize(noteSourceId->second, _notes);
+  _notes.write(clock, std::streamsize(clockSize));
+  mserialize::serialize(run.count, _notes);
+  mserialize::serialize(lastTime, _notes);
+}
+
+inline bool RepeatedEventFilter::filterEventBatch(Range payload)
+{
+  EventBatch batch;
+  mserialize::deserialize(batch, payload);
+
+  // size is not known yet, written below
+  const std::uint32_t placeholderSize = 0;
+  const std::uint64_t batchTag = EventBatch::Tag;
+  _batchBuffer.clear();
+  mserialize::serialize(placeholderSize, _batchBuffer);
+  mserialize::serialize(batchTag, _batchBuffer);
+  mserialize::serialize(batch, _batchBuffer);
+
+  bool hasEntries = false;
+  while (! payload.empty())
+  {
+    Range entry = payload;
+    const std::uint32_t size = payload.read<std::uint32_t>();
+    Range entryPayload(payload.view(size), size);
+    const std::uint64_t tag = entryPayload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+
+    if (! special)
+    {
+      const std::int64_t delta = mserialize::detail::zigzag_decode(mserialize::detail::read_varint(entryPayload));
+      if (addEvent(tag, batch.clockBase + std::uint64_t(delta), entryPayload, true, batch.clockBase)) { continue; }
+
+      // the note of the previous run precedes the event that ended it
+      _batchBuffer.write(_notes.data(), _notes.ssize());
+      _notes.clear();
+    }
+
+    const std::size_t sizePrefixedSize = size + sizeof(size);
+    _batchBuffer.write(entry.view(sizePrefixedSize), std::streamsize(sizePrefixedSize));
+    hasEntries = true;
+  }
+
+  const std::uint32_t batchSize = std::uint32_t(_batchBuffer.vector.size() - sizeof(batchSize));
+  memcpy(_batchBuffer.vector.data(), &batchSize, sizeof(batchSize));
+
+  return hasEntries;
+}
+
+template <typename OutputStream>
+std::size_t RepeatedEventFilter::endRuns(bool all, OutputStream& out)
+{
+  std::size_t totalWriteSize = 0;
+
+  for (auto& idAndWriter : _writers)
+  {
+    Writer& writer = idAndWriter.second;
+    Run& run = writer.run;
+    if (! run.active || run.count == 0) { continue; }
+    if (! all && _maxClock - run.firstClock <= windowTicks()) { continue; }
+
+    endRun(run, false, 0);
+    if (_notes.vector.empty()) { continue; } // source of the note is not known
+
+    // the source of the note, the WriterProp of its writer, then the note
+    out.write(_sources.data(), _sources.ssize());
+    totalWriteSize += _sources.vector.size();
+    _sources.clear();
+
+    detail::VectorOutputStream writerProp;
+    serializeSizePrefixedTagged(writer.writerProp, writerProp);
+    out.write(writerProp.data(), writerProp.ssize());
+    totalWriteSize += writerProp.vector.size();
+
+    totalWriteSize += writeNotes(out);
+  }
+
+  return totalWriteSize;
+}
+
+template <typename OutputStream>
+std::size_t RepeatedEventFilter::writeNotes(OutputStream& out)
+{
+  const std::size_t result = _sources.vector.size() + _notes.vector.size();
+
+  if (! _sources.vector.empty())
+  {
+    out.write(_sources.data(), _sources.ssize());
+    _sources.clear();
+  }
+
+  if (! _notes.vector.empty())
+  {
+    out.write(_notes.data(), _notes.ssize());
+    _notes.clear();
+  }
+
+  return result;
+}
+
+inline std::uint64_t RepeatedEventFilter::windowTicks() const
+{
+  const std::uint64_t ns = std::uint64_t(_window.count());
+  return (_clockSync.clockFrequency == 0)
+    ? ns
+    : std::uint64_t(double(ns) * double(_clockSync.clockFrequency) / 1e9);
+}
+
+inline std::uint64_t RepeatedEventFilter::hashOf(Range arguments)
+{
+  // FNV-1a
+  std::uint64_t hash = 0xcbf29ce484222325;
+  const std::size_t size = arguments.size();
+  const char* data = arguments.view(size);
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace binlog
+
+#endif // BINLOG_REPEATED_EVENT_FILTER_HPP
@@ -4,17 +4,27 @@
 #include <binlog/Entries.hpp>
 #include <binlog/Severity.hpp>
 #include <binlog/Time.hpp>
+#include <binlog/detail/LiteralCollector.hpp>
 #include <binlog/detail/Queue.hpp>
 #include <binlog/detail/QueueReader.hpp>
+#include <binlog/detail/SharedQueue.hpp>
 #include <binlog/detail/VectorOutputStream.hpp>
 
-#include <algorithm> // remove_if
+#include <mserialize/detail/varint.hpp>
+#include <mserialize/serialize.hpp>
+
+#include <algorithm> // count_if, find, find_if, max, min, remove_if
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstring> // memcpy
 #include <deque>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
-#include <utility> // move
+#include <new> // bad_alloc
+#include <utility> // move, pair
 #include <vector>
 
 namespace binlog {
@@ -31,11 +41,15 @@ namespace binlog {
  * access is ensured by a mutex.
  * Events can be added parallel, via Channels.
  * Channels wrap a single producer, lockfree queue.
+ * Writers that rarely add events can share a
+ * multi producer queue instead, see `sharedQueue`.
  * The channel interface is raw, log events should be
  * added using SessionWriter.
  *
  * Readers can read metadata and data, via consume.
  * Concurrent reads are serialized by a mutex.
+ * Alternatively, channels can be partitioned among
+ * several readers, see `setShardCount`.
  *
  * Session responsibilities:
  *  - Assign unique ids to event sources
@@ -60,8 +74,30 @@ public:
 
     detail::Queue& queue();
 
+    /**
+     * Take the replacement channel, offered by the session (see setAdaptiveChannelSizing).
+     *
+     * Must be called by the writer of the channel only.
+     *
+     * @returns the replacement channel, or nullptr if not offered or already taken
+     */
+    std::shared_ptr<Channel> takeReplacement();
+
     WriterProp writerProp;      /**< Describes the writer of this channel (optional) */ // NOLINT
 
+    // Members below are used by Session for adaptive sizing
+    std::shared_ptr<Channel> replacement;   /**< Channel to switch to, valid if hasReplacement is true */ // NOLINT
+    std::atomic<bool> hasReplacement{false}; /**< Set by the session, cleared by the writer */ // NOLINT
+    bool replacementOffered = false;        /**< True if the session already offered a replacement */ // NOLINT
+    std::size_t highWaterMark = 0;          /**< Max observed queue usage in the current window */ // NOLINT
+    std::size_t pollCount = 0;              /**< Number of polls in the current window */ // NOLINT
+    std::atomic<bool> untaken{false};        /**< True if this is a replacement, not yet taken by the writer */ // NOLINT
+    std::weak_ptr<Channel> predecessor;     /**< The channel replaced by this one, polled before this one, see consumeChannel */ // NOLINT
+
+    std::size_t shardKey = 0; /**< The channel is consumed by shard `shardKey % shardCount`, see consumeShard */ // NOLINT
+    bool priority = false;    /**< Consumed before channels without priority, see createChannel */ // NOLINT
+    bool pendingRead = false; /**< Data of the channel is referred by a DeferredConsume, see beginConsume */ // NOLINT
+
   private:
     std::unique_ptr<char[]> _queue; /**< Magic, Queue, and the underlying buffer of `queue` */
   };
@@ -73,6 +109,70 @@ public:
     std::size_t totalBytesConsumed = 0; /**< Total number of bytes written to the output stream in the lifetime of this session */
     std::size_t channelsPolled = 0;     /**< Number of channels polled to get log data from */
     std::size_t channelsRemoved = 0;    /**< Number of channels removed because they are empty and closed */
+    std::size_t bytesRemaining = 0;     /**< Number of bytes left in the channels not polled because the budget ran out */
+  };
+
+  /** Limit the work done by a single consume call */
+  struct ConsumeBudget
+  {
+    std::size_t bytes = (std::numeric_limits<std::size_t>::max)();   /**< Stop polling channels after consuming this many bytes */
+    std::chrono::nanoseconds time = (std::chrono::nanoseconds::max)(); /**< Stop polling channels after this much time elapsed */
+  };
+
+  /**
+   * Data consumed by `beginConsume`, referring to channel queues,
+   * until released by `endConsume`.
+   *
+   * Moving the object does not invalidate the buffers.
+   * If destroyed or assigned to before `endConsume`, the consumed data is released.
+   */
+  class DeferredConsume
+  {
+  public:
+    struct Buffer
+    {
+      const char* data;
+      std::size_t size;
+    };
+
+    DeferredConsume() = default;
+    ~DeferredConsume();
+
+    DeferredConsume(const DeferredConsume&) = delete;
+    void operator=(const DeferredConsume&) = delete;
+
+    /** Take the data of `rhs`, leave `rhs` empty */
+    DeferredConsume(DeferredConsume&& rhs) noexcept;
+
+    /** Release the data referred by this object, then take the data of `rhs`, see Session::endConsume */
+    DeferredConsume& operator=(DeferredConsume&& rhs);
+
+    /** @returns the consumed data, to be written to the output in order */
+    const std::vector<Buffer>& buffers() const { return _buffers; }
+
+    /** @returns the sum of the buffer sizes */
+    std::size_t size() const { return _size; }
+
+    /** Copy `buffer` - part of the OutputStream interface used by Session */
+    DeferredConsume& write(const char* buffer, std::streamsize size);
+
+  private:
+    friend class Session;
+
+    /** Add `size` bytes at `buffer` by reference, without a copy */
+    void reference(const char* buffer, std::size_t size);
+
+    /** Make `buffers` refer to the copies as well, once every write is done */
+    void resolveCopies();
+
+    void clear();
+
+    Session* _session = nullptr;
+    std::vector<Buffer> _buffers;      /**< data is nullptr for copies until resolveCopies, see _copyOffsets */
+    std::vector<std::size_t> _copyOffsets; /**< Offset in _copies, by buffer, if a copy */
+    detail::VectorOutputStream _copies;    /**< Metadata, WriterProp entries, encoded or shared queue data */
+    std::size_t _size = 0;
+    std::vector<std::pair<std::shared_ptr<Channel>, detail::QueueReader>> _reads; /**< Released by endConsume */
   };
 
   Session();
@@ -85,9 +185,39 @@ public:
    * (i.e: there are no more outstanding shared pointers)
    * and the channel is empty - by the next `consume` call.
    *
+   * Priority channels are polled by `consume` before
+   * the channels without priority, regardless the order of creation.
+   * Events of important severity consumed from a priority channel
+   * do not wait for the events of a busy channel to be consumed first.
+   *
+   * If the writer switches from `predecessor` to the created channel,
+   * the created channel is not polled until `predecessor` is consumed
+   * and removed, so the events of the writer are consumed in order.
+   *
+   * @param priority if true, poll the channel before the ones without priority
+   * @param predecessor the channel replaced by the created channel, if any
    * @return a shared pointer to the created channel
    */
-  std::shared_ptr<Channel> createChannel(std::size_t queueCapacity, WriterProp writerProp = {});
+  std::shared_ptr<Channel> createChannel(
+    std::size_t queueCapacity, WriterProp writerProp = {}, bool priority = false,
+    const std::shared_ptr<Channel>& predecessor = {}
+  );
+
+  /**
+   * Get the queue shared by writers without a private channel.
+   *
+   * The queue is created by the first call, with a capacity
+   * of `queueCapacity` bytes, further calls ignore the argument.
+   * The queue is owned by the session, and remains valid
+   * as long as the session is valid.
+   *
+   * Any number of writers can write the shared queue concurrently.
+   * Events of the shared queue are consumed with an empty WriterProp
+   * (writer id and name are not set), regardless of which writer added them.
+   *
+   * @see SessionWriter::shared
+   */
+  detail::SharedQueue& sharedQueue(std::size_t queueCapacity = 1 << 20);
 
   /**
    * Thread-safe way to set the writer id of `channel` to `id`.
@@ -120,6 +250,15 @@ public:
    */
   std::uint64_t addEventSource(EventSource eventSource);
 
+  /**
+   * @returns a new id, unique in this session, to be
+   *          used by an InternedString entry.
+   *
+   * Can be called concurrently with other session methods.
+   * @see SessionWriter::addEvent
+   */
+  std::uint64_t newInternedStringId();
+
   /** @returns Severity below writers should not add events */
   Severity minSeverity() const;
 
@@ -140,6 +279,50 @@ public:
    */
   void setClockSync(const ClockSync& clockSync);
 
+  /**
+   * Enable or disable the delta encoding of event clocks.
+   *
+   * If enabled, `consume` writes the events read from a channel
+   * into a single EventBatch entry, where the clock value of each event
+   * is encoded as a variable length difference from the clock of the
+   * first event of the batch, instead of a fixed 8 bytes.
+   * This makes the consumed data smaller, at the cost of
+   * additional work done by the consumer.
+   * Producers are not affected.
+   *
+   * Readers not aware of EventBatch entries skip the encoded events.
+   * Disabled by default.
+   */
+  void setClockDeltaEncoding(bool enable);
+
+  /**
+   * Enable or disable adaptive sizing of channel queues.
+   *
+   * If enabled, `consume` tracks the highest observed usage of
+   * each channel queue in a window of `window` consume calls.
+   * If the queue is found too small (more than half full, when polled),
+   * or too large (usage is below 1/16 of the capacity, during the whole window),
+   * the consumer creates a replacement channel with a queue
+   * of four times the high-water mark (rounded up to a power of two),
+   * but not smaller than `minCapacity`, and not larger than `maxCapacity`.
+   * The replacement is offered to the writer of the channel,
+   * which takes it when its queue runs out of space, instead of
+   * allocating a new channel, see SessionWriter::addEvent.
+   * Each channel is offered a replacement at most once,
+   * the writer continues the same way with the replacement.
+   *
+   * Channels created after this call by SessionWriter start
+   * with a queue of `minCapacity` bytes, see `initialQueueCapacity`.
+   * If `minCapacity` is zero, adaptive sizing is disabled (default).
+   */
+  void setAdaptiveChannelSizing(std::size_t minCapacity, std::size_t maxCapacity, std::size_t window = 64);
+
+  /**
+   * @returns `minCapacity` set by setAdaptiveChannelSizing, if enabled,
+   *          `queueCapacity` otherwise.
+   */
+  std::size_t initialQueueCapacity(std::size_t queueCapacity);
+
   /**
    * Move metadata and data from the session to `out`.
    *
@@ -149,10 +332,17 @@ public:
    * Then, metadata (EventSources) are consumed.
    * The consume logic makes sure sources are always consumed
    * sooner than events referencing them.
+   * The same applies to the LiteralString entries of binlog::literal arguments,
+   * and to the ErrorCodeMessage entries of std::error_code arguments.
    *
-   * After that, each channel is polled for log data,
+   * After that, the shared queue and each channel is polled for log data,
    * and consumed together with an WriterProp entry, if data is found.
+   * Priority channels (see `createChannel`) are polled first.
+   * If clock delta encoding is enabled, the data is
+   * consumed as an EventBatch entry, see `setClockDeltaEncoding`.
    * Closed and empty channels are removed.
+   * If adaptive sizing is enabled, replacements of
+   * wrongly sized channels are created, see `setAdaptiveChannelSizing`.
    * Because data is consumed in batches, it is possible
    * that concurrently added events consumed from different channels
    * appear out of order. Events consumed from a single channel
@@ -169,14 +359,36 @@ public:
   template <typename OutputStream>
   ConsumeResult consume(OutputStream& out);
 
+  /**
+   * Same as `consume(out)`, but stops polling channels
+   * when the consumed bytes or the elapsed time reaches `budget`.
+   *
+   * The budget is checked before each channel is polled, and the
+   * data of a polled channel is consumed in one go: the consumed bytes
+   * can exceed the budget by the capacity of a single channel queue.
+   * Metadata, the shared queue and at least one channel are always consumed.
+   *
+   * Priority channels are polled first. The other channels are polled
+   * round-robin: the next call starts with the first channel not polled
+   * by this call, so each channel is polled eventually.
+   * Events of a writer which switched to a new channel are consumed in order:
+   * the new channel is not polled until the old one is consumed and removed.
+   * The number of bytes left in the not polled channels is reported
+   * as `bytesRemaining` of the result.
+   */
+  template <typename OutputStream>
+  ConsumeResult consume(OutputStream& out, const ConsumeBudget& budget);
+
   /**
    * Move already consumed metadata again to `out`.
    *
-   * Already consumed EventSources and the ClockSync are consumed.
+   * Already consumed EventSources, LiteralStrings, ErrorCodeMessages,
+   * InternedStrings (the last one of each id) and the ClockSync are consumed.
    * Not-yet consumed EventSources will not be consumed.
    *
    * Useful if `out` changes runtime, e.g: because of log rotation.
    * Re-adding metadata makes the new logfile self contained.
+   * If the session is sharded, use `reconsumeShardMetadata` instead.
    *
    * @requires OutputStream must model the mserialize::OutputStream concept
    * @param out where the binary data will be written to.
@@ -186,25 +398,237 @@ public:
   template <typename OutputStream>
   ConsumeResult reconsumeMetadata(OutputStream& out);
 
+  /**
+   * Two-phase consume, for asynchronous outputs: consume the same data
+   * as `consume` would, but instead of writing it to an output stream,
+   * make `dc` refer to it. The data of the channels is not copied,
+   * `dc.buffers()` refer to the channel queues directly, and the
+   * space of the queues is not released until `endConsume(dc)`.
+   * Metadata, WriterProp entries, data of the shared queue,
+   * and clock delta encoded data (see setClockDeltaEncoding) are copied to `dc`.
+   *
+   * Channels with data referred by a not yet ended DeferredConsume
+   * are not polled by `beginConsume` or `consume`.
+   * The buffers of different DeferredConsume objects must be written
+   * in the order of the `beginConsume` calls that consumed them,
+   * but they can be ended in any order.
+   * Do not mix `beginConsume` and `consumeShard` calls on the same session.
+   *
+   *    Session::DeferredConsume dc;
+   *    session.beginConsume(dc);
+   *    asyncWrite(dc.buffers(), [&]() { session.endConsume(dc); });
+   *
+   * @pre `dc` is empty: new, or already ended
+   * @returns description of the job done, see ConsumeResult.
+   */
+  ConsumeResult beginConsume(DeferredConsume& dc);
+
+  /**
+   * Release the queue space referred by `dc`, and make `dc` empty.
+   *
+   * Can be called from any thread.
+   * @pre `dc` was filled by `beginConsume` of this session, or empty
+   */
+  void endConsume(DeferredConsume& dc);
+
+  /**
+   * Partition the channels of the session into `count` shards,
+   * to be consumed in parallel by `consumeShard`.
+   *
+   * Each channel belongs to a single shard, channels are
+   * assigned to shards round-robin, in order of creation,
+   * or by the selector set by `setChannelShardSelector`.
+   * Replacements of channels (see setAdaptiveChannelSizing)
+   * belong to the shard of the channel they replace.
+   *
+   * Every shard starts from scratch: the next `consumeShard` call
+   * of each shard consumes the ClockSync and every EventSource,
+   * making the output of each shard self contained.
+   *
+   * Must not be called concurrently with `consumeShard`.
+   * If `count` is zero, sharding is disabled (default).
+   */
+  void setShardCount(std::size_t count);
+
+  /**
+   * Set the function that selects the shard of new channels.
+   *
+   * `selector` is called by `createChannel`, on the thread
+   * creating the channel (e.g: by the constructor of SessionWriter),
+   * with the session lock held. The channel is assigned to the shard
+   * `selector() % shardCount`. If `selector` is empty,
+   * channels are assigned round-robin (default).
+   *
+   * To make writers of different NUMA nodes write different shards,
+   * use binlog::currentNumaNode as selector, and `numaNodeCount()` shards.
+   * As a queue is allocated by the channel, but first written by the writer,
+   * on most systems the queue memory is local to the node of the writer.
+   * Consume each shard by a thread running on the same node.
+   */
+  void setChannelShardSelector(std::function<std::size_t()> selector);
+
+  /**
+   * Move metadata and the data of the channels of shard `shard` to `out`.
+   *
+   * Same as `consume`, but polls only the channels assigned
+   * to `shard` (see setShardCount), and the shared queue by shard 0.
+   * Metadata (ClockSync, EventSources) is consumed by every shard,
+   * LiteralString and ErrorCodeMessage entries by the shards
+   * having events referring to them.
+   *
+   * Different shards can be consumed concurrently, to different
+   * output streams: the session lock is not held while the data
+   * is written to `out`. A single shard must not be consumed
+   * by more than one thread at a time.
+   * Do not mix `consume` and `consumeShard` calls on the same session.
+   *
+   * Events of different shards are not ordered. As each shard
+   * consumes the same event sources with the same ids, the outputs
+   * can be read as a single log by concatenating them,
+   * and sorting the events by time, e.g: `cat shard*.blog | bread -s`.
+   *
+   * @requires OutputStream must model the mserialize::OutputStream concept
+   * @param shard index of the shard to consume, less than the shard count
+   * @param out where the binary data will be written to.
+   * @throws std::out_of_range if `shard` is not less than the shard count
+   *
+   * @returns description of the job done, see ConsumeResult.
+   */
+  template <typename OutputStream>
+  ConsumeResult consumeShard(std::size_t shard, OutputStream& out);
+
+  /**
+   * Move the metadata already consumed by shard `shard` again to `out`,
+   * the sharded counterpart of `reconsumeMetadata`.
+   *
+   * Useful if the output of the shard changes runtime, e.g: because of log rotation.
+   * Must not be called concurrently with `consumeShard` of the same shard.
+   *
+   * @requires OutputStream must model the mserialize::OutputStream concept
+   * @param shard index of the shard, less than the shard count
+   * @returns description of the job done, see ConsumeResult.
+   * @throws std::out_of_range if `shard` is not less than the shard count
+   */
+  template <typename OutputStream>
+  ConsumeResult reconsumeShardMetadata(std::size_t shard, OutputStream& out);
+
 private:
+  /** A channel taken by consumeShard, and the data read from it */
+  struct ShardChannel
+  {
+    std::shared_ptr<Channel> channel;
+    bool isClosed;
+    WriterProp writerProp; /**< Copy of channel->writerProp, taken with the lock held */
+    detail::QueueReader reader;
+    detail::QueueReader::ReadResult data;
+  };
+
+  /** Consumer state of a shard, see consumeShard */
+  struct Shard
+  {
+    bool consumeClockSync = true;
+    std::streamsize sourcesConsumePos = 0;
+    detail::LiteralCollector literals;
+    WriterProp sharedWriterProp;
+    std::vector<ShardChannel> channels; /**< Channels polled by the running consumeShard call */
+    detail::VectorOutputStream metadata;
+    detail::VectorOutputStream specialEntryBuffer;
+    detail::VectorOutputStream batchBuffer;
+    detail::VectorOutputStream sharedBuffer;
+  };
+
   template <typename Entry, typename OutputStream>
-  std::size_t consumeSpecialEntry(const Entry& entry, OutputStream& out);
+  static std::size_t consumeSpecialEntry(const Entry& entry, detail::VectorOutputStream& buffer, OutputStream& out);
+
+  /** Consume the data of `channelptr`, reset it if closed, see `consume` */
+  template <typename OutputStream>
+  void consumeChannel(std::shared_ptr<Channel>& channelptr, OutputStream& out, ConsumeResult& result);
+
+  /** Consume `data` read from a queue, preceded by `writerProp` */
+  template <typename OutputStream>
+  std::size_t consumeData(WriterProp& writerProp, const detail::QueueReader::ReadResult& data, OutputStream& out);
+
+  /**
+   * Write `writerProp` and `data` to `out`, as an EventBatch if `clockDeltaEncoding`,
+   * using `batchBuffer` and `specialEntryBuffer` as scratch space.
+   */
+  template <typename OutputStream>
+  static std::size_t writeData(
+    WriterProp& writerProp, const detail::QueueReader::ReadResult& data, bool clockDeltaEncoding,
+    detail::VectorOutputStream& batchBuffer, detail::VectorOutputStream& specialEntryBuffer,
+    OutputStream& out
+  );
+
+  /** @returns true if a writer added an InternedString entry, see newInternedStringId */
+  bool hasInternedStrings() const;
+
+  /** Add `channel` to `_channels`: after the channels without priority, or after the last priority channel */
+  void addChannel(std::shared_ptr<Channel> channel);
+
+  /**
+   * @returns false if `channel` must not be polled now: its data is not yet
+   *          released by endConsume, or the channel it replaces is not yet consumed.
+   */
+  static bool isPollable(const Channel& channel);
+
+  /**
+   * Called after `channelptr` is polled, `usage` bytes read from its queue:
+   * adapt the size of the channel, reset `channelptr` if `isClosed`,
+   * and count the poll in `result`. Reset channels are removed by `updateChannels`.
+   */
+  void endPoll(std::shared_ptr<Channel>& channelptr, bool isClosed, std::size_t usage, ConsumeResult& result);
+
+  /**
+   * Remove the channels reset by `endPoll`, add the replacements
+   * created by adaptChannelSize, and add `result.bytesConsumed` to the total.
+   */
+  void updateChannels(ConsumeResult& result);
+
+  /** Offer a replacement to `channel` if its queue is not sized well, observing `usage` */
+  void adaptChannelSize(const std::shared_ptr<Channel>& channelptr, std::size_t capacity, std::size_t usage);
+
+  /** Write the events of `data` to `out` as an EventBatch entry */
+  static void encodeEventBatch(const detail::QueueReader::ReadResult& data, detail::VectorOutputStream& out);
+
+  /** Set `clock` to the clock value of the first event in `entries`, @returns false if there is no event */
+  static bool firstEventClock(Range entries, std::uint64_t& clock);
+
+  static void encodeClockDeltas(Range entries, std::uint64_t clockBase, detail::VectorOutputStream& out);
 
   std::mutex _mutex;
 
-  std::vector<std::shared_ptr<Channel>> _channels;
+  std::vector<std::shared_ptr<Channel>> _channels; /**< Priority channels first, in order of addition */
+  std::vector<std::shared_ptr<Channel>> _replacementChannels; /**< Created by adaptChannelSize, not yet added to _channels */
+  std::unique_ptr<detail::SharedQueue> _sharedQueue;
+  WriterProp _sharedWriterProp;
   detail::RecoverableVectorOutputStream _clockSync = {0xFE214F726E35BDBC, this};
   detail::RecoverableVectorOutputStream _sources = {0xFE214F726E35BDBC, this};
   std::streamsize _sourcesConsumePos = 0;
   std::uint64_t _nextSourceId = 1;
 
   std::size_t _totalConsumedBytes = 0;
+  std::size_t _consumeCursor = 0; /**< Index of the channel without priority to poll first, see consume(out, budget) */
+
+  detail::LiteralCollector _literals;
 
   std::atomic<Severity> _minSeverity = {Severity::trace};
 
+  std::atomic<std::uint64_t> _nextInternedStringId = {1};
+
   bool _consumeClockSync = true;
+  bool _clockDeltaEncoding = false;
+
+  std::size_t _minQueueCapacity = 0; /**< Adaptive sizing is enabled if not zero */
+  std::size_t _maxQueueCapacity = 0;
+  std::size_t _sizingWindow = 0;
+
+  std::size_t _nextShardKey = 0;
+  std::function<std::size_t()> _shardSelector; /**< Selects the shardKey of new channels, if set */
+  std::vector<std::unique_ptr<Shard>> _shards; /**< Sharding is enabled if not empty */
 
   detail::VectorOutputStream _specialEntryBuffer;
+  detail::VectorOutputStream _batchBuffer;
+  detail::VectorOutputStream _sharedBuffer;
 };
 
 inline Session::Channel::Channel(Session& session, std::size_t queueCapacity, WriterProp writerProp_)
@@ -247,18 +671,134 @@ inline detail::Queue& Session::Channel::queue()
   return *reinterpret_cast<detail::Queue*>(_queue.get() + sizeof(std::uint64_t) + sizeof(Session*));
 }
 
+inline std::shared_ptr<Session::Channel> Session::Channel::takeReplacement()
+{
+  if (! hasReplacement.load(std::memory_order_acquire)) { return nullptr; }
+
+  hasReplacement.store(false, std::memory_order_relaxed);
+  replacement->untaken.store(false, std::memory_order_release);
+  return std::move(replacement);
+}
+
+inline Session::DeferredConsume::~DeferredConsume()
+{
+  if (_session != nullptr && ! _reads.empty())
+  {
+    try
+    {
+      _session->endConsume(*this);
+    }
+    catch (...) {} // NOLINT mutex lock failed, the channels remain blocked
+  }
+}
+
+inline Session::DeferredConsume::DeferredConsume(DeferredConsume&& rhs) noexcept
+  :_session(rhs._session),
+   _buffers(std::move(rhs._buffers)),
+   _copyOffsets(std::move(rhs._copyOffsets)),
+   _copies(std::move(rhs._copies)),
+   _size(rhs._size),
+   _reads(std::move(rhs._reads))
+{
+  rhs._size = 0; // moved-from vectors are empty
+}
+
+inline Session::DeferredConsume& Session::DeferredConsume::operator=(DeferredConsume&& rhs)
+{
+  if (this == &rhs) { return *this; }
+
+  if (_session != nullptr && ! _reads.empty())
+  {
+    _session->endConsume(*this);
+  }
+
+  _session = rhs._session;
+  _buffers = std::move(rhs._buffers);
+  _copyOffsets = std::move(rhs._copyOffsets);
+  _copies = std::move(rhs._copies);
+  _size = rhs._size;
+  _reads = std::move(rhs._reads);
+  rhs.clear();
+  return *this;
+}
+
+inline Session::DeferredConsume& Session::DeferredConsume::write(const char* buffer, std::streamsize size)
+{
+  if (size == 0) { return *this; }
+
+  // extend the previous copy, if any
+  if (_buffers.empty() || _buffers.back().data != nullptr)
+  {
+    _buffers.push_back(Buffer{nullptr, 0});
+    _copyOffsets.push_back(_copies.vector.size());
+  }
+
+  _copies.write(buffer, size);
+  _buffers.back().size += std::size_t(size);
+  _size += std::size_t(size);
+  return *this;
+}
+
+inline void Session::DeferredConsume::reference(const char* buffer, std::size_t size)
+{
+  if (size == 0) { return; }
+
+  _buffers.push_back(Buffer{buffer, size});
+  _copyOffsets.push_back(0);
+  _size += size;
+}
+
+inline void Session::DeferredConsume::resolveCopies()
+{
+  for (std::size_t i = 0; i < _buffers.size(); ++i)
+  {
+    if (_buffers[i].data == nullptr)
+    {
+      _buffers[i].data = _copies.data() + _copyOffsets[i];
+    }
+  }
+}
+
+inline void Session::DeferredConsume::clear()
+{
+  _buffers.clear();
+  _copyOffsets.clear();
+  _copies.clear();
+  _size = 0;
+  _reads.clear();
+}
+
 inline Session::Session()
 {
   const ClockSync clockSync = systemClockSync();
   serializeSizePrefixedTagged(clockSync, _clockSync);
 }
 
-inline std::shared_ptr<Session::Channel> Session::createChannel(std::size_t queueCapacity, WriterProp writerProp)
+inline std::shared_ptr<Session::Channel> Session::createChannel(
+  std::size_t queueCapacity, WriterProp writerProp, bool priority,
+  const std::shared_ptr<Channel>& predecessor
+)
 {
   std::lock_guard<std::mutex> lock(_mutex);
 
-  _channels.push_back(std::make_shared<Channel>(*this, queueCapacity, std::move(writerProp)));
-  return _channels.back();
+  std::shared_ptr<Channel> channel = std::make_shared<Channel>(*this, queueCapacity, std::move(writerProp));
+  channel->shardKey = _shardSelector ? _shardSelector() : _nextShardKey++;
+  channel->priority = priority;
+  channel->predecessor = predecessor;
+  addChannel(channel);
+  return channel;
+}
+
+inline detail::SharedQueue& Session::sharedQueue(std::size_t queueCapacity)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (! _sharedQueue)
+  {
+    _sharedQueue.reset(new detail::SharedQueue(queueCapacity));
+  }
+
+  return *_sharedQueue;
 }
 
 inline void Session::setChannelWriterId(Channel& channel, std::uint64_t id)
@@ -266,12 +806,23 @@ inline void Session::setChannelWriterId(Channel& channel, std::uint64_t id)
   std::lock_guard<std::mutex> lock(_mutex);
 
   channel.writerProp.id = id;
+
+  // the writer will take the replacement, update it as well
+  if (channel.hasReplacement.load(std::memory_order_acquire))
+  {
+    channel.replacement->writerProp.id = id;
+  }
 }
 
 inline void Session::setChannelWriterName(Channel& channel, std::string name)
 {
   std::lock_guard<std::mutex> lock(_mutex);
 
+  if (channel.hasReplacement.load(std::memory_order_acquire))
+  {
+    channel.replacement->writerProp.name = name;
+  }
+
   channel.writerProp.name = std::move(name);
 }
 
@@ -281,9 +832,26 @@ inline std::uint64_t Session::addEventSource(EventSource eventSource)
 
   eventSource.id = _nextSourceId;
   serializeSizePrefixedTagged(eventSource, _sources);
+  _literals.addEventSource(eventSource);
+  for (const std::unique_ptr<Shard>& shard : _shards)
+  {
+    shard->literals.addEventSource(eventSource);
+  }
   return _nextSourceId++;
 }
 
+inline std::uint64_t Session::newInternedStringId()
+{
+  return _nextInternedStringId.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline bool Session::hasInternedStrings() const
+{
+  // the id is taken before the entry is added to the queue,
+  // and the queue is read (with acquire semantics) before this call.
+  return _nextInternedStringId.load(std::memory_order_relaxed) != 1;
+}
+
 inline Severity Session::minSeverity() const
 {
   return _minSeverity.load(std::memory_order_acquire);
@@ -300,10 +868,62 @@ inline void Session::setClockSync(const ClockSync& clockSync)
 
   serializeSizePrefixedTagged(clockSync, _clockSync);
   _consumeClockSync = true;
+  for (const std::unique_ptr<Shard>& shard : _shards)
+  {
+    shard->consumeClockSync = true;
+  }
+}
+
+inline void Session::setClockDeltaEncoding(bool enable)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _clockDeltaEncoding = enable;
+}
+
+inline void Session::setAdaptiveChannelSizing(std::size_t minCapacity, std::size_t maxCapacity, std::size_t window)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _minQueueCapacity = minCapacity;
+  _maxQueueCapacity = (std::max)(minCapacity, maxCapacity);
+  _sizingWindow = (std::max)(window, std::size_t(1));
+}
+
+inline std::size_t Session::initialQueueCapacity(std::size_t queueCapacity)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  return (_minQueueCapacity != 0) ? _minQueueCapacity : queueCapacity;
+}
+
+inline void Session::setShardCount(std::size_t count)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _shards.clear();
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    _shards.emplace_back(new Shard());
+    _shards.back()->literals = _literals.withSameSources();
+  }
+}
+
+inline void Session::setChannelShardSelector(std::function<std::size_t()> selector)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _shardSelector = std::move(selector);
 }
 
 template <typename OutputStream>
 Session::ConsumeResult Session::consume(OutputStream& out)
+{
+  return consume(out, ConsumeBudget{});
+}
+
+template <typename OutputStream>
+Session::ConsumeResult Session::consume(OutputStream& out, const ConsumeBudget& budget)
 {
   // This lock:
   //  - Ensures only a single consumer is running at a time
@@ -323,6 +943,7 @@ Session::ConsumeResult Session::consume(OutputStream& out)
   // that blocks P1 *and* P2 while adding ES123.
   std::lock_guard<std::mutex> lock(_mutex);
 
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
   ConsumeResult result;
 
   // add a clock sync if not yet added
@@ -339,98 +960,597 @@ Session::ConsumeResult Session::consume(OutputStream& out)
   _sourcesConsumePos += sourceWriteSize;
   result.bytesConsumed += std::size_t(sourceWriteSize);
 
-  // consume some events
-  for (std::shared_ptr<Channel>& channelptr : _channels)
+  // consume events of the shared queue first:
+  // writers upgraded to a private channel added them earlier
+  if (_sharedQueue)
   {
-    // Important to check if channel is closed before beginRead,
-    // otherwise the following race becomes possible:
-    //  - Consumer finds queue is empty
-    //  - Producer adds data
-    //  - Producer closes the queue
-    //  - Consumer finds queue is closed, removes it -> data loss
-    const bool isClosed = (channelptr.use_count() == 1);
+    _sharedBuffer.clear();
+    _sharedQueue->read(_sharedBuffer);
 
-    Channel& ch = *channelptr;
+    detail::QueueReader::ReadResult data;
+    data.buffer1 = _sharedBuffer.data();
+    data.size1 = _sharedBuffer.vector.size();
+    result.bytesConsumed += consumeData(_sharedWriterProp, data, out);
+  }
 
-    detail::QueueReader reader(ch.queue());
-    const detail::QueueReader::ReadResult data = reader.beginRead();
-    if (data.size())
+  // consume some events: priority channels first,
+  // then the others, starting where the previous call stopped
+  const std::size_t priorityCount = std::size_t(std::count_if(
+    _channels.begin(), _channels.end(),
+    [](const std::shared_ptr<Channel>& channelptr) { return channelptr->priority; }
+  ));
+  const std::size_t otherCount = _channels.size() - priorityCount;
+  const std::size_t cursor = (_consumeCursor < otherCount) ? _consumeCursor : 0;
+  auto channelIndex = [&](std::size_t i)
+  {
+    return (i < priorityCount) ? i : priorityCount + (cursor + i - priorityCount) % otherCount;
+  };
+
+  std::size_t i = 0;
+  for (; i < _channels.size(); ++i)
+  {
+    // poll at least one channel, to make progress
+    const bool outOfBudget = result.bytesConsumed >= budget.bytes
+      || (budget.time != (std::chrono::nanoseconds::max)() && std::chrono::steady_clock::now() - start >= budget.time);
+    if (result.channelsPolled != 0 && outOfBudget) { break; }
+
+    consumeChannel(_channels[channelIndex(i)], out, result);
+  }
+
+  // the channels not polled are never removed: remember the next one
+  const Channel* nextChannel = nullptr;
+  for (std::size_t j = i; j < _channels.size(); ++j)
+  {
+    Channel& ch = *_channels[channelIndex(j)];
+    if (nextChannel == nullptr && ! ch.priority) { nextChannel = &ch; }
+    result.bytesRemaining += detail::QueueReader(ch.queue()).beginRead().size();
+  }
+
+  updateChannels(result);
+
+  _consumeCursor = 0;
+  if (nextChannel != nullptr)
+  {
+    const auto firstOther = std::find_if(_channels.begin(), _channels.end(),
+      [](const std::shared_ptr<Channel>& channelptr) { return ! channelptr->priority; }
+    );
+    const auto next = std::find_if(firstOther, _channels.end(),
+      [nextChannel](const std::shared_ptr<Channel>& channelptr) { return channelptr.get() == nextChannel; }
+    );
+    _consumeCursor = std::size_t(next - firstOther);
+  }
+
+  return result;
+}
+
+template <typename OutputStream>
+void Session::consumeChannel(std::shared_ptr<Channel>& channelptr, OutputStream& out, ConsumeResult& result)
+{
+  if (! isPollable(*channelptr)) { return; }
+
+  // Important to check if channel is closed before beginRead,
+  // otherwise the following race becomes possible:
+  //  - Consumer finds queue is empty
+  //  - Producer adds data
+  //  - Producer closes the queue
+  //  - Consumer finds queue is closed, removes it -> data loss
+  const bool isClosed = (channelptr.use_count() == 1);
+
+  Channel& ch = *channelptr;
+
+  detail::QueueReader reader(ch.queue());
+  const detail::QueueReader::ReadResult data = reader.beginRead();
+  if (data.size())
+  {
+    result.bytesConsumed += consumeData(ch.writerProp, data, out);
+    reader.endRead();
+  }
+
+  endPoll(channelptr, isClosed, data.size(), result);
+}
+
+template <typename OutputStream>
+Session::ConsumeResult Session::reconsumeMetadata(OutputStream& out)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  ConsumeResult result;
+
+  // add clock sync
+  out.write(_clockSync.data(), _clockSync.ssize());
+  result.bytesConsumed += std::size_t(_clockSync.ssize());
+
+  // add consumed sources
+  out.write(_sources.data(), _sourcesConsumePos);
+  result.bytesConsumed += std::size_t(_sourcesConsumePos);
+
+  // add consumed strings of literals and interned strings
+  result.bytesConsumed += _literals.reconsume(out);
+
+  _totalConsumedBytes += result.bytesConsumed;
+  result.totalBytesConsumed = _totalConsumedBytes;
+  return result;
+}
+
+template <typename OutputStream>
+Session::ConsumeResult Session::consumeShard(std::size_t shardIndex, OutputStream& out)
+{
+  ConsumeResult result;
+  Shard* shard = nullptr;
+  detail::SharedQueue* sharedQueue = nullptr;
+  bool clockDeltaEncoding = false;
+
+  // take the channels of the shard, see `consume` for the closed check
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    shard = _shards.at(shardIndex).get();
+    for (const std::shared_ptr<Channel>& channelptr : _channels)
     {
-      // consume writerProp entry
-      ch.writerProp.batchSize = data.size();
-      result.bytesConsumed += consumeSpecialEntry(ch.writerProp, out);
+      if (channelptr->shardKey % _shards.size() != shardIndex) { continue; }
+      if (! isPollable(*channelptr)) { continue; }
 
-      // consume queue data
-      out.write(data.buffer1, std::streamsize(data.size1));
-      if (data.size2)
-      {
-        // data wraps around the end of the queue, consume the second half as well
-        out.write(data.buffer2, std::streamsize(data.size2));
-      }
+      const bool isClosed = (channelptr.use_count() == 1);
+      shard->channels.push_back(ShardChannel{
+        channelptr, isClosed, channelptr->writerProp, detail::QueueReader(channelptr->queue()), {}
+      });
+    }
+
+    if (shardIndex == 0) { sharedQueue = _sharedQueue.get(); }
+    clockDeltaEncoding = _clockDeltaEncoding;
+  }
+
+  // read data without the lock: only this consumer reads these queues
+  detail::QueueReader::ReadResult sharedData;
+  if (sharedQueue != nullptr)
+  {
+    shard->sharedBuffer.clear();
+    sharedQueue->read(shard->sharedBuffer);
+    sharedData.buffer1 = shard->sharedBuffer.data();
+    sharedData.size1 = shard->sharedBuffer.vector.size();
+  }
 
-      reader.endRead();
-      result.bytesConsumed += data.size();
+  for (ShardChannel& sc : shard->channels)
+  {
+    sc.data = sc.reader.beginRead();
+  }
+
+  // Take metadata after the data is read, to make sure
+  // the sources of the read events are included (see `consume`).
+  // The literal collectors of the shards are updated by addEventSource.
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    shard->metadata.clear();
+    if (shard->consumeClockSync)
+    {
+      shard->metadata.write(_clockSync.data(), _clockSync.ssize());
+      shard->consumeClockSync = false;
     }
 
-    if (isClosed)
+    const std::streamsize sourceWriteSize = _sources.ssize() - shard->sourcesConsumePos;
+    shard->metadata.write(_sources.data() + shard->sourcesConsumePos, sourceWriteSize);
+    shard->sourcesConsumePos += sourceWriteSize;
+
+    if (sharedData.size()) { shard->literals.consume(sharedData, shard->metadata, hasInternedStrings()); }
+    for (const ShardChannel& sc : shard->channels)
     {
-      // queue is empty and closed, remove it
-      channelptr.reset();
-      result.channelsRemoved++;
+      if (sc.data.size()) { shard->literals.consume(sc.data, shard->metadata, hasInternedStrings()); }
     }
+  }
 
-    result.channelsPolled++;
+  // write metadata and data without the lock, parallel to other shards
+  if (shard->metadata.ssize() != 0)
+  {
+    out.write(shard->metadata.data(), shard->metadata.ssize());
+    result.bytesConsumed += shard->metadata.vector.size();
   }
 
-  // remove empty and closed channels
-  _channels.erase(
-    std::remove_if(
-      _channels.begin(), _channels.end(),
-      [](const std::shared_ptr<Channel>& channelptr) { return !channelptr; }
-    ),
-    _channels.end()
-  );
+  if (sharedData.size())
+  {
+    result.bytesConsumed += writeData(
+      shard->sharedWriterProp, sharedData, clockDeltaEncoding,
+      shard->batchBuffer, shard->specialEntryBuffer, out
+    );
+  }
 
-  _totalConsumedBytes += result.bytesConsumed;
-  result.totalBytesConsumed = _totalConsumedBytes;
+  for (ShardChannel& sc : shard->channels)
+  {
+    if (sc.data.size())
+    {
+      result.bytesConsumed += writeData(
+        sc.writerProp, sc.data, clockDeltaEncoding,
+        shard->batchBuffer, shard->specialEntryBuffer, out
+      );
+      sc.reader.endRead();
+    }
+  }
+
+  // remove closed channels, add replacements
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (ShardChannel& sc : shard->channels)
+    {
+      // the channel is missing if it was removed by a concurrent `consume` (which is not allowed)
+      const auto it = std::find(_channels.begin(), _channels.end(), sc.channel);
+      if (it != _channels.end())
+      {
+        endPoll(*it, sc.isClosed, sc.data.size(), result);
+      }
+    }
+
+    shard->channels.clear();
+    updateChannels(result);
+  }
 
   return result;
 }
 
 template <typename OutputStream>
-Session::ConsumeResult Session::reconsumeMetadata(OutputStream& out)
+Session::ConsumeResult Session::reconsumeShardMetadata(std::size_t shardIndex, OutputStream& out)
 {
   std::lock_guard<std::mutex> lock(_mutex);
 
+  Shard& shard = *_shards.at(shardIndex);
   ConsumeResult result;
 
   // add clock sync
   out.write(_clockSync.data(), _clockSync.ssize());
   result.bytesConsumed += std::size_t(_clockSync.ssize());
 
-  // add consumed sources
-  out.write(_sources.data(), _sourcesConsumePos);
-  result.bytesConsumed += std::size_t(_sourcesConsumePos);
+  // add sources consumed by the shard
+  out.write(_sources.data(), shard.sourcesConsumePos);
+  result.bytesConsumed += std::size_t(shard.sourcesConsumePos);
+
+  // add strings of literals and interned strings consumed by the shard
+  result.bytesConsumed += shard.literals.reconsume(out);
 
   _totalConsumedBytes += result.bytesConsumed;
   result.totalBytesConsumed = _totalConsumedBytes;
   return result;
 }
 
+inline Session::ConsumeResult Session::beginConsume(DeferredConsume& dc)
+{
+  // see `consume` for the reasons of the lock
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  ConsumeResult result;
+  dc._session = this;
+
+  // metadata is copied: _clockSync and _sources might be reallocated later
+  if (_consumeClockSync)
+  {
+    dc.write(_clockSync.data(), _clockSync.ssize());
+    _consumeClockSync = false;
+  }
+
+  const std::streamsize sourceWriteSize = _sources.ssize() - _sourcesConsumePos;
+  dc.write(_sources.data() + _sourcesConsumePos, sourceWriteSize);
+  _sourcesConsumePos += sourceWriteSize;
+
+  // the shared queue is read by copy
+  if (_sharedQueue)
+  {
+    _sharedBuffer.clear();
+    _sharedQueue->read(_sharedBuffer);
+
+    detail::QueueReader::ReadResult data;
+    data.buffer1 = _sharedBuffer.data();
+    data.size1 = _sharedBuffer.vector.size();
+    consumeData(_sharedWriterProp, data, dc);
+  }
+
+  for (std::shared_ptr<Channel>& channelptr : _channels)
+  {
+    if (! isPollable(*channelptr)) { continue; }
+
+    // see `consume` for the order of isClosed and beginRead
+    const bool isClosed = (channelptr.use_count() == 1);
+
+    Channel& ch = *channelptr;
+
+    detail::QueueReader reader(ch.queue());
+    const detail::QueueReader::ReadResult data = reader.beginRead();
+    if (data.size())
+    {
+      if (_clockDeltaEncoding)
+      {
+        // encoded to a new buffer, copied
+        consumeData(ch.writerProp, data, dc);
+        reader.endRead();
+      }
+      else
+      {
+        _literals.consume(data, dc, hasInternedStrings());
+
+        ch.writerProp.batchSize = data.size();
+        consumeSpecialEntry(ch.writerProp, _specialEntryBuffer, dc);
+
+        dc.reference(data.buffer1, data.size1);
+        dc.reference(data.buffer2, data.size2);
+
+        // released by endConsume
+        dc._reads.emplace_back(channelptr, reader);
+        ch.pendingRead = true;
+      }
+    }
+
+    // if closed, removed: dc keeps it alive, if it refers to its data
+    endPoll(channelptr, isClosed, data.size(), result);
+  }
+
+  dc.resolveCopies();
+
+  result.bytesConsumed = dc.size();
+  updateChannels(result);
+
+  return result;
+}
+
+inline void Session::endConsume(DeferredConsume& dc)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  for (auto& read : dc._reads)
+  {
+    read.second.endRead();
+    read.first->pendingRead = false;
+  }
+
+  dc.clear();
+}
+
 template <typename Entry, typename OutputStream>
-std::size_t Session::consumeSpecialEntry(const Entry& entry, OutputStream& out)
+std::size_t Session::consumeSpecialEntry(const Entry& entry, detail::VectorOutputStream& buffer, OutputStream& out)
 {
-  // Write entry to `_specialEntryBuffer` first, only then to `out` in one go.
+  // Write entry to `buffer` first, only then to `out` in one go.
   // This makes OutputStream logic simpler (if it parses the stream),
   // as it does not have to deal with partial entries.
   // (serializeSizePrefixedTagged serializes Entry field by field)
   // This is also more efficient if OutputStream does unbuffered I/O.
-  _specialEntryBuffer.clear();
-  const std::size_t size = serializeSizePrefixedTagged(entry, _specialEntryBuffer);
-  out.write(_specialEntryBuffer.data(), _specialEntryBuffer.ssize());
+  buffer.clear();
+  const std::size_t size = serializeSizePrefixedTagged(entry, buffer);
+  out.write(buffer.data(), buffer.ssize());
   return size;
 }
 
+template <typename OutputStream>
+std::size_t Session::consumeData(WriterProp& writerProp, const detail::QueueReader::ReadResult& data, OutputStream& out)
+{
+  if (data.size() == 0) { return 0; }
+
+  // strings logged by address must precede the events referring to them
+  std::size_t result = _literals.consume(data, out, hasInternedStrings());
+
+  result += writeData(writerProp, data, _clockDeltaEncoding, _batchBuffer, _specialEntryBuffer, out);
+  return result;
+}
+
+template <typename OutputStream>
+std::size_t Session::writeData(
+  WriterProp& writerProp, const detail::QueueReader::ReadResult& data, bool clockDeltaEncoding,
+  detail::VectorOutputStream& batchBuffer, detail::VectorOutputStream& specialEntryBuffer,
+  OutputStream& out
+)
+{
+  std::size_t result = 0;
+
+  if (clockDeltaEncoding)
+  {
+    encodeEventBatch(data, batchBuffer);
+
+    // consume writerProp entry
+    writerProp.batchSize = batchBuffer.vector.size();
+    result += consumeSpecialEntry(writerProp, specialEntryBuffer, out);
+
+    // consume encoded queue data
+    out.write(batchBuffer.data(), batchBuffer.ssize());
+    result += batchBuffer.vector.size();
+  }
+  else
+  {
+    // consume writerProp entry
+    writerProp.batchSize = data.size();
+    result += consumeSpecialEntry(writerProp, specialEntryBuffer, out);
+
+    // consume queue data
+    out.write(data.buffer1, std::streamsize(data.size1));
+    if (data.size2)
+    {
+      // data wraps around the end of the queue, consume the second half as well
+      out.write(data.buffer2, std::streamsize(data.size2));
+    }
+    result += data.size();
+  }
+
+  return result;
+}
+
+inline void Session::addChannel(std::shared_ptr<Channel> channel)
+{
+  const auto pos = (channel->priority)
+    ? std::find_if(_channels.begin(), _channels.end(), [](const std::shared_ptr<Channel>& ch) { return ! ch->priority; })
+    : _channels.end();
+  _channels.insert(pos, std::move(channel));
+}
+
+inline bool Session::isPollable(const Channel& channel)
+{
+  // pendingRead: data not yet released by endConsume.
+  // predecessor: the channel it replaces might still have older events of the same writer.
+  return ! channel.pendingRead && channel.predecessor.expired();
+}
+
+inline void Session::endPoll(std::shared_ptr<Channel>& channelptr, bool isClosed, std::size_t usage, ConsumeResult& result)
+{
+  if (_minQueueCapacity != 0 && ! isClosed)
+  {
+    adaptChannelSize(channelptr, channelptr->queue().capacity, usage);
+  }
+
+  if (isClosed)
+  {
+    // queue is empty and closed, remove it
+    channelptr.reset();
+    result.channelsRemoved++;
+  }
+
+  result.channelsPolled++;
+}
+
+inline void Session::updateChannels(ConsumeResult& result)
+{
+  _channels.erase(
+    std::remove_if(
+      _channels.begin(), _channels.end(),
+      [](const std::shared_ptr<Channel>& channelptr) { return !channelptr; }
+    ),
+    _channels.end()
+  );
+
+  // add replacements after the channels they replace
+  for (std::shared_ptr<Channel>& replacement : _replacementChannels)
+  {
+    addChannel(std::move(replacement));
+  }
+  _replacementChannels.clear();
+
+  _totalConsumedBytes += result.bytesConsumed;
+  result.totalBytesConsumed = _totalConsumedBytes;
+}
+
+inline void Session::adaptChannelSize(const std::shared_ptr<Channel>& channelptr, std::size_t capacity, std::size_t usage)
+{
+  Channel& ch = *channelptr;
+  if (ch.replacementOffered) { return; }
+
+  // the writer did not switch to this channel yet, it is empty:
+  // start the window when it is taken, otherwise a grown replacement would be found too large
+  if (ch.untaken.load(std::memory_order_acquire)) { return; }
+
+  ch.highWaterMark = (std::max)(ch.highWaterMark, usage);
+  ++ch.pollCount;
+
+  const bool tooSmall = usage > capacity / 2 && capacity < _maxQueueCapacity;
+  const bool windowEnd = ch.pollCount >= _sizingWindow;
+  const bool tooLarge = windowEnd && ch.highWaterMark < capacity / 16 && capacity > _minQueueCapacity;
+
+  if (tooSmall || tooLarge)
+  {
+    std::size_t newCapacity = _minQueueCapacity;
+    while (newCapacity < 4 * ch.highWaterMark && newCapacity < _maxQueueCapacity) { newCapacity *= 2; }
+    newCapacity = (std::min)(newCapacity, _maxQueueCapacity);
+
+    try
+    {
+      // Allocate the replacement here, so the writer does not have to.
+      // The replacement is co-owned by the old channel until the writer takes it:
+      // it is not closed, and not removed while empty.
+      WriterProp wp{ch.writerProp.id, ch.writerProp.name, 0};
+      _replacementChannels.push_back(std::make_shared<Channel>(*this, newCapacity, std::move(wp)));
+      _replacementChannels.back()->shardKey = ch.shardKey;
+      _replacementChannels.back()->priority = ch.priority;
+      _replacementChannels.back()->untaken.store(true, std::memory_order_relaxed);
+      _replacementChannels.back()->predecessor = channelptr;
+      ch.replacement = _replacementChannels.back();
+      ch.replacementOffered = true;
+      ch.hasReplacement.store(true, std::memory_order_release);
+    }
+    catch (const std::bad_alloc&)
+    {
+      // try again at the end of the next window
+    }
+  }
+
+  if (windowEnd)
+  {
+    ch.highWaterMark = 0;
+    ch.pollCount = 0;
+  }
+}
+
+inline void Session::encodeEventBatch(const detail::QueueReader::ReadResult& data, detail::VectorOutputStream& out)
+{
+  // Use the clock of the first event as base, to make the first delta zero.
+  // The data might start with special entries (e.g: InternedString), skip those.
+  // Entries are never split between the two parts of `data`.
+  EventBatch batch;
+  if (! firstEventClock(Range(data.buffer1, data.size1), batch.clockBase))
+  {
+    firstEventClock(Range(data.buffer2, data.size2), batch.clockBase);
+  }
+
+  out.clear();
+  out.vector.reserve(sizeof(std::uint32_t) + sizeof(EventBatch::Tag) + sizeof(batch) + data.size());
+
+  // size is not known yet, written below
+  const std::uint32_t placeholderSize = 0;
+  const std::uint64_t tag = EventBatch::Tag;
+  mserialize::serialize(placeholderSize, out);
+  mserialize::serialize(tag, out);
+  mserialize::serialize(batch, out);
+
+  encodeClockDeltas(Range(data.buffer1, data.size1), batch.clockBase, out);
+  encodeClockDeltas(Range(data.buffer2, data.size2), batch.clockBase, out);
+
+  const std::uint32_t size = std::uint32_t(out.vector.size() - sizeof(size));
+  memcpy(out.vector.data(), &size, sizeof(size));
+}
+
+inline bool Session::firstEventClock(Range entries, std::uint64_t& clock)
+{
+  while (! entries.empty())
+  {
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range payload(entries.view(size), size);
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+    if ((tag & (std::uint64_t(1) << 63)) == 0) // not a special entry
+    {
+      clock = payload.read<std::uint64_t>();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline void Session::encodeClockDeltas(Range entries, std::uint64_t clockBase, detail::VectorOutputStream& out)
+{
+  while (! entries.empty())
+  {
+    const std::uint32_t size = entries.read<std::uint32_t>();
+    Range payload(entries.view(size), size);
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+    const bool special = (tag & (std::uint64_t(1) << 63)) != 0;
+
+    if (special)
+    {
+      // not an event, no clock to encode: copy as is
+      mserialize::serialize(size, out);
+      mserialize::serialize(tag, out);
+    }
+    else
+    {
+      const std::uint64_t clockValue = payload.read<std::uint64_t>();
+      const std::uint64_t delta = mserialize::detail::zigzag_encode(std::int64_t(clockValue - clockBase));
+
+      char buffer[mserialize::detail::max_varint_size];
+      const char* bufferEnd = mserialize::detail::write_varint(delta, buffer);
+      const std::size_t deltaSize = std::size_t(bufferEnd - buffer);
+
+      const std::uint32_t newSize = std::uint32_t(sizeof(tag) + deltaSize + payload.size());
+      mserialize::serialize(newSize, out);
+      mserialize::serialize(tag, out);
+      out.write(buffer, std::streamsize(deltaSize));
+    }
+
+    const std::size_t restSize = payload.size();
+    out.write(payload.view(restSize), std::streamsize(restSize));
+  }
+}
+
 } // namespace binlog
 
 #endif // BINLOG_SESSION_HPP
@@ -1,15 +1,23 @@
 #ifndef BINLOG_SESSION_WRITER_HPP
 #define BINLOG_SESSION_WRITER_HPP
 
+#include <binlog/Interned.hpp>
 #include <binlog/Session.hpp>
+#include <binlog/Severity.hpp>
+#include <binlog/detail/InternCache.hpp>
 #include <binlog/detail/QueueWriter.hpp>
+#include <binlog/detail/SharedQueue.hpp>
 
+#include <mserialize/detail/type_traits.hpp>
 #include <mserialize/serialize.hpp>
 
 #include <algorithm> // max
 #include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy
 #include <memory> // shared_ptr
-#include <utility> // move
+#include <type_traits>
+#include <utility> // forward, move, swap
 
 namespace binlog {
 
@@ -29,12 +37,49 @@ public:
    *
    * Creates a session channel internally.
    *
-   * @param queueCapacity capacity in bytes of the channels queue
+   * @param queueCapacity capacity in bytes of the channels queue,
+   *        ignored if the session has adaptive channel sizing enabled,
+   *        see Session::initialQueueCapacity
    * @param id see setId
    * @param name see setName
    */
   explicit SessionWriter(Session& session, std::size_t queueCapacity = 1 << 20, std::uint64_t id = {}, std::string name = {});
 
+  /**
+   * Construct a SessionWriter attached to `session`,
+   * which writes the shared queue of the session (see Session::sharedQueue),
+   * instead of creating a channel of its own.
+   *
+   * This is useful for short lived or rarely writing threads:
+   * they do not allocate a channel, and do not make the
+   * list of channels polled by Session::consume longer.
+   * Writing the shared queue is slower than writing a channel,
+   * as writers contend on the shared reserve index.
+   *
+   * Once the writer added more than `upgradeThreshold` bytes,
+   * or the shared queue is full, it creates a channel
+   * with a queue of `queueCapacity` bytes, and uses that
+   * for the rest of its life, as any other writer.
+   *
+   * Events added to the shared queue are consumed without
+   * the id and name of the writer, see setId and setName.
+   * Events added by a single writer before and after the upgrade
+   * might be consumed out of order, if the shared queue
+   * has an uncommitted event of an other writer when consumed.
+   *
+   * @param upgradeThreshold number of bytes added to the shared queue, before creating a channel
+   * @param queueCapacity capacity in bytes of the channel created by the upgrade
+   * @param id see setId
+   * @param name see setName
+   */
+  static SessionWriter shared(
+    Session& session,
+    std::size_t upgradeThreshold = 1 << 16,
+    std::size_t queueCapacity = 1 << 20,
+    std::uint64_t id = {},
+    std::string name = {}
+  );
+
   /** Marks the underlying channel closed. */
   ~SessionWriter() = default;
 
@@ -58,6 +103,8 @@ public:
    * this writer only, including events already produced but
    * not yet consumed, and yet to be consumed events.
    * Does not affect already consumed events.
+   * Writers of the shared queue (see `shared`) store
+   * the id, and use it once they create a channel.
    *
    * Can be called concurrently with other
    * writer and session methods (most notably: consume)
@@ -74,28 +121,94 @@ public:
    * this writer only, including events already produced but
    * not yet consumed, and yet to be consumed events.
    * Does not affect already consumed events.
+   * Writers of the shared queue (see `shared`) store
+   * the name, and use it once they create a channel.
    *
    * Can be called concurrently with other
    * writer and session methods (most notably: consume)
    */
   void setName(std::string name);
 
+  /**
+   * Write arguments (e.g: strings, containers of arithmetic values)
+   * of at least `threshold` bytes by non-temporal stores,
+   * which bypass the cache of the writer thread, if available (x86 SSE2).
+   *
+   * Logging large payloads (e.g: packet dumps) this way does not evict the working
+   * set of the writer thread from the cache, at the cost of a slower copy
+   * and a store fence per event. Does not affect events added to the shared queue.
+   * Disabled by default, use detail::QueueWriter::noStreaming to disable.
+   */
+  void setStreamingThreshold(std::size_t threshold);
+
+  /**
+   * Create a priority lane: a second channel, with a queue of `queueCapacity` bytes,
+   * for the events of sources with severity `threshold` or above.
+   *
+   * Priority channels are consumed before other channels (see Session::createChannel),
+   * therefore events added to the priority lane do not wait behind a flood
+   * of less important events, and do not compete with them for queue space.
+   * Events of the two lanes might be consumed out of order,
+   * sort them by time to restore the order (e.g: `bread -s`).
+   *
+   * Only events added with their severity go to the priority lane,
+   * see addEvent. The log macros always pass the severity.
+   * If the writer already has a priority lane, it is replaced:
+   * the old lane is closed.
+   *
+   * @throws std::bad_alloc if the channel cannot be created
+   */
+  void setPriorityLane(Severity threshold, std::size_t queueCapacity = 1 << 14);
+
+  /**
+   * Open a new span of this writer, nested into the current span, if any.
+   *
+   * Spans of a writer must be closed in the reverse order of opening.
+   *
+   * @param parent set to the id of the current span, or zero, if there's none
+   * @returns the id of the new span, unique for this writer,
+   *          which becomes the current span.
+   * @see BINLOG_SPAN
+   */
+  std::uint64_t openSpan(std::uint64_t& parent) noexcept
+  {
+    parent = _currentSpanId;
+    _currentSpanId = _nextSpanId++;
+    return _currentSpanId;
+  }
+
+  /** Make `parent` the current span again, see openSpan */
+  void closeSpan(std::uint64_t parent) noexcept { _currentSpanId = parent; }
+
   /**
    * Add a log event to the queue of the underlying channel.
    *
-   * First, it computes the serialized size of the event,
-   * then allocates memory in the queue, then
-   * serializes the event, and finally commits the write.
+   * If every argument is arithmetic or enum, first it computes
+   * the serialized size of the event, then allocates memory in the queue,
+   * then serializes the event, and finally commits the write.
    *
-   * As size is computed separately from serialization,
-   * some getters of serializable types (e.g: which return a string)
-   * will be called twice. It is important to always
+   * Otherwise, to avoid traversing the arguments twice,
+   * the event is serialized directly into the contiguous free
+   * space of the queue, the size field is filled in afterwards,
+   * then the write is committed. If the event does not fit in the
+   * free space, the size is computed separately, as above.
+   *
+   * In the latter case, some getters of serializable types (e.g: which return a string)
+   * will be called more than once. It is important to always
    * return the same value during a single log call,
    * otherwise undefined behaviour might be invoked.
    *
    * If the queue is full (it has not enough space for the event),
-   * a new channel is created, suitable to hold this event,
-   * and the old one is closed.
+   * and the session offered a replacement channel
+   * (see Session::setAdaptiveChannelSizing), the writer switches to that.
+   * Otherwise, or if the replacement is too small, a new channel is created,
+   * suitable to hold this event, and the old one is closed.
+   *
+   * binlog::interned arguments are looked up in a cache of recently
+   * seen strings. If found, only the id of the string is serialized.
+   * Otherwise, an InternedString entry is added first, with the id of
+   * the cache slot of the string (evicting the string in the slot),
+   * or a new id, if the slot has none.
    *
    * @pre `eventSourceId` must be the id of an event source added to `session()`,
    *      see Session::addEventSource.
@@ -112,35 +225,266 @@ public:
   template <typename... Args>
   bool addEvent(std::uint64_t eventSourceId, std::uint64_t clock, Args&&... args) noexcept;
 
+  /**
+   * Same as above, but if the writer has a priority lane (see setPriorityLane),
+   * and `severity` reaches its threshold, the event is added to the priority lane.
+   *
+   * @param severity the severity of the event source identified by `eventSourceId`
+   */
+  template <typename... Args>
+  bool addEvent(Severity severity, std::uint64_t eventSourceId, std::uint64_t clock, Args&&... args) noexcept;
+
 private:
+  SessionWriter(Session& session, detail::SharedQueue& sharedQueue, std::size_t upgradeThreshold, std::size_t queueCapacity, WriterProp writerProp);
+
+  template <typename... Args>
+  bool addEventImpl(std::true_type /* trivial size */, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept;
+
+  template <typename... Args>
+  bool addEventImpl(std::false_type /* trivial size */, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept;
+
+  template <typename... Args>
+  bool addEventSinglePass(std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept;
+
+  template <typename... Args>
+  bool addEventTwoPass(std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept;
+
+  template <typename... Args>
+  bool addEventShared(std::size_t size, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept;
+
+  template <typename OutputStream, typename... Args>
+  static void serializeEvent(OutputStream& out, std::size_t size, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args);
+
+  template <typename T>
+  static const T& internArgument(const T& arg) noexcept { return arg; }
+
+  /** @returns `arg` with its id set, see addEvent */
+  interned internArgument(const interned& arg) noexcept;
+
+  bool takeReplacementChannel() noexcept;
+
   bool replaceChannel(std::size_t minQueueCapacity) noexcept;
 
+  /** Make the priority lane the current lane, or switch back */
+  void swapPriorityLane() noexcept;
+
+  /** State of the lane not used by the current event, see setPriorityLane */
+  struct Lane
+  {
+    std::shared_ptr<Session::Channel> channel;
+    detail::QueueWriter qw;
+    detail::SharedQueue* sharedQueue;
+    std::unique_ptr<detail::InternCache> internCache; /**< Interned strings must precede events in the same lane */
+  };
+
   Session* _session;
   std::shared_ptr<Session::Channel> _channel;
   detail::QueueWriter _qw;
+
+  // Members below are used by writers of the shared queue only, until they create a channel
+  detail::SharedQueue* _sharedQueue = nullptr;
+  std::size_t _sharedBytesLeft = 0; /**< Number of bytes to add to the shared queue before creating a channel */
+  std::size_t _queueCapacity = 0;   /**< Queue capacity of the channel to create */
+  WriterProp _writerProp;           /**< Writer properties of the channel to create */
+
+  std::unique_ptr<detail::InternCache> _internCache; /**< Created by the first binlog::interned argument */
+
+  std::uint64_t _nextSpanId = 1;
+  std::uint64_t _currentSpanId = 0; /**< Zero if no span is open */
+
+  std::unique_ptr<Lane> _priorityLane;      /**< Created by setPriorityLane */
+  Severity _priorityThreshold = Severity::no_logs;
 };
 
+namespace detail {
+
+/**
+ * A queue of zero capacity, that is never written.
+ *
+ * Writers of the shared queue write this queue
+ * until they create a channel: every write fails,
+ * and takes the slow path, without checking for
+ * the shared queue on the fast path.
+ */
+inline Queue& emptyQueue()
+{
+  static Queue s_queue(nullptr, 0);
+  return s_queue;
+}
+
+} // namespace detail
+
 inline SessionWriter::SessionWriter(Session& session, std::size_t queueCapacity, std::uint64_t id, std::string name)
   :_session(& session),
-   _channel(session.createChannel(queueCapacity)),
+   _channel(session.createChannel(session.initialQueueCapacity(queueCapacity))),
    _qw(_channel->queue())
 {
   if (id != 0) { setId(id); }
   if (! name.empty()) { setName(std::move(name)); }
 }
 
+inline SessionWriter::SessionWriter(Session& session, detail::SharedQueue& sharedQueue, std::size_t upgradeThreshold, std::size_t queueCapacity, WriterProp writerProp)
+  :_session(& session),
+   _qw(detail::emptyQueue()),
+   _sharedQueue(& sharedQueue),
+   _sharedBytesLeft(upgradeThreshold),
+   _queueCapacity(queueCapacity),
+   _writerProp(std::move(writerProp))
+{}
+
+inline SessionWriter SessionWriter::shared(Session& session, std::size_t upgradeThreshold, std::size_t queueCapacity, std::uint64_t id, std::string name)
+{
+  return SessionWriter(session, session.sharedQueue(), upgradeThreshold, queueCapacity, WriterProp{id, std::move(name), 0});
+}
+
 inline void SessionWriter::setId(std::uint64_t id)
 {
-  _session->setChannelWriterId(*_channel, id);
+  if (_priorityLane)
+  {
+    _session->setChannelWriterId(*_priorityLane->channel, id);
+  }
+
+  if (_channel)
+  {
+    _session->setChannelWriterId(*_channel, id);
+  }
+  else
+  {
+    _writerProp.id = id;
+  }
 }
 
 inline void SessionWriter::setName(std::string name)
 {
-  _session->setChannelWriterName(*_channel, std::move(name));
+  if (_priorityLane)
+  {
+    _session->setChannelWriterName(*_priorityLane->channel, name);
+  }
+
+  if (_channel)
+  {
+    _session->setChannelWriterName(*_channel, std::move(name));
+  }
+  else
+  {
+    _writerProp.name = std::move(name);
+  }
+}
+
+inline void SessionWriter::setStreamingThreshold(std::size_t threshold)
+{
+  _qw.setStreamingThreshold(threshold);
+  if (_priorityLane) { _priorityLane->qw.setStreamingThreshold(threshold); }
 }
 
+inline void SessionWriter::setPriorityLane(Severity threshold, std::size_t queueCapacity)
+{
+  WriterProp wp = (_channel)
+    ? WriterProp{_channel->writerProp.id, _channel->writerProp.name, 0} // avoid racing on the last field
+    : _writerProp;
+  std::shared_ptr<Session::Channel> channel = _session->createChannel(queueCapacity, std::move(wp), true);
+  detail::QueueWriter qw(channel->queue(), _qw.streamingThreshold());
+
+  _priorityLane.reset(new Lane{std::move(channel), qw, nullptr, nullptr});
+  _priorityThreshold = threshold;
+}
+
+namespace detail {
+
+// The serialized size of arithmetic and enum values
+// does not depend on the value, computing it is free.
+template <typename T>
+using has_trivial_serialized_size = std::integral_constant<bool,
+  std::is_arithmetic<T>::value || std::is_enum<T>::value
+>;
+
+} // namespace detail
+
 template <typename... Args>
 bool SessionWriter::addEvent(std::uint64_t eventSourceId, std::uint64_t clock, Args&&... args) noexcept
+{
+  using TrivialSize = mserialize::detail::conjunction<
+    detail::has_trivial_serialized_size<mserialize::detail::remove_cvref_t<Args>>...
+  >;
+
+  return addEventImpl(TrivialSize{}, eventSourceId, clock, internArgument(args)...);
+}
+
+template <typename... Args>
+bool SessionWriter::addEvent(Severity severity, std::uint64_t eventSourceId, std::uint64_t clock, Args&&... args) noexcept
+{
+  if (_priorityLane && severity >= _priorityThreshold)
+  {
+    swapPriorityLane();
+    const bool result = addEvent(eventSourceId, clock, std::forward<Args>(args)...);
+    swapPriorityLane();
+    return result;
+  }
+
+  return addEvent(eventSourceId, clock, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+bool SessionWriter::addEventImpl(std::true_type /* trivial size */, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept
+{
+  return addEventTwoPass(eventSourceId, clock, args...);
+}
+
+template <typename... Args>
+bool SessionWriter::addEventImpl(std::false_type /* trivial size */, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept
+{
+  return addEventSinglePass(eventSourceId, clock, args...)
+      || addEventTwoPass(eventSourceId, clock, args...);
+}
+
+template <typename... Args>
+bool SessionWriter::addEventSinglePass(std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept
+{
+  const std::size_t headerSize = sizeof(std::uint32_t) + sizeof(eventSourceId) + sizeof(clock);
+
+  // First try the current write buffer, then the largest one available.
+  // If the event does not fit in either, give up: the caller
+  // falls back to computing the size upfront, and possibly replacing the channel.
+  std::size_t capacity = _qw.writeCapacity();
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    if (attempt != 0)
+    {
+      // drop the partially written event, find more space
+      takeReplacementChannel();
+      const std::size_t maxCapacity = _qw.maximizeWriteCapacity();
+      if (maxCapacity <= capacity) { break; }
+      capacity = maxCapacity;
+    }
+
+    if (capacity < headerSize) { continue; }
+
+    // reserve the size field, to be filled in later
+    const std::uint32_t sizePlaceholder = 0;
+    void* sizeField = _qw.writeBuffer(&sizePlaceholder, sizeof(sizePlaceholder));
+    mserialize::serialize(eventSourceId, _qw);
+    mserialize::serialize(clock, _qw);
+
+    detail::BoundedQueueWriter out(_qw);
+    using swallow = int[];
+    (void)swallow{1, (mserialize::serialize(args, out), int{})...};
+
+    if (! out.overflow())
+    {
+      // backpatch size (excludes size field)
+      const std::uint32_t size = std::uint32_t(capacity - _qw.writeCapacity() - sizeof(std::uint32_t));
+      memcpy(sizeField, &size, sizeof(size));
+
+      _qw.endWrite();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+template <typename... Args>
+bool SessionWriter::addEventTwoPass(std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept
 {
   // compute size (excludes size field)
   std::size_t size = 0;
@@ -149,35 +493,121 @@ bool SessionWriter::addEvent(std::uint64_t eventSourceId, std::uint64_t clock, A
 
   // allocate space (totalSize includes size field)
   const std::size_t totalSize = size + sizeof(std::uint32_t);
+  if (totalSize > _qw.writeCapacity()) { takeReplacementChannel(); }
   if (! _qw.beginWrite(totalSize))
   {
+    if (_sharedQueue != nullptr && addEventShared(size, eventSourceId, clock, args...))
+    {
+      return true;
+    }
+
     // not enough space in queue, create a new channel
     replaceChannel(totalSize);
     if (! _qw.beginWrite(totalSize)) { return false; }
   }
 
-  // serialize fields
+  serializeEvent(_qw, size, eventSourceId, clock, args...);
+
+  _qw.endWrite();
+  return true;
+}
+
+template <typename... Args>
+bool SessionWriter::addEventShared(std::size_t size, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args) noexcept
+{
+  const std::size_t totalSize = size + sizeof(std::uint32_t);
+  if (totalSize > _sharedBytesLeft) { return false; } // time to upgrade
+
+  detail::SharedQueueWriter sw(*_sharedQueue);
+  if (! sw.beginWrite(totalSize)) { return false; }
+
+  serializeEvent(sw, size, eventSourceId, clock, args...);
+
+  sw.endWrite();
+  _sharedBytesLeft -= totalSize;
+  return true;
+}
+
+template <typename OutputStream, typename... Args>
+void SessionWriter::serializeEvent(OutputStream& out, std::size_t size, std::uint64_t eventSourceId, std::uint64_t clock, const Args&... args)
+{
   using swallow = int[];
   (void)swallow{
-    (mserialize::serialize(std::uint32_t(size), _qw), int{}),
-    (mserialize::serialize(eventSourceId, _qw), int{}),
-    (mserialize::serialize(clock, _qw), int{}),
-    (mserialize::serialize(args, _qw), int{})...
+    (mserialize::serialize(std::uint32_t(size), out), int{}),
+    (mserialize::serialize(eventSourceId, out), int{}),
+    (mserialize::serialize(clock, out), int{}),
+    (mserialize::serialize(args, out), int{})...
   };
+}
 
-  _qw.endWrite();
+inline interned SessionWriter::internArgument(const interned& arg) noexcept
+{
+  interned result = arg;
+
+  try
+  {
+    if (! _internCache) { _internCache.reset(new detail::InternCache()); }
+
+    // After log rotation, the new output gets the strings already written
+    // from the session, see Session::reconsumeMetadata
+    detail::InternCache::Slot& slot = _internCache->slot(arg.value);
+    if (slot.id == 0 || mserialize::string_view(slot.value) != arg.value)
+    {
+      // reuse the id of the evicted string: events already queued
+      // are read before the new InternedString entry that overwrites it
+      slot.value.assign(arg.value.data(), arg.value.size());
+      if (slot.id == 0) { slot.id = _session->newInternedStringId(); }
+
+      // the InternedString entry has the layout of an event:
+      // the tag takes the place of the source id, the id takes the place of the clock.
+      if (! addEventTwoPass(InternedString::Tag, slot.id, slot.value))
+      {
+        slot.id = 0;
+      }
+    }
+
+    result.id = slot.id;
+  }
+  catch (...)
+  {
+    // allocation failed, the event refers to no string (id=0)
+  }
+
+  return result;
+}
+
+inline bool SessionWriter::takeReplacementChannel() noexcept
+{
+  if (! _channel) { return false; } // writer of the shared queue
+
+  std::shared_ptr<Session::Channel> replacement = _channel->takeReplacement();
+  if (! replacement) { return false; }
+
+  // the old channel is closed, and removed by the session once consumed
+  _channel = std::move(replacement);
+  _qw = detail::QueueWriter(_channel->queue(), _qw.streamingThreshold());
   return true;
 }
 
 inline bool SessionWriter::replaceChannel(std::size_t minQueueCapacity) noexcept
 {
-  const std::size_t newCapacity = (std::max)(_qw.capacity(), 2 * minQueueCapacity);
-
   try
   {
-    WriterProp wp{_channel->writerProp.id, _channel->writerProp.name, 0}; // avoid racing on the last field
-    _channel = _session->createChannel(newCapacity, std::move(wp));
-    _qw = detail::QueueWriter(_channel->queue());
+    // writers of the shared queue do not have a channel yet
+    const std::size_t capacity = (_sharedQueue != nullptr) ? _session->initialQueueCapacity(_queueCapacity) : _qw.capacity();
+    const std::size_t newCapacity = (std::max)(capacity, 2 * minQueueCapacity);
+
+    WriterProp wp = (_sharedQueue != nullptr)
+      ? _writerProp
+      : WriterProp{_channel->writerProp.id, _channel->writerProp.name, 0}; // avoid racing on the last field
+    const bool priority = _channel && _channel->priority;
+    _channel = _session->createChannel(newCapacity, std::move(wp), priority, _channel);
+    _qw = detail::QueueWriter(_channel->queue(), _qw.streamingThreshold());
+    _sharedQueue = nullptr;
+
+    // the new channel might be consumed by a different shard (see Session::consumeShard),
+    // whose output does not have the strings already written
+    if (_internCache) { _internCache->clear(); }
   }
   catch (...)
   {
@@ -190,6 +620,15 @@ inline bool SessionWriter::replaceChannel(std::size_t minQueueCapacity) noexcept
   return true;
 }
 
+inline void SessionWriter::swapPriorityLane() noexcept
+{
+  using std::swap;
+  swap(_channel, _priorityLane->channel);
+  swap(_qw, _priorityLane->qw);
+  swap(_sharedQueue, _priorityLane->sharedQueue);
+  swap(_internCache, _priorityLane->internCache);
+}
+
 } // namespace binlog
 
 #endif // BINLOG_SESSION_WRITER_HPP
@@ -20,7 +20,7 @@ TextOutputStream& TextOutputStream::write(const char* data, std::streamsize size
 
   while (const Event* event = _eventStream.nextEvent(entryStream))
   {
-    _printer.printEvent(_out, *event, _eventStream.writerProp(), _eventStream.clockSync());
+    _printer.printEvent(_out, *event, _eventStream);
   }
 
   return *this;
@@ -0,0 +1,145 @@
+#include <binlog/UnixSocketOutputStream.hpp>
+
+#include <cerrno>
+#include <cstring> // memcpy
+#include <utility> // move
+
+#include <fcntl.h> // NOLINT
+#include <sys/socket.h> // NOLINT
+#include <sys/un.h> // NOLINT sockaddr_un
+#include <unistd.h> // NOLINT close
+
+namespace binlog {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+  constexpr int sendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+  constexpr int sendFlags = MSG_DONTWAIT; // SO_NOSIGPIPE is set instead
+#endif
+
+} // namespace
+
+UnixSocketOutputStream::UnixSocketOutputStream(std::string path, std::size_t bufferCapacity)
+  :_path(std::move(path)),
+   _capacity(bufferCapacity)
+{}
+
+UnixSocketOutputStream::~UnixSocketOutputStream()
+{
+  if (_fd >= 0)
+  {
+    flush();
+    ::close(_fd);
+  }
+}
+
+Session::ConsumeResult UnixSocketOutputStream::consume(Session& session)
+{
+  if (_lost)
+  {
+    // the collector missed some entries, make the rest readable
+    _lost = false;
+    session.reconsumeMetadata(*this);
+  }
+
+  const Session::ConsumeResult result = session.consume(*this);
+  flush();
+  return result;
+}
+
+UnixSocketOutputStream& UnixSocketOutputStream::write(const char* data, std::streamsize size)
+{
+  const std::size_t usize = std::size_t(size);
+
+  if (! _lost && _buffer.size() + usize > _capacity)
+  {
+    flush();
+  }
+
+  if (_lost || _buffer.size() + usize > _capacity)
+  {
+    // do not block the consumer: drop, until metadata is replayed
+    _lost = true;
+    _droppedBytes += usize;
+    return *this;
+  }
+
+  _buffer.insert(_buffer.end(), data, data + size);
+  return *this;
+}
+
+bool UnixSocketOutputStream::flush()
+{
+  if (_buffer.empty()) { return true; }
+  if (_fd < 0 && ! connect()) { return false; }
+
+  std::size_t sent = 0;
+  while (sent < _buffer.size())
+  {
+    const ssize_t n = ::send(_fd, _buffer.data() + sent, _buffer.size() - sent, sendFlags);
+    if (n < 0)
+    {
+      if (errno == EINTR) { continue; }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+
+      // connection lost
+      _buffer.erase(_buffer.begin(), _buffer.begin() + std::ptrdiff_t(sent));
+      disconnect();
+      return false;
+    }
+
+    sent += std::size_t(n);
+  }
+
+  _buffer.erase(_buffer.begin(), _buffer.begin() + std::ptrdiff_t(sent));
+  return _buffer.empty();
+}
+
+bool UnixSocketOutputStream::connect()
+{
+  sockaddr_un address{};
+  if (_path.size() >= sizeof(address.sun_path)) { return false; }
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, _path.data(), _path.size());
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) { return false; }
+
+  ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  #ifdef SO_NOSIGPIPE
+    const int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+  #endif
+
+  // connecting a UNIX domain socket does not wait for the peer to accept,
+  // fails with EAGAIN if the backlog of the collector is full
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  _fd = fd;
+  return true;
+}
+
+void UnixSocketOutputStream::disconnect()
+{
+  ::close(_fd);
+  _fd = -1;
+
+  // the collector starts a new stream with the next connection,
+  // the partially sent entry and the rest of the buffer are lost
+  if (! _buffer.empty())
+  {
+    _droppedBytes += _buffer.size();
+    _buffer.clear();
+  }
+  _lost = true;
+}
+
+} // namespace binlog
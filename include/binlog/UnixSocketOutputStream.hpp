@@ -0,0 +1,108 @@
+#ifndef BINLOG_UNIX_SOCKET_OUTPUT_STREAM_HPP
+#define BINLOG_UNIX_SOCKET_OUTPUT_STREAM_HPP
+
+#include <binlog/Session.hpp>
+
+#include <cstddef>
+#include <ios> // streamsize
+#include <string>
+#include <vector>
+
+namespace binlog {
+
+/**
+ * Stream binlog entries to a collector process (e.g: bcollect),
+ * over a UNIX domain stream socket. POSIX only.
+ *
+ * Models mserialize::OutputStream.
+ * Suitable to write data consumed from Session directly,
+ * preferably by `consume`, that also replays metadata if needed.
+ *
+ * Written data is buffered, and sent by `flush` in large,
+ * non-blocking writes. The buffer is bounded: if the collector
+ * is slow or not listening, and the buffer is full, further written data
+ * is dropped, instead of blocking the consumer (and the writers,
+ * whose queues are not consumed meanwhile).
+ *
+ * If data is dropped, or the connection is lost (the unsent part of
+ * the buffer is dropped as well), the collector misses metadata.
+ * Until `consume` replays the metadata (see Session::reconsumeMetadata),
+ * every write is dropped, to not send events without their sources.
+ * Each connection starts at an entry boundary.
+ */
+class UnixSocketOutputStream
+{
+public:
+  /**
+   * Will send data to the collector listening at `path`.
+   *
+   * Connection is attempted by `flush`, not by the constructor:
+   * it is not an error if the collector is not yet listening.
+   *
+   * @param bufferCapacity maximum number of bytes to buffer, until sent
+   */
+  explicit UnixSocketOutputStream(std::string path, std::size_t bufferCapacity = 1 << 24);
+
+  /** Try to send the buffered data (without blocking), then close the connection */
+  ~UnixSocketOutputStream();
+
+  UnixSocketOutputStream(const UnixSocketOutputStream&) = delete;
+  void operator=(const UnixSocketOutputStream&) = delete;
+
+  UnixSocketOutputStream(UnixSocketOutputStream&&) = delete;
+  void operator=(UnixSocketOutputStream&&) = delete;
+
+  /**
+   * Consume `session` to *this, then flush.
+   *
+   * If the collector missed data since the last call,
+   * the metadata of `session` is consumed again first.
+   *
+   * @returns the result of Session::consume
+   */
+  Session::ConsumeResult consume(Session& session);
+
+  /**
+   * Add the binlog entries in [data, data+size) to the buffer.
+   *
+   * If the buffer would exceed the capacity, `flush` is called first.
+   * If there is still not enough space, the data is dropped.
+   *
+   * The entries in the buffer must be complete,
+   * no partial entry is allowed.
+   */
+  UnixSocketOutputStream& write(const char* data, std::streamsize size);
+
+  /**
+   * Send as much of the buffered data as possible, without blocking.
+   *
+   * Connects to the collector, if not connected.
+   * If the connection is lost, the unsent data is dropped.
+   *
+   * @returns true if every buffered data is sent
+   */
+  bool flush();
+
+  /** @returns true if connected to the collector */
+  bool connected() const { return _fd >= 0; }
+
+  /** @returns the number of bytes dropped so far */
+  std::size_t droppedBytes() const { return _droppedBytes; }
+
+private:
+  bool connect();
+
+  /** Close the connection, drop the buffer */
+  void disconnect();
+
+  std::string _path;
+  std::size_t _capacity;
+  std::vector<char> _buffer; /**< Data not yet sent */
+  int _fd = -1;
+  bool _lost = false;        /**< True if the collector missed data, and metadata is not yet replayed */
+  std::size_t _droppedBytes = 0;
+};
+
+} // namespace binlog
+
+#endif // BINLOG_UNIX_SOCKET_OUTPUT_STREAM_HPP
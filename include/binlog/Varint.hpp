@@ -0,0 +1,104 @@
+#ifndef BINLOG_VARINT_HPP
+#define BINLOG_VARINT_HPP
+
+#include <mserialize/cx_string.hpp>
+#include <mserialize/detail/varint.hpp>
+#include <mserialize/serialize.hpp>
+#include <mserialize/tag.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <ios> // streamsize
+#include <type_traits>
+
+namespace binlog {
+
+template <typename Integer>
+class Varint
+{
+  static_assert(std::is_integral<Integer>::value, "Varint requires an integral type");
+  static_assert(sizeof(Integer) <= sizeof(std::uint64_t), "Varint supports at most 64 bit integers");
+
+public:
+  explicit Varint(Integer value) :_value(value) {}
+
+  Integer value() const { return _value; }
+
+private:
+  Integer _value;
+};
+
+/**
+ * Create a loggable wrapper of an integer,
+ * that is serialized using a variable length encoding.
+ *
+ * Useful if an integer of a wide type usually holds small values
+ * (e.g: ids, quantities, counters): instead of the fixed size
+ * of the type, values below 128 take a single byte,
+ * values below 16384 take two bytes, and so on.
+ * Signed integers are zigzag encoded first, so small
+ * negative values take a few bytes as well.
+ *
+ * Example:
+ *
+ *    std::uint64_t orderId = 123;
+ *    BINLOG_INFO("Order id: {}", binlog::varint(orderId));
+ *
+ * When read, unsigned values are visited as std::uint64_t,
+ * signed values are visited as std::int64_t.
+ */
+template <typename Integer>
+Varint<Integer> varint(Integer value)
+{
+  return Varint<Integer>(value);
+}
+
+} // namespace binlog
+
+namespace mserialize {
+
+template <typename Integer>
+struct CustomSerializer<binlog::Varint<Integer>>
+{
+  template <typename OutputStream>
+  static void serialize(const binlog::Varint<Integer> v, OutputStream& ostream)
+  {
+    char buffer[detail::max_varint_size];
+    const char* end = detail::write_varint(encode(v.value()), buffer);
+    ostream.write(buffer, std::streamsize(end - buffer));
+  }
+
+  static std::size_t serialized_size(const binlog::Varint<Integer> v)
+  {
+    return detail::varint_size(encode(v.value()));
+  }
+
+private:
+  static std::uint64_t encode(const Integer i)
+  {
+    return encode_impl(std::is_signed<Integer>{}, i);
+  }
+
+  static std::uint64_t encode_impl(std::true_type /* is_signed */, const Integer i)
+  {
+    return detail::zigzag_encode(std::int64_t(i));
+  }
+
+  static std::uint64_t encode_impl(std::false_type /* is_signed */, const Integer i)
+  {
+    return std::uint64_t(i);
+  }
+};
+
+template <typename Integer>
+struct CustomTag<binlog::Varint<Integer>>
+{
+  static constexpr auto tag_string()
+  {
+    return std::is_signed<Integer>::value ? make_cx_string("z") : make_cx_string("v");
+  }
+};
+
+} // namespace mserialize
+
+#endif // BINLOG_VARINT_HPP
@@ -2,9 +2,53 @@
 #define BINLOG_ADAPT_STDERRORCODE_HPP
 
 // Make std::error_code loggable by including this file
+//
+// The error code is serialized as the address of its category and its value.
+// The message is not computed by the producer: when the session consumes
+// an error code not seen before, it writes the message once,
+// as an ErrorCodeMessage entry. Therefore the category of the
+// logged error code must remain valid until the event is consumed
+// (true for the standard categories, e.g: std::system_category()).
 
-#include <binlog/adapt_struct.hpp>
+#include <mserialize/cx_string.hpp>
+#include <mserialize/serialize.hpp>
+#include <mserialize/tag.hpp>
 
-BINLOG_ADAPT_STRUCT(std::error_code, message)
+#include <cstdint>
+#include <cstring> // memcpy
+#include <system_error>
+
+namespace mserialize {
+
+template <>
+struct CustomSerializer<std::error_code>
+{
+  template <typename OutputStream>
+  static void serialize(const std::error_code& ec, OutputStream& ostream)
+  {
+    const std::error_category* category = &ec.category();
+    std::uint64_t address = 0;
+    memcpy(&address, &category, sizeof(category));
+
+    mserialize::serialize(address, ostream);
+    mserialize::serialize(std::int32_t(ec.value()), ostream);
+  }
+
+  static std::size_t serialized_size(const std::error_code&)
+  {
+    return sizeof(std::uint64_t) + sizeof(std::int32_t);
+  }
+};
+
+template <>
+struct CustomTag<std::error_code>
+{
+  static constexpr auto tag_string()
+  {
+    return make_cx_string("{std::error_code`category'L`value'i}");
+  }
+};
+
+} // namespace mserialize
 
 #endif // BINLOG_ADAPT_STDERRORCODE_HPP
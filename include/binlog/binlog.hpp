@@ -8,9 +8,13 @@
 
 #include <binlog/Address.hpp>
 #include <binlog/ArrayView.hpp>
+#include <binlog/Interned.hpp>
+#include <binlog/Literal.hpp>
+#include <binlog/Varint.hpp>
 #include <binlog/adapt_enum.hpp>
 #include <binlog/adapt_struct.hpp>
 #include <binlog/basic_log_macros.hpp>
 #include <binlog/const_char_ptr_is_string.hpp>
+#include <binlog/timer_macros.hpp>
 
 #endif // BINLOG_BINLOG_HPP
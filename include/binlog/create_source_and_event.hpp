@@ -36,33 +36,64 @@
  * TODO(benedek) perf: do not instantiate a full EventSource
  */
 #define BINLOG_CREATE_SOURCE_AND_EVENT(writer, severity, category, clock, /* format, */ ...) \
+  do {                                                                                       \
+    std::uint64_t _binlog_sid_v = 0;                                                         \
+    BINLOG_DETAIL_ADD_EVENT_SOURCE(_binlog_sid_v, writer, severity, category, "", "", __VA_ARGS__); \
+    binlog::detail::addEventIgnoreFirst(writer, severity, _binlog_sid_v, clock, __VA_ARGS__); \
+  } while (false)                                                                            \
+  /**/
+
+/**
+ * BINLOG_DETAIL_ADD_EVENT_SOURCE(sid, writer, severity, category, suffix, suffixTags, format, args...)
+ *
+ * Set `sid` to the id of the EventSource of the call site.
+ * When called for the first time, create the EventSource, and add it to
+ * the session of `writer`. The format string of the source is `format`
+ * followed by `suffix` (a string literal), its argument tags are the tags
+ * of `args` followed by `suffixTags` (a string literal).
+ *
+ * @see BINLOG_CREATE_SOURCE_AND_EVENT
+ */
+#define BINLOG_DETAIL_ADD_EVENT_SOURCE(sid, writer, severity, category, suffix, suffixTags, /* format, */ ...) \
   do {                                                                                       \
     static_assert(                                                                           \
       binlog::detail::count_placeholders(MSERIALIZE_FIRST(__VA_ARGS__))+1 ==                 \
       decltype(binlog::detail::count_arguments(__VA_ARGS__))::value,                         \
-      "Number of {} placeholders in format string must match number of arugments"            \
+      "Number of {} placeholders in format string must match number of arguments"            \
     );                                                                                       \
     static std::atomic<std::uint64_t> _binlog_sid{0};                                        \
-    std::uint64_t _binlog_sid_v = _binlog_sid.load(std::memory_order_relaxed);               \
-    if (_binlog_sid_v == 0)                                                                  \
+    sid = _binlog_sid.load(std::memory_order_relaxed);                                       \
+    if (sid == 0)                                                                            \
     {                                                                                        \
-      _binlog_sid_v = writer.session().addEventSource(binlog::EventSource{                   \
-        0, severity, #category, __func__, __FILE__, __LINE__, MSERIALIZE_FIRST(__VA_ARGS__), /* NOLINT */ \
-        binlog::detail::concatenated_tags(__VA_ARGS__).data()                                /* NOLINT */ \
+      sid = writer.session().addEventSource(binlog::EventSource{                             \
+        0, severity, #category, __func__, __FILE__, __LINE__,                                \
+        MSERIALIZE_FIRST(__VA_ARGS__) suffix, /* NOLINT */                                   \
+        mserialize::cx_strcat(                                                               \
+          binlog::detail::concatenated_tags(                                                 \
+            decltype(binlog::detail::argument_types(__VA_ARGS__)){}                          \
+          ),                                                                                 \
+          mserialize::make_cx_string(suffixTags)                                             \
+        ).data()                                                                             \
       });                                                                                    \
-      _binlog_sid.store(_binlog_sid_v);                                                      \
+      _binlog_sid.store(sid);                                                                \
     }                                                                                        \
-    binlog::detail::addEventIgnoreFirst(writer, _binlog_sid_v, clock, __VA_ARGS__);          \
   } while (false)                                                                            \
   /**/
 
 namespace binlog {
 namespace detail {
 
+template <typename... T>
+struct type_list {};
+
 // The first argument is dropped because __VA_ARGS__ cannot be empty,
 // therefore it is always combined with something unrelated.
+// Used in unevaluated context only, the arguments are not evaluated.
 template <typename Unused, typename... T>
-constexpr auto concatenated_tags(Unused&&, T&&...)
+type_list<T...> argument_types(Unused&&, T&&...);
+
+template <typename... T>
+constexpr auto concatenated_tags(type_list<T...>)
 {
   return mserialize::cx_strcat(mserialize::tag<T>()...);
 }
@@ -90,9 +121,9 @@ count_arguments(T&&...) { return {}; } // Implementation should be omitted but c
 // The first argument is dropped because __VA_ARGS__ cannot be empty,
 // therefore it is always combined with something unrelated.
 template <typename Writer, typename Unused, typename... T>
-void addEventIgnoreFirst(Writer& writer, std::uint64_t eventSourceId, std::uint64_t clock, Unused&&, T&&... t)
+void addEventIgnoreFirst(Writer& writer, Severity severity, std::uint64_t eventSourceId, std::uint64_t clock, Unused&&, T&&... t)
 {
-  writer.addEvent(eventSourceId, clock, std::forward<T>(t)...);
+  writer.addEvent(severity, eventSourceId, clock, std::forward<T>(t)...);
 }
 
 } // namespace detail
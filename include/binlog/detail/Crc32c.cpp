@@ -0,0 +1,83 @@
+#include <binlog/detail/Crc32c.hpp>
+
+#include <array>
+#include <cstring> // memcpy
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #define BINLOG_CRC32C_HAS_SSE42
+#endif
+
+namespace binlog {
+namespace detail {
+
+namespace {
+
+std::array<std::uint32_t, 256> makeCrc32cTable()
+{
+  std::array<std::uint32_t, 256> table{};
+  for (std::uint32_t i = 0; i < 256; ++i)
+  {
+    std::uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1); // reversed Castagnoli polynomial
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+std::uint32_t crc32cSoftware(const unsigned char* p, std::size_t size, std::uint32_t crc)
+{
+  static const std::array<std::uint32_t, 256> table = makeCrc32cTable();
+
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#ifdef BINLOG_CRC32C_HAS_SSE42
+
+__attribute__((target("sse4.2")))
+std::uint32_t crc32cSse42(const unsigned char* p, std::size_t size, std::uint32_t crc)
+{
+  std::uint64_t crc64 = crc;
+  for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t), p += sizeof(std::uint64_t))
+  {
+    std::uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc64 = __builtin_ia32_crc32di(crc64, word);
+  }
+
+  crc = static_cast<std::uint32_t>(crc64);
+  for (; size != 0; --size, ++p)
+  {
+    crc = __builtin_ia32_crc32qi(crc, *p);
+  }
+  return crc;
+}
+
+#endif // BINLOG_CRC32C_HAS_SSE42
+
+} // namespace
+
+std::uint32_t crc32c(const char* data, std::size_t size, std::uint32_t crc)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  crc = ~crc;
+
+  #ifdef BINLOG_CRC32C_HAS_SSE42
+    static const bool hasSse42 = __builtin_cpu_supports("sse4.2");
+    if (hasSse42)
+    {
+      return ~crc32cSse42(p, size, crc);
+    }
+  #endif
+
+  return ~crc32cSoftware(p, size, crc);
+}
+
+} // namespace detail
+} // namespace binlog
@@ -0,0 +1,24 @@
+#ifndef BINLOG_DETAIL_CRC32C_HPP
+#define BINLOG_DETAIL_CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace binlog {
+namespace detail {
+
+/**
+ * Compute the CRC-32C (Castagnoli) checksum of [data, data+size).
+ *
+ * To checksum discontiguous buffers, pass the result
+ * of the previous call as `crc`.
+ *
+ * Uses the SSE4.2 crc32 instruction if the CPU supports it
+ * (several GB/s), otherwise falls back to a table based implementation.
+ */
+std::uint32_t crc32c(const char* data, std::size_t size, std::uint32_t crc = 0);
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_DETAIL_CRC32C_HPP
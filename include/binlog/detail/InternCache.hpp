@@ -0,0 +1,62 @@
+#ifndef BINLOG_DETAIL_INTERN_CACHE_HPP
+#define BINLOG_DETAIL_INTERN_CACHE_HPP
+
+#include <mserialize/string_view.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace binlog {
+namespace detail {
+
+/**
+ * A small, direct mapped cache of strings and their ids.
+ *
+ * Used by SessionWriter to remember the binlog::interned
+ * strings it already wrote to its queue.
+ * Each string maps to a single slot, by hash:
+ * a string evicts the one in its slot, if any.
+ * The id of a slot is kept when its string is evicted,
+ * the new string is written with the same id:
+ * the number of ids (and strings kept by the session and the reader)
+ * is bounded by the number of slots, until the cache is cleared.
+ */
+class InternCache
+{
+public:
+  struct Slot
+  {
+    std::string value;
+    std::uint64_t id = 0; /**< Zero if the slot is empty, and has no id yet */
+  };
+
+  /** @returns the slot where `str` is or would be stored */
+  Slot& slot(mserialize::string_view str)
+  {
+    // FNV-1a
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (const char c : str)
+    {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3;
+    }
+
+    return _slots[std::size_t(hash % _slots.size())];
+  }
+
+  /** Empty every slot, and drop their ids */
+  void clear()
+  {
+    for (Slot& s : _slots) { s.id = 0; }
+  }
+
+private:
+  std::array<Slot, 256> _slots;
+};
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_DETAIL_INTERN_CACHE_HPP
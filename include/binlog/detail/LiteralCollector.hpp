@@ -0,0 +1,233 @@
+#ifndef BINLOG_DETAIL_LITERAL_COLLECTOR_HPP
+#define BINLOG_DETAIL_LITERAL_COLLECTOR_HPP
+
+#include <binlog/Entries.hpp>
+#include <binlog/Range.hpp>
+#include <binlog/detail/QueueReader.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <mserialize/Visitor.hpp>
+#include <mserialize/detail/tag_util.hpp>
+#include <mserialize/string_view.hpp>
+#include <mserialize/visit.hpp>
+
+#include <cstdint>
+#include <cstring> // memcpy
+#include <ios> // streamsize
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility> // pair
+
+namespace binlog {
+namespace detail {
+
+/**
+ * Find the binlog::literal and std::error_code arguments of events,
+ * and make LiteralString and ErrorCodeMessage entries of the not yet seen ones.
+ * Also keep the InternedString entries added by writers,
+ * the last one of each id, to write them again by `reconsume`.
+ *
+ * Used by Session on the consumer side: only events
+ * of sources added by `addEventSource`, that have
+ * a binlog::literal or std::error_code argument, are visited.
+ *
+ * Models the mserialize::Visitor concept.
+ */
+class LiteralCollector
+{
+public:
+  /** If `eventSource` has a binlog::literal or std::error_code argument, visit its events */
+  void addEventSource(const EventSource& eventSource)
+  {
+    const std::string& tags = eventSource.argumentTags;
+    if (tags.find("{binlog::literal`value'L}") != std::string::npos
+     || tags.find("{std::error_code`category'L`value'i}") != std::string::npos)
+    {
+      _sources.emplace(eventSource.id, eventSource.argumentTags);
+    }
+  }
+
+  /** @returns a collector visiting the events of the same sources as *this, with no entries created */
+  LiteralCollector withSameSources() const
+  {
+    LiteralCollector result;
+    result._sources = _sources;
+    return result;
+  }
+
+  /**
+   * Write a LiteralString entry to `out` for each
+   * binlog::literal argument of the events in `data`,
+   * whose address is not seen before, and an ErrorCodeMessage
+   * entry for each std::error_code argument not seen before.
+   * If `hasInternedStrings`, keep the InternedString entries of `data`.
+   *
+   * @returns the number of bytes written to `out`
+   */
+  template <typename OutputStream>
+  std::size_t consume(const QueueReader::ReadResult& data, OutputStream& out, bool hasInternedStrings)
+  {
+    if (_sources.empty() && ! hasInternedStrings) { return 0; }
+
+    const std::size_t begin = _entries.vector.size();
+    collect(Range(data.buffer1, data.size1));
+    collect(Range(data.buffer2, data.size2));
+
+    const std::size_t size = _entries.vector.size() - begin;
+    if (size != 0)
+    {
+      out.write(_entries.data() + begin, std::streamsize(size));
+    }
+    return size;
+  }
+
+  /**
+   * Write every entry created so far to `out`,
+   * and the last kept InternedString entry of each id.
+   *
+   * @returns the number of bytes written to `out`
+   */
+  template <typename OutputStream>
+  std::size_t reconsume(OutputStream& out)
+  {
+    std::size_t result = _entries.vector.size();
+    out.write(_entries.data(), _entries.ssize());
+
+    for (const auto& idAndEntry : _internedStrings)
+    {
+      const std::string& entry = idAndEntry.second;
+      out.write(entry.data(), std::streamsize(entry.size()));
+      result += entry.size();
+    }
+
+    return result;
+  }
+
+  // Visitor interface: find binlog::literal and std::error_code structures, ignore the rest
+
+  template <typename T>
+  void visit(T) {}
+
+  template <typename T>
+  bool visit(T, Range&) { return false; }
+
+  bool visit(mserialize::Visitor::SequenceBegin sb, Range& input)
+  {
+    // skip sequences of arithmetic values (e.g: strings) without visiting each element
+    const std::size_t elemSize = (sb.tag.size() == 1) ? arithmeticSize(sb.tag[0]) : 0;
+    if (elemSize == 0) { return false; }
+
+    input.view(sb.size * elemSize);
+    return true;
+  }
+
+  bool visit(mserialize::Visitor::StructBegin sb, Range& input)
+  {
+    if (sb.name == "binlog::literal" && sb.tag == "`value'L")
+    {
+      const std::uint64_t address = input.read<std::uint64_t>();
+      if (_addresses.insert(address).second)
+      {
+        addLiteralString(address);
+      }
+      return true;
+    }
+
+    if (sb.name == "std::error_code" && sb.tag == "`category'L`value'i")
+    {
+      const std::uint64_t category = input.read<std::uint64_t>();
+      const std::int32_t value = input.read<std::int32_t>();
+      if (_errorCodes.emplace(category, value).second)
+      {
+        addErrorCodeMessage(category, value);
+      }
+      return true;
+    }
+
+    return false;
+  }
+
+private:
+  void collect(Range entries)
+  {
+    while (! entries.empty())
+    {
+      const char* entry = entries.view(0);
+      const std::uint32_t size = entries.read<std::uint32_t>();
+      Range payload(entries.view(size), size);
+      const std::uint64_t sourceId = payload.read<std::uint64_t>();
+
+      if (sourceId == InternedString::Tag && payload.size() >= sizeof(std::uint64_t))
+      {
+        // writers reuse ids: keep the last string of each id
+        const std::uint64_t id = payload.read<std::uint64_t>();
+        _internedStrings[id].assign(entry, sizeof(size) + size);
+        continue;
+      }
+
+      const auto it = _sources.find(sourceId); // special entries are never found
+      if (it == _sources.end()) { continue; }
+
+      try
+      {
+        payload.read<std::uint64_t>(); // clock
+
+        mserialize::string_view tags = it->second;
+        for (mserialize::string_view tag = mserialize::detail::tag_pop(tags); ! tag.empty(); tag = mserialize::detail::tag_pop(tags))
+        {
+          mserialize::visit(tag, *this, payload);
+        }
+      }
+      catch (const std::runtime_error&)
+      {
+        // malformed event, let the reader deal with it
+      }
+    }
+  }
+
+  void addLiteralString(std::uint64_t address)
+  {
+    const char* str;
+    memcpy(&str, &address, sizeof(str));
+
+    // null is shown the same way as a null const char*
+    const LiteralString entry{address, (str != nullptr) ? str : "{null}"};
+    serializeSizePrefixedTagged(entry, _entries);
+  }
+
+  void addErrorCodeMessage(std::uint64_t address, std::int32_t value)
+  {
+    const std::error_category* category;
+    memcpy(&category, &address, sizeof(category));
+
+    const ErrorCodeMessage entry{address, value, category->message(int(value))};
+    serializeSizePrefixedTagged(entry, _entries);
+  }
+
+  static std::size_t arithmeticSize(char tag)
+  {
+    switch (tag)
+    {
+      case 'y': case 'c': case 'b': case 'B': return 1;
+      case 's': case 'S': return 2;
+      case 'i': case 'I': case 'f': return 4;
+      case 'l': case 'L': case 'd': return 8;
+      default: return 0;
+    }
+  }
+
+  std::unordered_map<std::uint64_t, std::string> _sources; /**< Argument tags of sources with literals, by id */
+  std::unordered_set<std::uint64_t> _addresses;            /**< Addresses already written as LiteralString */
+  std::set<std::pair<std::uint64_t, std::int32_t>> _errorCodes; /**< Error codes already written as ErrorCodeMessage */
+  VectorOutputStream _entries;                             /**< Every entry created */
+  std::unordered_map<std::uint64_t, std::string> _internedStrings; /**< Last InternedString entry of each id */
+};
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_DETAIL_LITERAL_COLLECTOR_HPP
@@ -3,27 +3,50 @@
 
 #include <binlog/detail/Queue.hpp>
 
+#include <algorithm> // min
 #include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <cstring> // memcpy
 #include <ios> // streamsize
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define BINLOG_QUEUE_WRITER_HAS_SSE2
+  #include <emmintrin.h>
+#endif
+
+// Keep the rarely taken streaming path out of the inlined writeBuffer
+#ifdef _MSC_VER
+  #define BINLOG_QUEUE_WRITER_NOINLINE __declspec(noinline)
+#else
+  #define BINLOG_QUEUE_WRITER_NOINLINE __attribute__((noinline))
+#endif
+
 namespace binlog {
 namespace detail {
 
 /**
  * @see Queue
  *
+ * Buffers of at least `streamingThreshold` bytes are written
+ * by non-temporal (streaming) stores, if available (x86 SSE2):
+ * large payloads (e.g: packet dumps) bypass the cache of the writer,
+ * and do not evict the working set of the application.
+ * Smaller buffers are copied by memcpy.
+ *
  * Models the mserialize::OutputStream concept
  */
 class QueueWriter
 {
 public:
-  explicit QueueWriter(Queue& q)
+  /** Value of `streamingThreshold` that disables streaming stores */
+  static constexpr std::size_t noStreaming = std::size_t(-1);
+
+  explicit QueueWriter(Queue& q, std::size_t streamingThreshold = noStreaming)
     :_queue(&q),
      _writePos(buffer()),
-     _writeEnd(buffer())
+     _writeEnd(buffer()),
+     _streamingThreshold(streamingThreshold)
   {}
 
   /** @returns the maximum number of bytes the queue can store */
@@ -75,7 +98,9 @@ public:
   {
     assert(_writePos + size <= _writeEnd);
 
-    void* result = memcpy(_writePos, src, size);
+    void* result = (size < _streamingThreshold)
+      ? memcpy(_writePos, src, size)
+      : streamingCopy(_writePos, src, size);
     _writePos += size;
     return result;
   }
@@ -89,11 +114,19 @@ public:
   /** Make the written parts of the internal buffer available to read. */
   void endWrite()
   {
+  #ifdef BINLOG_QUEUE_WRITER_HAS_SSE2
+    // streaming stores are weakly ordered, the release store below does not order them
+    if (_streamed)
+    {
+      _mm_sfence();
+      _streamed = false;
+    }
+  #endif
+
     const std::size_t newW = std::size_t(_writePos - buffer());
     _queue->writeIndex.store(newW, std::memory_order_release);
   }
 
-private:
   /**
    * Maximize writeCapacity() by selecting the largest contiguous writable arena.
    *
@@ -135,12 +168,91 @@ private:
     return writeCapacity();
   }
 
+  /** @returns the size of the smallest buffer written by streaming stores */
+  std::size_t streamingThreshold() const { return _streamingThreshold; }
+
+  /**
+   * Write buffers of at least `threshold` bytes by streaming stores.
+   *
+   * Use `noStreaming` to disable streaming stores (default).
+   */
+  void setStreamingThreshold(std::size_t threshold) { _streamingThreshold = threshold; }
+
+private:
   char* buffer() { return _queue->buffer; }
 
+  BINLOG_QUEUE_WRITER_NOINLINE void* streamingCopy(char* dst, const void* src, std::size_t size)
+  {
+  #ifdef BINLOG_QUEUE_WRITER_HAS_SSE2
+    const char* s = static_cast<const char*>(src);
+
+    // copy the unaligned head normally, stream the aligned middle, copy the tail
+    const std::size_t head = (std::min)(size, (16 - (reinterpret_cast<std::uintptr_t>(dst) & 15)) & 15);
+    memcpy(dst, s, head);
+
+    std::size_t i = head;
+    for (; i + 16 <= size; i += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+
+    memcpy(dst + i, s + i, size - i);
+    _streamed = true;
+    return dst;
+  #else
+    return memcpy(dst, src, size);
+  #endif
+  }
+
   Queue* _queue;
 
   char* _writePos;
   char* _writeEnd;
+
+  std::size_t _streamingThreshold;
+  bool _streamed = false; /**< True if streaming stores were used since the last endWrite */
+};
+
+/**
+ * Write the internal write buffer of a QueueWriter,
+ * without knowing the total size of the writes in advance.
+ *
+ * If a write would exceed the writeCapacity() of the
+ * underlying QueueWriter, it is dropped, and overflow() becomes true.
+ * Once overflown, every subsequent write is dropped.
+ * Does not call beginWrite or endWrite.
+ *
+ * Models the mserialize::OutputStream concept
+ */
+class BoundedQueueWriter
+{
+public:
+  explicit BoundedQueueWriter(QueueWriter& qw)
+    :_qw(&qw)
+  {}
+
+  /** Same as QueueWriter::write(src, size), if there's enough capacity */
+  BoundedQueueWriter& write(const void* src, std::streamsize size)
+  {
+    if (! _overflow && std::size_t(size) <= _qw->writeCapacity())
+    {
+      _qw->writeBuffer(src, std::size_t(size));
+    }
+    else
+    {
+      _overflow = true;
+    }
+
+    return *this;
+  }
+
+  /** @returns true if a write was dropped */
+  bool overflow() const { return _overflow; }
+
+private:
+  QueueWriter* _qw;
+  bool _overflow = false;
 };
 
 } // namespace detail
@@ -0,0 +1,305 @@
+#ifndef BINLOG_DETAIL_SHARED_QUEUE_HPP
+#define BINLOG_DETAIL_SHARED_QUEUE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy, memset
+#include <ios> // streamsize
+#include <memory>
+
+namespace binlog {
+namespace detail {
+
+/**
+ * A multi producer, single consumer, concurrent queue of bytes.
+ *
+ * Unlike Queue, a SharedQueue can be written by any number
+ * of threads concurrently. It is meant to be shared by writers
+ * that rarely write, and do not deserve a private Queue.
+ *
+ * The queue stores records. Writers reserve space
+ * for a record by advancing the shared reserve index,
+ * then write the record, then commit it by setting
+ * the commit flag in the record header:
+ *
+ *    SharedQueueWriter w(q);
+ *    if (w.beginWrite(32))
+ *    {
+ *      w.writeBuffer(buf1, 16);
+ *      w.writeBuffer(buf2, 16);
+ *      w.endWrite(); // until this point, the record is not observable by the reader
+ *    }
+ *    // else: queue doesn't have space for 32 bytes
+ *
+ *    q.read(out); // write committed records to `out`
+ *
+ * The reader reads records in reservation order,
+ * and stops at the first record not yet committed.
+ *
+ * Each record has a 8 bytes header: u32 size and u32 commit flag,
+ * followed by the record data, padded to a multiple of 8 bytes.
+ * If a record does not fit before the end of the buffer,
+ * the space until the end is reserved and committed as padding,
+ * and the record is placed to the beginning of the buffer.
+ * The reader zeroes the bytes it consumed, therefore
+ * a newly reserved record is always uncommitted.
+ *
+ * The indices increase monotonically, the position
+ * in the buffer is index % capacity.
+ */
+class SharedQueue
+{
+public:
+  /**
+   * Construct a queue that can store `capacity` bytes,
+   * including the record headers.
+   *
+   * `capacity` is rounded up to a power of two.
+   */
+  explicit SharedQueue(std::size_t capacity);
+
+  SharedQueue(const SharedQueue&) = delete;
+  void operator=(const SharedQueue&) = delete;
+
+  /** @returns the maximum number of bytes the queue can store, including record headers */
+  std::size_t capacity() const { return _capacity; }
+
+  /**
+   * Reserve a record of `size` bytes.
+   *
+   * @returns a pointer to the reserved data, or nullptr if
+   *          the queue has not enough space for the record.
+   *          A reserved record must be committed by `commit`.
+   */
+  char* reserve(std::size_t size);
+
+  /**
+   * Make the record reserved by `reserve` available to the reader.
+   *
+   * @pre `data` was returned by `reserve`, and not yet committed
+   */
+  void commit(char* data);
+
+  /**
+   * Write the data of each committed record to `out`,
+   * in reservation order, until the first uncommitted record,
+   * then make the consumed space available for writers.
+   *
+   * Must not be called concurrently with itself.
+   *
+   * @requires OutputStream must model the mserialize::OutputStream concept
+   * @returns the number of bytes written to `out`
+   */
+  template <typename OutputStream>
+  std::size_t read(OutputStream& out);
+
+private:
+  enum CommitFlag : std::uint32_t { uncommitted = 0, committed = 1, padding = 2 };
+
+  static constexpr std::size_t headerSize = 2 * sizeof(std::uint32_t);
+
+  static std::size_t roundUp(std::size_t size) { return (size + headerSize - 1) & ~(headerSize - 1); }
+
+  static std::atomic<std::uint32_t>& commitFlag(char* record)
+  {
+    return *reinterpret_cast<std::atomic<std::uint32_t>*>(record + sizeof(std::uint32_t));
+  }
+
+  char* buffer() { return reinterpret_cast<char*>(_buffer.get()); }
+
+  char* record(std::uint64_t index) { return buffer() + (index & (_capacity - 1)); }
+
+  /** Zero the bytes in [begin, end) */
+  void clear(std::uint64_t begin, std::uint64_t end);
+
+  std::size_t _capacity;
+  std::unique_ptr<std::uint64_t[]> _buffer; /**< 8 byte aligned, to allow atomic access to the headers */
+
+  std::atomic<std::uint64_t> _reserveIndex; /**< Next index to reserve, written by writers */
+  std::atomic<std::uint64_t> _readIndex;    /**< Next index to read, written by the reader */
+};
+
+/**
+ * Write a single record of a SharedQueue.
+ *
+ * Has the same interface as QueueWriter,
+ * but the size of the record must be known
+ * in advance, as it cannot grow after `beginWrite`.
+ *
+ * Models the mserialize::OutputStream concept
+ */
+class SharedQueueWriter
+{
+public:
+  explicit SharedQueueWriter(SharedQueue& q)
+    :_queue(&q)
+  {}
+
+  /**
+   * Reserve a record of `size` bytes.
+   *
+   * @returns true if the queue had enough space for the record.
+   */
+  bool beginWrite(std::size_t size)
+  {
+    _record = _queue->reserve(size);
+    _writePos = _record;
+    _writeEnd = (_record != nullptr) ? _record + size : nullptr;
+    return _record != nullptr;
+  }
+
+  /** @returns the number of bytes still available for write in the reserved record */
+  std::size_t writeCapacity() const
+  {
+    return std::size_t(_writeEnd - _writePos);
+  }
+
+  /**
+   * Copy the range [src,src+size) to the reserved record.
+   *
+   * @pre writeCapacity() >= `size`
+   */
+  void* writeBuffer(const void* src, std::size_t size)
+  {
+    assert(_writePos + size <= _writeEnd);
+
+    void* result = memcpy(_writePos, src, size);
+    _writePos += size;
+    return result;
+  }
+
+  /** Same as writeBuffer(src, size) */
+  void* write(const void* src, std::streamsize size)
+  {
+    return writeBuffer(src, std::size_t(size));
+  }
+
+  /**
+   * Commit the reserved record.
+   *
+   * @pre the last beginWrite() returned true,
+   *      and writeCapacity() == 0
+   */
+  void endWrite()
+  {
+    assert(_writePos == _writeEnd);
+    _queue->commit(_record);
+    _record = _writePos = _writeEnd = nullptr;
+  }
+
+private:
+  SharedQueue* _queue;
+
+  char* _record = nullptr;
+  char* _writePos = nullptr;
+  char* _writeEnd = nullptr;
+};
+
+inline SharedQueue::SharedQueue(std::size_t capacity)
+  :_capacity(headerSize * 2),
+   _reserveIndex(0),
+   _readIndex(0)
+{
+  while (_capacity < capacity) { _capacity *= 2; }
+
+  // zero initialized: every record is uncommitted
+  _buffer.reset(new std::uint64_t[_capacity / sizeof(std::uint64_t)]());
+
+  static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "");
+}
+
+inline char* SharedQueue::reserve(std::size_t size)
+{
+  const std::size_t recordSize = headerSize + roundUp(size);
+  if (recordSize > _capacity / 2) { return nullptr; } // would not fit after padding
+
+  std::uint64_t index = _reserveIndex.load(std::memory_order_relaxed);
+  std::size_t paddingSize = 0;
+
+  do
+  {
+    const std::size_t offset = std::size_t(index & (_capacity - 1));
+    paddingSize = (offset + recordSize > _capacity) ? _capacity - offset : 0;
+
+    // acquire: the reader zeroed the consumed space before releasing it
+    const std::uint64_t r = _readIndex.load(std::memory_order_acquire);
+    if (index + paddingSize + recordSize - r > _capacity) { return nullptr; }
+  }
+  while (! _reserveIndex.compare_exchange_weak(
+    index, index + paddingSize + recordSize,
+    std::memory_order_relaxed, std::memory_order_relaxed
+  ));
+
+  if (paddingSize != 0)
+  {
+    char* pad = record(index);
+    const std::uint32_t padSize = std::uint32_t(paddingSize);
+    memcpy(pad, &padSize, sizeof(padSize));
+    commitFlag(pad).store(padding, std::memory_order_release);
+    index += paddingSize;
+  }
+
+  char* result = record(index);
+  const std::uint32_t dataSize = std::uint32_t(size);
+  memcpy(result, &dataSize, sizeof(dataSize));
+  return result + headerSize;
+}
+
+inline void SharedQueue::commit(char* data)
+{
+  commitFlag(data - headerSize).store(committed, std::memory_order_release);
+}
+
+template <typename OutputStream>
+std::size_t SharedQueue::read(OutputStream& out)
+{
+  const std::uint64_t begin = _readIndex.load(std::memory_order_relaxed);
+  std::uint64_t index = begin;
+  std::size_t result = 0;
+
+  // the header at begin+capacity is the consumed, but not yet cleared header at begin
+  while (index - begin < _capacity)
+  {
+    char* r = record(index);
+    const std::uint32_t flag = commitFlag(r).load(std::memory_order_acquire);
+    if (flag == uncommitted) { break; }
+
+    std::uint32_t size;
+    memcpy(&size, r, sizeof(size));
+
+    if (flag == padding)
+    {
+      index += size;
+    }
+    else
+    {
+      out.write(r + headerSize, std::streamsize(size));
+      result += size;
+      index += headerSize + roundUp(size);
+    }
+  }
+
+  clear(begin, index);
+  _readIndex.store(index, std::memory_order_release);
+
+  return result;
+}
+
+inline void SharedQueue::clear(std::uint64_t begin, std::uint64_t end)
+{
+  if (begin == end) { return; }
+
+  const std::size_t size = std::size_t(end - begin);
+  const std::size_t offset = std::size_t(begin & (_capacity - 1));
+  const std::size_t rightSize = (offset + size <= _capacity) ? size : _capacity - offset;
+
+  memset(buffer() + offset, 0, rightSize);
+  memset(buffer(), 0, size - rightSize);
+}
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_DETAIL_SHARED_QUEUE_HPP
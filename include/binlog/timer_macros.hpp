@@ -0,0 +1,264 @@
+#ifndef BINLOG_TIMER_MACROS_HPP
+#define BINLOG_TIMER_MACROS_HPP
+
+#include <binlog/Severity.hpp>
+#include <binlog/Time.hpp>
+#include <binlog/create_source_and_event.hpp>
+#include <binlog/default_session.hpp> // default_thread_local_writer
+
+#include <mserialize/detail/preprocessor.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility> // forward, index_sequence, move
+
+/**
+ * BINLOG_SCOPE_TIMER_WC(writer, category, format, args...)
+ *
+ * Measure the time spent in the enclosing scope, and when
+ * the scope is left, add a single event to `writer`, with severity info,
+ * using the specified `category`. The event is timestamped with
+ * the clock of entering the scope, and its message is `format`
+ * followed by the elapsed time in nanoseconds: " (duration: {} ns)".
+ *
+ * `args` are evaluated when the scope is left, therefore
+ * they must refer to objects that are still valid at that point.
+ * If evaluating `args` throws, the exception is dropped
+ * with the event, as it cannot leave the destructor of the timer.
+ * If info severity is below the minimum severity configured for `writer`
+ * when the scope is entered, the clock is not read, no event is created,
+ * and the arguments are not evaluated.
+ *
+ * The clock is read by binlog::clockNow, the same way
+ * as the other log macros timestamp their events.
+ * As the clock is read twice, a timer costs more than a log event:
+ * about the cost of a log event plus a clock read (clock_gettime).
+ *
+ * @param writer binlog::SessionWriter
+ * @param category arbitrary valid symbol name
+ * @param format string literal with {} placeholders
+ * @param args... any number of serializable, tagged, log arguments. Can be empty
+ */
+#define BINLOG_SCOPE_TIMER_WC(writer, category, ...)                              \
+  BINLOG_DETAIL_SCOPE_EVENT(ScopeTimer, writer, category,                         \
+    " (duration: {} ns)", "L{binlog::scope_timer}", __VA_ARGS__)                  \
+  /**/
+
+/**
+ * BINLOG_SPAN_WC(writer, category, format, args...)
+ *
+ * Same as BINLOG_SCOPE_TIMER_WC, but also gives the scope
+ * an id, unique for `writer`, and records the id of the enclosing span
+ * of the same writer (the parent), or zero, if there is none.
+ * The message of the event is `format` followed by
+ * " (span: {}, parent: {}, duration: {} ns)".
+ *
+ * The event of a nested span is added before the event of its parent,
+ * as it is left sooner. Spans are tracked per writer:
+ * a span must be left on the thread it was entered.
+ *
+ * @see SessionWriter::openSpan
+ */
+#define BINLOG_SPAN_WC(writer, category, ...)                                     \
+  BINLOG_DETAIL_SCOPE_EVENT(ScopeSpan, writer, category,                          \
+    " (span: {}, parent: {}, duration: {} ns)", "LLL{binlog::span}", __VA_ARGS__) \
+  /**/
+
+/**
+ * BINLOG_SCOPE_TIMER_W(writer, format, args...)
+ * BINLOG_SPAN_W(writer, format, args...)
+ *
+ * Same as BINLOG_SCOPE_TIMER_WC and BINLOG_SPAN_WC,
+ * using the category "main".
+ */
+#define BINLOG_SCOPE_TIMER_W(writer, ...) BINLOG_SCOPE_TIMER_WC(writer, main, __VA_ARGS__)
+#define BINLOG_SPAN_W(       writer, ...) BINLOG_SPAN_WC(       writer, main, __VA_ARGS__)
+
+/**
+ * BINLOG_SCOPE_TIMER(format, args...)
+ * BINLOG_SPAN(format, args...)
+ *
+ * Same as BINLOG_SCOPE_TIMER_W and BINLOG_SPAN_W,
+ * using the default thread local writer, see BINLOG_INFO.
+ *
+ *    void processOrder(const Order& order)
+ *    {
+ *      BINLOG_SPAN("Process order {}", order.id);
+ *      // ...
+ *    }
+ */
+#define BINLOG_SCOPE_TIMER(...) BINLOG_SCOPE_TIMER_W(binlog::default_thread_local_writer(), __VA_ARGS__)
+#define BINLOG_SPAN(...)        BINLOG_SPAN_W(       binlog::default_thread_local_writer(), __VA_ARGS__)
+
+// The event source is added when the scope is entered,
+// to make it describe the enclosing function, not the lambda.
+// The argument tags of the source end with an empty struct
+// ({binlog::scope_timer} or {binlog::span}) without a placeholder:
+// it takes no space in the event, and is not shown by the message,
+// but marks the source for readers (e.g: bread -t).
+#define BINLOG_DETAIL_SCOPE_EVENT(Scope, writer, category, suffix, suffixTags, /* format, */ ...) \
+  std::uint64_t MSERIALIZE_CAT(_binlog_scope_sid_v_, __LINE__) = 0;                            \
+  if (binlog::Severity::info >= writer.session().minSeverity())                                \
+  {                                                                                            \
+    BINLOG_DETAIL_ADD_EVENT_SOURCE(MSERIALIZE_CAT(_binlog_scope_sid_v_, __LINE__),             \
+      writer, binlog::Severity::info, category, suffix, suffixTags, __VA_ARGS__);              \
+  }                                                                                            \
+  const auto& MSERIALIZE_CAT(_binlog_scope_, __LINE__) = binlog::detail::make##Scope(          \
+    writer, MSERIALIZE_CAT(_binlog_scope_sid_v_, __LINE__),                                    \
+    [&](auto& _binlog_w, std::uint64_t _binlog_sid, std::uint64_t _binlog_clock, const auto& _binlog_suffix_args) \
+    {                                                                                          \
+      binlog::detail::addEventIgnoreFirstAppend(_binlog_w, binlog::Severity::info,             \
+        _binlog_sid, _binlog_clock, _binlog_suffix_args, __VA_ARGS__);                         \
+    }                                                                                          \
+  );                                                                                           \
+  (void)MSERIALIZE_CAT(_binlog_scope_, __LINE__)                                               \
+  /**/
+
+namespace binlog {
+namespace detail {
+
+template <typename Writer, std::size_t N, typename... T, std::size_t... I>
+void addEventAppend(Writer& writer, Severity severity, std::uint64_t eventSourceId, std::uint64_t clock, const std::array<std::uint64_t, N>& suffix, std::index_sequence<I...>, T&&... t)
+{
+  writer.addEvent(severity, eventSourceId, clock, std::forward<T>(t)..., suffix[I]...);
+}
+
+// Same as addEventIgnoreFirst, but adds the elements of `suffix` as the last arguments
+template <typename Writer, std::size_t N, typename Unused, typename... T>
+void addEventIgnoreFirstAppend(Writer& writer, Severity severity, std::uint64_t eventSourceId, std::uint64_t clock, const std::array<std::uint64_t, N>& suffix, Unused&&, T&&... t)
+{
+  addEventAppend(writer, severity, eventSourceId, clock, suffix, std::make_index_sequence<N>{}, std::forward<T>(t)...);
+}
+
+/**
+ * Call `addEvent` when destroyed, with the clock
+ * of construction, and the elapsed time.
+ *
+ * Does nothing if `eventSourceId` is zero.
+ * @see BINLOG_SCOPE_TIMER_WC
+ */
+template <typename Writer, typename AddEvent>
+class ScopeTimer
+{
+public:
+  ScopeTimer(Writer& writer, std::uint64_t eventSourceId, AddEvent addEvent)
+    :_writer(writer),
+     _eventSourceId(eventSourceId),
+     _addEvent(std::move(addEvent)),
+     _start(eventSourceId != 0 ? clockNow() : 0)
+  {}
+
+  ScopeTimer(ScopeTimer&& rhs) noexcept
+    :_writer(rhs._writer),
+     _eventSourceId(rhs._eventSourceId),
+     _addEvent(std::move(rhs._addEvent)),
+     _start(rhs._start)
+  {
+    rhs._eventSourceId = 0;
+  }
+
+  ScopeTimer(const ScopeTimer&) = delete;
+  void operator=(const ScopeTimer&) = delete;
+  void operator=(ScopeTimer&&) = delete;
+
+  ~ScopeTimer()
+  {
+    if (_eventSourceId == 0) { return; }
+
+    const std::uint64_t duration = clockNow() - _start;
+    try
+    {
+      _addEvent(_writer, _eventSourceId, _start, std::array<std::uint64_t, 1>{{duration}});
+    }
+    catch (...)
+    {
+      // evaluating the arguments failed, drop the event
+    }
+  }
+
+private:
+  Writer& _writer;
+  std::uint64_t _eventSourceId;
+  AddEvent _addEvent;
+  std::uint64_t _start;
+};
+
+/**
+ * Same as ScopeTimer, but also opens a span of `writer`
+ * when constructed, and closes it when destroyed.
+ *
+ * @see BINLOG_SPAN_WC
+ */
+template <typename Writer, typename AddEvent>
+class ScopeSpan
+{
+public:
+  ScopeSpan(Writer& writer, std::uint64_t eventSourceId, AddEvent addEvent)
+    :_writer(writer),
+     _eventSourceId(eventSourceId),
+     _addEvent(std::move(addEvent))
+  {
+    if (eventSourceId != 0)
+    {
+      _id = writer.openSpan(_parent);
+      _start = clockNow();
+    }
+  }
+
+  ScopeSpan(ScopeSpan&& rhs) noexcept
+    :_writer(rhs._writer),
+     _eventSourceId(rhs._eventSourceId),
+     _addEvent(std::move(rhs._addEvent)),
+     _id(rhs._id),
+     _parent(rhs._parent),
+     _start(rhs._start)
+  {
+    rhs._eventSourceId = 0;
+  }
+
+  ScopeSpan(const ScopeSpan&) = delete;
+  void operator=(const ScopeSpan&) = delete;
+  void operator=(ScopeSpan&&) = delete;
+
+  ~ScopeSpan()
+  {
+    if (_eventSourceId == 0) { return; }
+
+    const std::uint64_t duration = clockNow() - _start;
+    _writer.closeSpan(_parent);
+    try
+    {
+      _addEvent(_writer, _eventSourceId, _start, std::array<std::uint64_t, 3>{{_id, _parent, duration}});
+    }
+    catch (...)
+    {
+      // evaluating the arguments failed, drop the event
+    }
+  }
+
+private:
+  Writer& _writer;
+  std::uint64_t _eventSourceId;
+  AddEvent _addEvent;
+  std::uint64_t _id = 0;
+  std::uint64_t _parent = 0;
+  std::uint64_t _start = 0;
+};
+
+template <typename Writer, typename AddEvent>
+ScopeTimer<Writer, AddEvent> makeScopeTimer(Writer& writer, std::uint64_t eventSourceId, AddEvent addEvent)
+{
+  return ScopeTimer<Writer, AddEvent>(writer, eventSourceId, std::move(addEvent));
+}
+
+template <typename Writer, typename AddEvent>
+ScopeSpan<Writer, AddEvent> makeScopeSpan(Writer& writer, std::uint64_t eventSourceId, AddEvent addEvent)
+{
+  return ScopeSpan<Writer, AddEvent>(writer, eventSourceId, std::move(addEvent));
+}
+
+} // namespace detail
+} // namespace binlog
+
+#endif // BINLOG_TIMER_MACROS_HPP
@@ -1,8 +1,11 @@
 #ifndef MSERIALIZE_STRUCT_SERIALIZER_HPP
 #define MSERIALIZE_STRUCT_SERIALIZER_HPP
 
+#include <mserialize/detail/type_traits.hpp>
 #include <mserialize/serialize.hpp>
 
+#include <cstddef>
+#include <ios> // streamsize
 #include <type_traits>
 
 namespace mserialize {
@@ -47,6 +50,41 @@ template <typename T, typename Ret>
 auto serializable_member(Ret (T::*getter)() const noexcept) -> decltype(getter);
 #endif
 
+namespace detail {
+
+// Size of a member of a bitwise serializable struct, 0 if not such member
+
+template <typename MemberPtr, typename = void>
+struct bitwise_member_size : std::integral_constant<std::size_t, 0> {};
+
+template <typename T, typename Field>
+struct bitwise_member_size<Field T::*, enable_spec_if<conjunction<
+  std::is_member_object_pointer<Field T::*>,
+  maybe_bitwise_serializable<Field>
+>>>
+  : std::integral_constant<std::size_t, sizeof(Field)> {};
+
+template <typename T, typename... Members>
+struct is_struct_maybe_bitwise_serializable
+{
+  static constexpr std::size_t member_size_sum()
+  {
+    const std::size_t sizes[] = {0, bitwise_member_size<typename Members::value_type>::value...};
+
+    std::size_t result = 0;
+    for (auto s : sizes) { result += s; }
+    return result;
+  }
+
+  // Members are bitwise serializable, and cover the whole object representation, without padding.
+  // Members are not checked to follow each other in the order of declaration.
+  static constexpr bool value = std::is_trivially_copyable<T>::value
+    && conjunction<std::integral_constant<bool, bitwise_member_size<typename Members::value_type>::value != 0>...>::value
+    && member_size_sum() == sizeof(T);
+};
+
+} // namespace detail
+
 /**
  * Serialize the given members of a custom type `T`.
  *
@@ -84,15 +122,45 @@ auto serializable_member(Ret (T::*getter)() const noexcept) -> decltype(getter);
  *
  * Note: C++ does not allow taking the address of reference members or bitfields,
  * therefore those cannot be serialized directly: a getter must be used instead.
+ *
+ * If `T` is trivially copyable, and the serializable data members cover
+ * the whole object without padding, in order of declaration,
+ * the object is serialized with a single write.
  */
 template <typename T, typename... Members>
 struct StructSerializer
 {
+  /**
+   * True if the serialized form of T might be equal to its object representation,
+   * i.e: T is trivially copyable, the members are bitwise serializable data members,
+   * and the sum of their sizes is sizeof(T).
+   */
+  static constexpr bool maybe_bitwise = detail::is_struct_maybe_bitwise_serializable<T, Members...>::value;
+
+  /**
+   * @returns true if maybe_bitwise, and each member
+   * is located at the end of the previous one, starting at offset 0.
+   * Member offsets are not available at compile time,
+   * but this function is usually folded to a constant by the optimizer.
+   */
+  static bool is_bitwise(const T& t)
+  {
+    return is_bitwise_impl(std::integral_constant<bool, maybe_bitwise>{}, t);
+  }
+
   template <typename OutputStream>
   static void serialize(const T& t, OutputStream& ostream)
   {
-    using swallow = int[];
-    (void)swallow{1, (serialize_member(t, Members::value, ostream), int{})...};
+    if (is_bitwise(t))
+    {
+      // serialized form is equal to the object representation: copy it at once
+      ostream.write(reinterpret_cast<const char*>(&t), std::streamsize(sizeof(T)));
+    }
+    else
+    {
+      using swallow = int[];
+      (void)swallow{1, (serialize_member(t, Members::value, ostream), int{})...};
+    }
   }
 
   static std::size_t serialized_size(const T& t)
@@ -105,6 +173,34 @@ struct StructSerializer
   }
 
 private:
+  static bool is_bitwise_impl(std::false_type /* maybe_bitwise */, const T&)
+  {
+    return false;
+  }
+
+  static bool is_bitwise_impl(std::true_type /* maybe_bitwise */, const T& t)
+  {
+    const char* const base = reinterpret_cast<const char*>(&t);
+    std::size_t offset = 0;
+    const bool members_in_place[] = {true, is_bitwise_member_at(t, Members::value, base, offset)...};
+
+    for (bool b : members_in_place)
+    {
+      if (! b) { return false; }
+    }
+    return true;
+  }
+
+  template <typename Field>
+  static bool is_bitwise_member_at(const T& t, Field T::*field, const char* base, std::size_t& offset)
+  {
+    const Field& member = t.*field;
+    const bool result = reinterpret_cast<const char*>(&member) == base + offset
+      && detail::Serializer<std::remove_cv_t<Field>>::type::is_bitwise(member);
+    offset += sizeof(Field);
+    return result;
+  }
+
   template <typename Field, typename OutputStream>
   static void serialize_member(const T& t, Field T::*field, OutputStream& ostream)
   {
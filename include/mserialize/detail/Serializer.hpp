@@ -66,6 +66,10 @@ struct TrivialSerializer
 {
   static_assert(std::is_trivially_copyable<T>::value, "");
 
+  static constexpr bool maybe_bitwise = true;
+
+  static bool is_bitwise(const T&) { return true; }
+
   template <typename OutputStream>
   static void serialize(const T t, OutputStream& ostream)
   {
@@ -112,14 +116,14 @@ struct BuiltinSerializer<Sequence, enable_spec_if<
 
   static std::size_t serialized_size(const Sequence& s)
   {
-    // Note: we are using is_arithmetic to fast-path some types.
+    // Note: we are using maybe_bitwise_serializable to fast-path some types.
     // The correct trait would be has_fixed_size, which could
     // include tuples of fixed size objects and fixed size
     // sequences (std::array, C array) of fixed size objects.
     // However, that would need a lot of code, so we just
     // let the optimizer do the job.
     return sizeof(std::uint32_t)
-         + sizeof_elems(std::is_arithmetic<sequence_data_t<const Sequence>>{}, s);
+         + sizeof_elems(maybe_bitwise_serializable<value_type>{}, s);
   }
 
 private:
@@ -148,14 +152,26 @@ private:
     // C11 7.24.1 String function conventions p2
     if (size)
     {
-      const char* data = reinterpret_cast<const char*>(sequence_data(s));
-      const size_t serialized_size = sizeof(sequence_data_t<const Sequence>) * size;
-      ostream.write(data, std::streamsize(serialized_size));
+      using T = std::remove_cv_t<sequence_data_t<const Sequence>>;
+      const T* elems = sequence_data(s);
+
+      // for adapted structs, the layout check is evaluated compile time
+      // by the optimizer, as it only depends on member offsets.
+      if (Serializer<T>::type::is_bitwise(elems[0]))
+      {
+        const char* data = reinterpret_cast<const char*>(elems);
+        const size_t serialized_size = sizeof(T) * size;
+        ostream.write(data, std::streamsize(serialized_size));
+      }
+      else
+      {
+        serialize_elems(std::false_type{}, s, size, ostream);
+      }
     }
   }
 
   static std::size_t sizeof_elems(
-    std::false_type /* value_type is not arithmetic */,
+    std::false_type /* value_type is not bitwise serializable */,
     const Sequence& s
   )
   {
@@ -168,11 +184,11 @@ private:
   }
 
   static std::size_t sizeof_elems(
-    std::true_type /* value_type is arithmetic */,
+    std::true_type /* value_type is bitwise serializable */,
     const Sequence& s
   )
   {
-    return std::size_t(sequence_size(s)) * sizeof(sequence_data_t<const Sequence>);
+    return std::size_t(sequence_size(s)) * sizeof(value_type);
   }
 };
 
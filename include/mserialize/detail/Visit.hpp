@@ -7,6 +7,7 @@
 
 #include <mserialize/detail/integer_to_hex.hpp>
 #include <mserialize/detail/tag_util.hpp>
+#include <mserialize/detail/varint.hpp>
 
 #include <type_traits>
 
@@ -49,7 +50,7 @@ public:
 template <typename Visitor, typename InputStream>
 void visit_impl(string_view full_tag, string_view tag, Visitor& visitor, InputStream& istream, int max_recursion);
 
-/** @pre tag in "ycbsilBSILfdD" */
+/** @pre tag in "ycbsilBSILfdDvz" */
 template <typename Visitor, typename InputStream>
 void visit_arithmetic(char tag, Visitor& visitor, InputStream& istream)
 {
@@ -71,6 +72,9 @@ void visit_arithmetic(char tag, Visitor& visitor, InputStream& istream)
   case 'f': float f;       mserialize::deserialize(f, istream); visitor.visit(f); break;
   case 'd': double d;      mserialize::deserialize(d, istream); visitor.visit(d); break;
   case 'D': long double D; mserialize::deserialize(D, istream); visitor.visit(D); break;
+
+  case 'v': visitor.visit(read_varint(istream)); break;
+  case 'z': visitor.visit(zigzag_decode(read_varint(istream))); break;
   default: throw std::runtime_error(std::string("Invalid arithmetic tag: ") + tag); break;
   }
 }
@@ -116,11 +116,14 @@ using sequence_has_contiguous_data = std::is_pointer<
 >;
 
 // Is sequence batch serializable
+//
+// Elements of such sequences can be serialized by a single memcpy,
+// if Serializer<T>::type::is_bitwise(first_elem) returns true.
 
 template <typename Sequence>
 using is_sequence_batch_serializable = conjunction<
   sequence_has_contiguous_data<Sequence>,
-  std::is_arithmetic<sequence_data_t<Sequence>>
+  maybe_bitwise_serializable<sequence_data_t<Sequence>>
 >;
 
 // Is sequence batch deserializable
@@ -59,6 +59,21 @@ struct Serializer;
 template <typename T>
 using is_serializable = std::is_constructible<typename Serializer<T>::type>;
 
+// Maybe bitwise serializable
+//
+// True if the serialized form of `T` is possibly equal to its object representation,
+// and the serialized size is always sizeof(T). If true, `Serializer<T>::type::is_bitwise(t)`
+// tells if the serialized form of `t` is actually equal to its object representation,
+// therefore it can be serialized by a single memcpy.
+
+template <typename T, typename = void>
+struct maybe_bitwise_serializable : std::false_type {};
+
+template <typename T>
+struct maybe_bitwise_serializable<T, enable_spec_if<
+  std::integral_constant<bool, Serializer<std::remove_cv_t<T>>::type::maybe_bitwise>
+>> : std::true_type {};
+
 // Is deserializable
 
 template <typename T>
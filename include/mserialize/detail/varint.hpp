@@ -0,0 +1,166 @@
+#ifndef MSERIALIZE_DETAIL_VARINT_HPP
+#define MSERIALIZE_DETAIL_VARINT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <ios> // streamsize
+#include <stdexcept>
+#include <type_traits>
+#include <utility> // declval
+
+namespace mserialize {
+namespace detail {
+
+/**
+ * Variable length integers (LEB128):
+ * Each byte holds 7 bits of the value, least significant group first.
+ * The most significant bit of each byte is set,
+ * if more bytes follow (continuation bit).
+ *
+ * Signed values are zigzag encoded first, to map
+ * small negative numbers to small unsigned numbers:
+ * 0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, ...
+ */
+constexpr std::size_t max_varint_size = 10;
+
+constexpr std::uint64_t zigzag_encode(std::int64_t v)
+{
+  return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63);
+}
+
+constexpr std::int64_t zigzag_decode(std::uint64_t v)
+{
+  return std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+}
+
+/** @returns the number of bytes needed to represent `v` as a varint */
+constexpr std::size_t varint_size(std::uint64_t v)
+{
+  std::size_t size = 1;
+  for (; v >= 0x80; v >>= 7) { ++size; }
+  return size;
+}
+
+/**
+ * Write `v` as a varint to [out, out+varint_size(v)).
+ *
+ * @pre out points to a buffer of at least max_varint_size bytes
+ * @returns pointer to the end of the written varint
+ */
+inline char* write_varint(std::uint64_t v, char* out)
+{
+  for (; v >= 0x80; v >>= 7)
+  {
+    *out++ = char((v & 0x7F) | 0x80);
+  }
+  *out++ = char(v);
+  return out;
+}
+
+// Generic decoder, for any InputStream
+
+template <typename InputStream>
+std::uint64_t read_varint_bytewise(InputStream& istream)
+{
+  std::uint64_t result = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7)
+  {
+    char c;
+    istream.read(&c, 1);
+    const std::uint64_t byte = std::uint8_t(c);
+    result |= (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) { return result; }
+  }
+
+  throw std::runtime_error("Invalid varint: longer than 10 bytes");
+}
+
+/**
+ * Decode a varint of at most 8 bytes from `p`,
+ * using SWAR (SIMD within a register) operations:
+ * find the terminating byte, then compact the 7 bit
+ * groups of the preceding bytes without branching.
+ *
+ * @pre [p, p+8) is readable
+ * @returns the number of bytes the varint takes,
+ *          or 0, if the varint is longer than 8 bytes.
+ */
+inline std::size_t decode_varint_swar(const char* p, std::uint64_t& result)
+{
+  std::uint64_t word = 0;
+  std::memcpy(&word, p, sizeof(word));
+
+  // bytes are loaded in memory order: requires a little endian host
+  const std::uint64_t terminators = ~word & 0x8080808080808080;
+  if (terminators == 0) { return 0; }
+
+  // mask bytes up to and including the first terminator
+  const std::uint64_t last = terminators & (~terminators + 1);
+  const std::uint64_t mask = last | (last - 1);
+
+  // number of bytes covered by the mask, summed in the top byte
+  const std::size_t size = std::size_t(((mask & 0x0101010101010101) * 0x0101010101010101) >> 56);
+
+  std::uint64_t x = word & mask & 0x7F7F7F7F7F7F7F7F;
+  x = (x & 0x007F007F007F007F) | ((x & 0x7F007F007F007F00) >> 1);
+  x = (x & 0x00003FFF00003FFF) | ((x & 0x3FFF00003FFF0000) >> 2);
+  x = (x & 0x000000000FFFFFFF) | ((x & 0x0FFFFFFF00000000) >> 4);
+
+  result = x;
+  return size;
+}
+
+// InputStreams that can expose the underlying buffer (e.g: binlog::Range)
+// are decoded with the SWAR decoder, if enough bytes are available.
+
+template <typename InputStream, typename = void>
+struct has_contiguous_view : std::false_type {};
+
+template <typename InputStream>
+struct has_contiguous_view<InputStream, decltype(
+  void(std::declval<InputStream&>().size()),
+  void(std::declval<InputStream&>().view(std::size_t{}))
+)> : std::true_type {};
+
+template <typename InputStream>
+std::uint64_t read_varint_impl(std::false_type /* has_contiguous_view */, InputStream& istream)
+{
+  return read_varint_bytewise(istream);
+}
+
+template <typename InputStream>
+std::uint64_t read_varint_impl(std::true_type /* has_contiguous_view */, InputStream& istream)
+{
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_M_X64) || defined(_M_IX86)
+  if (istream.size() >= sizeof(std::uint64_t))
+  {
+    std::uint64_t result = 0;
+    const std::size_t size = decode_varint_swar(istream.view(0), result);
+    if (size != 0)
+    {
+      istream.view(size);
+      return result;
+    }
+  }
+#endif
+
+  return read_varint_bytewise(istream);
+}
+
+/**
+ * Read a varint from `istream`.
+ *
+ * @throws std::runtime_error if the varint is longer than 10 bytes
+ * @throws whatever `istream.read` throws
+ */
+template <typename InputStream>
+std::uint64_t read_varint(InputStream& istream)
+{
+  return read_varint_impl(has_contiguous_view<InputStream>{}, istream);
+}
+
+} // namespace detail
+} // namespace mserialize
+
+#endif // MSERIALIZE_DETAIL_VARINT_HPP
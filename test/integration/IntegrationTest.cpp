@@ -107,6 +107,8 @@ TEST_CASE("LoggingFundamentals")   { runReadDiff("LoggingFundamentals", "%m"); }
 TEST_CASE("LoggingContainers")     { runReadDiff("LoggingContainers", "%m"); }
 TEST_CASE("LoggingStrings")        { runReadDiff("LoggingStrings", "%m"); }
 TEST_CASE("LoggingCStrings")       { runReadDiff("LoggingCStrings", "%m"); }
+TEST_CASE("LoggingLiterals")       { runReadDiff("LoggingLiterals", "%m"); }
+TEST_CASE("LoggingInterned")       { runReadDiff("LoggingInterned", "%m"); }
 TEST_CASE("LoggingPointers")       { runReadDiff("LoggingPointers", "%m"); }
 TEST_CASE("LoggingTuples")         { runReadDiff("LoggingTuples", "%m"); }
 TEST_CASE("LoggingEnums")          { runReadDiff("LoggingEnums", "%m"); }
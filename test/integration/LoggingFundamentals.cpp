@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <iostream>
+#include <limits>
 
 template <typename T>
 void logSigned()
@@ -78,6 +79,19 @@ int main()
   BINLOG_INFO("{} {} {} {}", b, cb, br, false);
   // Outputs: true false true false
 
+  //[varint
+  const std::uint64_t orderId = 123;
+  const std::int32_t position = -5;
+  BINLOG_INFO("Order: {}, position: {}", binlog::varint(orderId), binlog::varint(position));
+  // Outputs: Order: 123, position: -5
+  //]
+
+  BINLOG_INFO("{} {} {} {}",
+    binlog::varint(std::uint8_t(255)), binlog::varint(std::numeric_limits<std::int64_t>::min()),
+    binlog::varint(std::numeric_limits<std::uint64_t>::max()), binlog::varint(std::int16_t(300))
+  );
+  // Outputs: 255 -9223372036854775808 18446744073709551615 300
+
   binlog::consume(std::cout);
   return 0;
 }
@@ -0,0 +1,24 @@
+#include <binlog/binlog.hpp>
+
+#include <iostream>
+#include <string>
+
+int main()
+{
+  //[interned
+  const std::string symbol = "MSFT";
+  BINLOG_INFO("Order received, symbol: {}", binlog::interned(symbol));
+  // Outputs: Order received, symbol: MSFT
+  BINLOG_INFO("Order filled, symbol: {}, venue: {}", binlog::interned(symbol), binlog::interned("XNAS"));
+  // Outputs: Order filled, symbol: MSFT, venue: XNAS
+  //]
+
+  binlog::consume(std::cout);
+
+  // strings already written are referred to by id
+  BINLOG_INFO("Order cancelled, symbol: {}, venue: {}", binlog::interned(symbol), binlog::interned(std::string("XNAS")));
+  // Outputs: Order cancelled, symbol: MSFT, venue: XNAS
+
+  binlog::consume(std::cout);
+  return 0;
+}
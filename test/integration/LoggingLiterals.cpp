@@ -0,0 +1,31 @@
+#include <binlog/binlog.hpp>
+
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const char* const g_orderStates[] = {"NEW", "FILLED", "CANCELLED"};
+
+} // namespace
+
+int main()
+{
+  //[literal
+  BINLOG_INFO("Order state: {}", binlog::literal(g_orderStates[0]));
+  // Outputs: Order state: NEW
+  BINLOG_INFO("Order state: {}, previous: {}", binlog::literal(g_orderStates[1]), binlog::literal(g_orderStates[0]));
+  // Outputs: Order state: FILLED, previous: NEW
+  //]
+
+  binlog::consume(std::cout);
+
+  // strings already consumed are not written again
+  BINLOG_INFO("Order state: {}", binlog::literal(g_orderStates[2]));
+  // Outputs: Order state: CANCELLED
+  BINLOG_INFO("Literals in a container: {}", std::vector<binlog::literal>{binlog::literal("a"), binlog::literal("b")});
+  // Outputs: Literals in a container: [a, b]
+
+  binlog::consume(std::cout);
+  return 0;
+}
@@ -3,7 +3,10 @@
 #include <benchmark/benchmark.h>
 
 #include <array>
+#include <cstdint>
 #include <ios> // streamsize
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
   #include <intrin.h>
@@ -79,6 +82,43 @@ void BM_addEventPoisonCache(benchmark::State& state)
 }
 BENCHMARK(BM_addEventPoisonCache); // NOLINT
 
+// Log a large payload, then use the data cache, as the application would.
+// The time of using the data cache includes the cache misses
+// caused by the logging: with streaming stores (Arg=1),
+// the payload does not evict the working set.
+void BM_addLargeEventPoisonCache(benchmark::State& state)
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 1 << 24);
+  if (state.range(0) != 0)
+  {
+    writer.setStreamingThreshold(1024);
+  }
+
+  const std::string payload(16 * 1024, 'p');
+  std::array<char, 16 * 1024> workingSet{};
+
+  for (int i = 0; state.KeepRunning(); ++i)
+  {
+    BINLOG_INFO_W(writer, "Packet: {}", payload);
+
+    // Simulate the application using the data cache
+    for (char& c : workingSet) { c = char(c + 1); }
+    doNotOptimizeBuffer(workingSet.data(), workingSet.size());
+
+    // flush the queue, otherwise queue allocation will be timed
+    if (i == 512)
+    {
+      state.PauseTiming();
+      i = 0;
+      NullOstream out;
+      session.consume(out);
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_addLargeEventPoisonCache)->Arg(0)->Arg(1); // NOLINT
+
 void BM_addEventNoClock(benchmark::State& state)
 {
   binlog::Session session;
@@ -173,6 +213,115 @@ void BM_addEvent_OneStringArgument(benchmark::State& state)
 }
 BENCHMARK(BM_addEvent_OneStringArgument); // NOLINT
 
+void BM_addEvent_StringVectorArgument(benchmark::State& state)
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session);
+
+  const std::vector<std::string> v{"foo", "bar", "baz", "qux", "quux"};
+
+  for (int i = 0; state.KeepRunning(); ++i)
+  {
+    BINLOG_INFO_W(writer, "String vector: {}", v);
+
+    // flush the queue, otherwise queue allocation will be timed
+    if (i == 2048)
+    {
+      state.PauseTiming();
+      i = 0;
+      NullOstream out;
+      session.consume(out);
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_addEvent_StringVectorArgument); // NOLINT
+
+struct Quote
+{
+  std::int64_t px = 0;
+  std::int32_t qty = 0;
+  std::int32_t side = 0;
+};
+
+} // namespace
+
+BINLOG_ADAPT_STRUCT(Quote, px, qty, side)
+
+namespace {
+
+void BM_addEvent_QuoteVectorArgument(benchmark::State& state)
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session);
+
+  const std::vector<Quote> v(16, Quote{1234, 100, 1});
+
+  for (int i = 0; state.KeepRunning(); ++i)
+  {
+    BINLOG_INFO_W(writer, "Quotes: {}", v);
+
+    // flush the queue, otherwise queue allocation will be timed
+    if (i == 512)
+    {
+      state.PauseTiming();
+      i = 0;
+      NullOstream out;
+      session.consume(out);
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_addEvent_QuoteVectorArgument); // NOLINT
+
+void BM_scopeTimer(benchmark::State& state)
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session);
+
+  for (int i = 0; state.KeepRunning(); ++i)
+  {
+    {
+      BINLOG_SCOPE_TIMER_W(writer, "Iteration {}", i);
+    }
+
+    // flush the queue, otherwise queue allocation will be timed
+    if (i == 2048)
+    {
+      state.PauseTiming();
+      i = 0;
+      NullOstream out;
+      session.consume(out);
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_scopeTimer); // NOLINT
+
+void BM_span(benchmark::State& state)
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session);
+
+  for (int i = 0; state.KeepRunning(); ++i)
+  {
+    {
+      BINLOG_SPAN_W(writer, "Iteration {}", i);
+    }
+
+    // flush the queue, otherwise queue allocation will be timed
+    if (i == 2048)
+    {
+      state.PauseTiming();
+      i = 0;
+      NullOstream out;
+      session.consume(out);
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_span); // NOLINT
+
 } // namespace
 
 BENCHMARK_MAIN();
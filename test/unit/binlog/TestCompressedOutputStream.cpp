@@ -0,0 +1,536 @@
+#include <binlog/CompressedOutputStream.hpp>
+
+#include <binlog/Codec.hpp>
+#include <binlog/Entries.hpp>
+#include <binlog/EntryStream.hpp>
+#include <binlog/EventFilter.hpp>
+#include <binlog/EventStream.hpp>
+#include <binlog/PrettyPrinter.hpp>
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/advanced_log_macros.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <mserialize/deserialize.hpp>
+#include <mserialize/serialize.hpp>
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<char> roundtrip(binlog::Codec codec, const std::vector<char>& input)
+{
+  std::vector<char> compressed(binlog::detail::compressBound(codec, input.size()));
+  compressed.resize(binlog::detail::compress(codec, input.data(), input.size(), compressed.data(), compressed.size()));
+
+  std::vector<char> result(input.size());
+  binlog::detail::decompress(codec, compressed.data(), compressed.size(), result.data(), result.size());
+  return result;
+}
+
+std::vector<char> randomBytes(std::size_t size)
+{
+  std::mt19937 rng(42);
+  std::vector<char> result(size);
+  for (char& c : result) { c = static_cast<char>(rng()); }
+  return result;
+}
+
+std::vector<char> repetitiveBytes(std::size_t size)
+{
+  const std::string pattern = "INFO Hello compression! 123456789 ";
+  std::vector<char> result(size);
+  for (std::size_t i = 0; i < size; ++i) { result[i] = pattern[i % pattern.size()]; }
+  return result;
+}
+
+std::vector<std::string> readEvents(binlog::EntryStream& input)
+{
+  binlog::EventStream eventStream;
+  binlog::PrettyPrinter pp("%m", "");
+
+  std::vector<std::string> result;
+  while (const binlog::Event* event = eventStream.nextEvent(input))
+  {
+    std::ostringstream str;
+    pp.printEvent(str, *event, eventStream.writerProp(), eventStream.clockSync());
+    result.push_back(str.str());
+  }
+  return result;
+}
+
+std::size_t countCompressedFrames(const std::string& buffer)
+{
+  std::istringstream stream(buffer);
+  binlog::IstreamEntryStream entryStream(stream);
+
+  std::size_t result = 0;
+  binlog::Range payload = entryStream.nextEntryPayload();
+  while (! payload.empty())
+  {
+    if (payload.read<std::uint64_t>() == binlog::CompressedFrame::Tag) { ++result; }
+    payload = entryStream.nextEntryPayload();
+  }
+  return result;
+}
+
+std::vector<std::string> expectedEvents(int count)
+{
+  std::vector<std::string> result;
+  for (int i = 0; i < count; ++i)
+  {
+    result.push_back("Hello compressed " + std::to_string(i) + " " + std::string(std::size_t(i % 17), 'x'));
+  }
+  return result;
+}
+
+std::string writeCompressedLog(binlog::Codec codec, int eventCount)
+{
+  // the event source is added to the first session only, keep that
+  static binlog::Session session;
+  static binlog::SessionWriter writer(session, 1 << 12);
+
+  std::ostringstream out;
+  {
+    binlog::CompressedOutputStream compressed(out, codec, 1024);
+    session.reconsumeMetadata(compressed);
+    for (int i = 0; i < eventCount; ++i)
+    {
+      BINLOG_INFO_W(writer, "Hello compressed {} {}", i, std::string(std::size_t(i % 17), 'x'));
+      if (i % 10 == 9) { session.consume(compressed); }
+    }
+    session.consume(compressed);
+  } // destructor flushes
+
+  return out.str();
+}
+
+/** @returns the offset of the end of the entry at `offset` in `buffer` */
+std::size_t entryEnd(const std::string& buffer, std::size_t offset)
+{
+  std::uint32_t size;
+  memcpy(&size, buffer.data() + offset, sizeof(size));
+  return offset + sizeof(size) + size;
+}
+
+/** @returns the offsets of the entries with `tag` in `buffer` */
+std::vector<std::size_t> entryOffsets(const std::string& buffer, std::uint64_t tag)
+{
+  std::vector<std::size_t> result;
+  for (std::size_t offset = 0; offset < buffer.size(); offset = entryEnd(buffer, offset))
+  {
+    std::uint64_t entryTag;
+    memcpy(&entryTag, buffer.data() + offset + sizeof(std::uint32_t), sizeof(entryTag));
+    if (entryTag == tag) { result.push_back(offset); }
+  }
+  return result;
+}
+
+std::vector<std::string> readCheckedEvents(const std::string& log, std::size_t& skippedBytes)
+{
+  std::istringstream input(log);
+  binlog::CheckedIstreamEntryStream checkedEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(checkedEntryStream);
+  std::vector<std::string> result = readEvents(entryStream);
+  skippedBytes = checkedEntryStream.skippedBytes();
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("lz4_roundtrip")
+{
+  const std::vector<char> empty;
+  CHECK(roundtrip(binlog::Codec::lz4, empty) == empty);
+
+  for (const std::size_t size : {std::size_t(1), std::size_t(12), std::size_t(13), std::size_t(1000), std::size_t(100000)})
+  {
+    const std::vector<char> random = randomBytes(size);
+    CHECK(roundtrip(binlog::Codec::lz4, random) == random);
+
+    const std::vector<char> repetitive = repetitiveBytes(size);
+    CHECK(roundtrip(binlog::Codec::lz4, repetitive) == repetitive);
+  }
+
+  // repetitive data is actually compressed
+  const std::vector<char> input = repetitiveBytes(10000);
+  std::vector<char> compressed(binlog::detail::compressBound(binlog::Codec::lz4, input.size()));
+  const std::size_t size = binlog::detail::compress(binlog::Codec::lz4, input.data(), input.size(), compressed.data(), compressed.size());
+  CHECK(size < input.size() / 10);
+}
+
+TEST_CASE("lz4_invalid_input")
+{
+  std::vector<char> output(100);
+
+  // literal length exceeds input
+  const std::vector<char> truncated{'\x50', 'a', 'b'};
+  CHECK_THROWS_AS(binlog::detail::decompress(binlog::Codec::lz4, truncated.data(), truncated.size(), output.data(), output.size()), std::runtime_error);
+
+  // offset points before the beginning of the output
+  const std::vector<char> badOffset{'\x10', 'a', '\x05', '\x00'};
+  CHECK_THROWS_AS(binlog::detail::decompress(binlog::Codec::lz4, badOffset.data(), badOffset.size(), output.data(), output.size()), std::runtime_error);
+
+  // decompressed size mismatch
+  const std::vector<char> input = repetitiveBytes(1000);
+  std::vector<char> compressed(binlog::detail::compressBound(binlog::Codec::lz4, input.size()));
+  compressed.resize(binlog::detail::compress(binlog::Codec::lz4, input.data(), input.size(), compressed.data(), compressed.size()));
+  CHECK_THROWS_AS(binlog::detail::decompress(binlog::Codec::lz4, compressed.data(), compressed.size(), output.data(), output.size()), std::runtime_error);
+}
+
+TEST_CASE("zlib_roundtrip")
+{
+  if (! binlog::isCodecAvailable(binlog::Codec::zlib))
+  {
+    CHECK_THROWS_AS(binlog::CompressedOutputStream(std::cout, binlog::Codec::zlib), std::runtime_error);
+    return;
+  }
+
+  const std::vector<char> random = randomBytes(10000);
+  CHECK(roundtrip(binlog::Codec::zlib, random) == random);
+
+  const std::vector<char> repetitive = repetitiveBytes(10000);
+  CHECK(roundtrip(binlog::Codec::zlib, repetitive) == repetitive);
+
+  const std::string log = writeCompressedLog(binlog::Codec::zlib, 100);
+  std::istringstream input(log);
+  binlog::IstreamEntryStream istreamEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(istreamEntryStream);
+  CHECK(readEvents(entryStream) == expectedEvents(100));
+}
+
+TEST_CASE("compressed_events")
+{
+  const int eventCount = 500;
+  const std::string log = writeCompressedLog(binlog::Codec::lz4, eventCount);
+
+  // every entry is compressed, in multiple frames
+  CHECK(countCompressedFrames(log) > 1);
+  {
+    std::istringstream input(log);
+    binlog::IstreamEntryStream entryStream(input);
+    CHECK(readEvents(entryStream).empty());
+  }
+
+  for (const unsigned threadCount : {1u, 4u})
+  {
+    std::istringstream input(log);
+    binlog::IstreamEntryStream istreamEntryStream(input);
+    binlog::DecompressedEntryStream entryStream(istreamEntryStream, threadCount);
+    CHECK(readEvents(entryStream) == expectedEvents(eventCount));
+  }
+}
+
+TEST_CASE("uncompressed_events")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 1 << 12);
+
+  std::ostringstream out;
+  for (int i = 0; i < 20; ++i)
+  {
+    BINLOG_INFO_W(writer, "Hello compressed {} {}", i, std::string(std::size_t(i % 17), 'x'));
+  }
+  session.consume(out);
+
+  for (const unsigned threadCount : {1u, 4u})
+  {
+    std::istringstream input(out.str());
+    binlog::IstreamEntryStream istreamEntryStream(input);
+    binlog::DecompressedEntryStream entryStream(istreamEntryStream, threadCount);
+    CHECK(readEvents(entryStream) == expectedEvents(20));
+  }
+}
+
+TEST_CASE("flush")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 1 << 12);
+
+  std::ostringstream out;
+  binlog::CompressedOutputStream compressed(out, binlog::Codec::lz4, 1 << 20);
+
+  BINLOG_INFO_W(writer, "Hello compressed {} {}", 0, std::string{});
+  session.consume(compressed);
+  CHECK(out.str().empty()); // frame is not full yet
+
+  compressed.flush();
+  CHECK(countCompressedFrames(out.str()) == 1);
+
+  std::istringstream input(out.str());
+  binlog::IstreamEntryStream istreamEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(istreamEntryStream);
+  CHECK(readEvents(entryStream) == expectedEvents(1));
+}
+
+TEST_CASE("truncated_stream")
+{
+  const std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  REQUIRE(countCompressedFrames(log) > 2);
+
+  // events of complete frames are read, then the error is reported
+  std::istringstream input(log.substr(0, log.size() - 10));
+  binlog::IstreamEntryStream istreamEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(istreamEntryStream, 4);
+  binlog::EventStream eventStream;
+
+  std::size_t eventCount = 0;
+  CHECK_THROWS_AS(
+    while (eventStream.nextEvent(entryStream)) { ++eventCount; },
+    std::runtime_error
+  );
+  CHECK(eventCount > 0);
+  CHECK(eventCount < 500);
+}
+
+TEST_CASE("checked_valid_stream")
+{
+  const std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+
+  std::size_t skippedBytes = 1;
+  CHECK(readCheckedEvents(log, skippedBytes) == expectedEvents(500));
+  CHECK(skippedBytes == 0);
+}
+
+TEST_CASE("checked_corrupt_data")
+{
+  std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  const std::vector<std::size_t> frames = entryOffsets(log, binlog::CompressedFrame::Tag);
+  REQUIRE(frames.size() > 3);
+  const std::size_t frameEnd = entryEnd(log, frames[1]);
+
+  // flip a bit in the data of the second frame: the frame is dropped, the others are read
+  log[frames[1] + 30] = char(log[frames[1] + 30] ^ 0x10);
+
+  std::size_t skippedBytes = 0;
+  const std::vector<std::string> events = readCheckedEvents(log, skippedBytes);
+  const std::vector<std::string> expected = expectedEvents(500);
+  REQUIRE(! events.empty());
+  CHECK(events.size() < expected.size());
+  CHECK(events.front() == expected.front());
+  CHECK(events.back() == expected.back());
+  CHECK(skippedBytes == frameEnd - frames[1]);
+}
+
+TEST_CASE("checked_corrupt_size")
+{
+  std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  const std::vector<std::size_t> frames = entryOffsets(log, binlog::CompressedFrame::Tag);
+  REQUIRE(frames.size() > 3);
+  const std::size_t frameEnd = entryEnd(log, frames[1]);
+
+  // corrupt the size of the second frame, the reader resyncs to the next summary
+  log[frames[1] + 3] = '\x7F';
+
+  std::size_t skippedBytes = 0;
+  const std::vector<std::string> events = readCheckedEvents(log, skippedBytes);
+  const std::vector<std::string> expected = expectedEvents(500);
+  REQUIRE(! events.empty());
+  CHECK(events.size() < expected.size());
+  CHECK(events.back() == expected.back());
+  CHECK(skippedBytes == frameEnd - frames[1]);
+}
+
+TEST_CASE("checked_garbage_between_frames")
+{
+  std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  const std::vector<std::size_t> frames = entryOffsets(log, binlog::CompressedFrame::Tag);
+  REQUIRE(frames.size() > 3);
+
+  const std::uint64_t tag = binlog::CompressedFrame::Tag;
+  std::string garbage(5000, 'x');
+  memcpy(&garbage[100], &tag, sizeof(tag)); // looks like a frame tag, but it is not
+  log.insert(frames[2], garbage);
+  log += "trailing garbage";
+
+  std::size_t skippedBytes = 0;
+  CHECK(readCheckedEvents(log, skippedBytes) == expectedEvents(500));
+  CHECK(skippedBytes == garbage.size() + 16);
+}
+
+TEST_CASE("checked_plain_stream")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 1 << 12);
+
+  std::ostringstream out;
+  for (int i = 0; i < 20; ++i)
+  {
+    BINLOG_INFO_W(writer, "Hello compressed {} {}", i, std::string(std::size_t(i % 17), 'x'));
+  }
+  session.consume(out);
+
+  std::size_t skippedBytes = 0;
+  CHECK(readCheckedEvents(out.str(), skippedBytes) == expectedEvents(20));
+  CHECK(skippedBytes == 0);
+
+  // without checksums, corruption cannot be recovered from
+  CHECK_THROWS_AS(readCheckedEvents(out.str().substr(0, out.str().size() - 3), skippedBytes), std::runtime_error);
+}
+
+TEST_CASE("block_summary")
+{
+  const std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  const std::vector<std::size_t> summaries = entryOffsets(log, binlog::BlockSummary::Tag);
+  const std::vector<std::size_t> frames = entryOffsets(log, binlog::CompressedFrame::Tag);
+  REQUIRE(summaries.size() == frames.size());
+  REQUIRE(frames.size() > 2);
+
+  for (std::size_t i = 0; i < summaries.size(); ++i)
+  {
+    // each summary describes the frame that immediately follows it
+    CHECK(entryEnd(log, summaries[i]) == frames[i]);
+
+    binlog::BlockSummary summary;
+    binlog::Range payload(log.data() + summaries[i] + 12, entryEnd(log, summaries[i]) - summaries[i] - 12);
+    mserialize::deserialize(summary, payload);
+
+    CHECK(summary.blockSize == entryEnd(log, frames[i]) - frames[i]);
+    CHECK(summary.hasMetadata == (i == 0)); // event source and clock sync
+    CHECK(summary.minClock <= summary.maxClock);
+
+    // every event has the same source
+    const std::uint64_t sourceBits = summary.sources[0] | summary.sources[1] | summary.sources[2] | summary.sources[3];
+    CHECK(sourceBits != 0);
+    CHECK((sourceBits & (sourceBits - 1)) == 0);
+
+    if (i != 0)
+    {
+      binlog::BlockSummary prev;
+      binlog::Range prevPayload(log.data() + summaries[i-1] + 12, entryEnd(log, summaries[i-1]) - summaries[i-1] - 12);
+      mserialize::deserialize(prev, prevPayload);
+      CHECK(prev.maxClock <= summary.minClock);
+    }
+  }
+}
+
+TEST_CASE("block_filter")
+{
+  const std::string log = writeCompressedLog(binlog::Codec::lz4, 500);
+  const std::size_t frameCount = entryOffsets(log, binlog::CompressedFrame::Tag).size();
+
+  for (const unsigned threadCount : {1u, 4u})
+  {
+    std::istringstream input(log);
+    binlog::IstreamEntryStream istreamEntryStream(input);
+    binlog::DecompressedEntryStream entryStream(istreamEntryStream, threadCount);
+
+    // skip every frame except the first (that has the metadata) and the last
+    std::size_t summaryCount = 0;
+    entryStream.setBlockFilter([&](const binlog::BlockSummary&) { return ++summaryCount == frameCount - 1; });
+
+    const std::vector<std::string> events = readEvents(entryStream);
+    const std::vector<std::string> expected = expectedEvents(500);
+    REQUIRE(! events.empty());
+    CHECK(events.size() < expected.size());
+    CHECK(events.front() == expected.front());
+    CHECK(events.back() == expected.back());
+    CHECK(summaryCount == frameCount - 1); // not called for the first frame
+    CHECK(entryStream.skippedFrames() == frameCount - 2);
+  }
+}
+
+TEST_CASE("batch_written_in_two_parts")
+{
+  // Session::consume writes the batch in two parts, if the queue data wraps around
+  std::vector<char> batch;
+  binlog::detail::VectorOutputStream entry;
+  for (std::uint64_t clock = 0; clock < 8; ++clock)
+  {
+    entry.clear();
+    const std::uint32_t size = sizeof(std::uint64_t) * 2 + 16;
+    mserialize::serialize(size, entry);
+    mserialize::serialize(std::uint64_t(0), entry); // source id
+    mserialize::serialize(clock, entry);
+    entry.write("0123456789abcdef", 16);
+    batch.insert(batch.end(), entry.vector.begin(), entry.vector.end());
+  }
+  const std::size_t firstPartSize = batch.size() / 2;
+
+  binlog::detail::VectorOutputStream writerProp;
+  binlog::serializeSizePrefixedTagged(binlog::WriterProp{1, "w", batch.size()}, writerProp);
+
+  std::ostringstream out;
+  {
+    binlog::CompressedOutputStream compressed(out, binlog::Codec::lz4, 64);
+    for (int i = 0; i < 3; ++i)
+    {
+      compressed.write(writerProp.data(), writerProp.ssize());
+      compressed.write(batch.data(), std::streamsize(firstPartSize));
+      compressed.write(batch.data() + firstPartSize, std::streamsize(batch.size() - firstPartSize));
+    }
+  }
+
+  // each frame starts with the WriterProp, and has the complete batch
+  CHECK(entryOffsets(out.str(), binlog::CompressedFrame::Tag).size() == 3);
+}
+
+TEST_CASE("filtered_events")
+{
+  // EventFilter writes each WriterProp separately, with the unfiltered batchSize
+  struct FilteredOutputStream
+  {
+    binlog::CompressedOutputStream& out;
+    binlog::EventFilter filter{[](const binlog::EventSourceView& source) { return source.severity >= binlog::Severity::info; }};
+
+    explicit FilteredOutputStream(binlog::CompressedOutputStream& out_) : out(out_) {}
+
+    FilteredOutputStream& write(const char* buffer, std::streamsize size)
+    {
+      filter.writeAllowed(buffer, std::size_t(size), out);
+      return *this;
+    }
+  };
+
+  binlog::Session session;
+  binlog::SessionWriter w0(session, 1 << 12, 0, "w0");
+  binlog::SessionWriter w1(session, 1 << 12, 1, "w1");
+
+  std::ostringstream out;
+  {
+    binlog::CompressedOutputStream compressed(out, binlog::Codec::lz4, 256);
+    FilteredOutputStream filtered(compressed);
+    for (int i = 0; i < 200; ++i)
+    {
+      BINLOG_INFO_W(w0, "w0 {}", i);
+      BINLOG_DEBUG_W(w0, "debug {}", i);
+      BINLOG_INFO_W(w1, "w1 {}", i);
+      BINLOG_DEBUG_W(w1, "debug {}", i);
+      if (i % 10 == 9) { session.consume(filtered); }
+    }
+  }
+
+  const std::string log = out.str();
+  REQUIRE(entryOffsets(log, binlog::CompressedFrame::Tag).size() > 4);
+
+  std::istringstream input(log);
+  binlog::IstreamEntryStream istreamEntryStream(input);
+  binlog::DecompressedEntryStream entryStream(istreamEntryStream);
+
+  // every event must be attributed to its writer, even if the frame of a WriterProp is skipped
+  std::size_t summaryCount = 0;
+  entryStream.setBlockFilter([&](const binlog::BlockSummary&) { return ++summaryCount % 2 == 0; });
+
+  binlog::EventStream eventStream;
+  binlog::PrettyPrinter pp("%n %m", "");
+  std::size_t eventCount = 0;
+  while (const binlog::Event* event = eventStream.nextEvent(entryStream))
+  {
+    std::ostringstream str;
+    pp.printEvent(str, *event, eventStream.writerProp(), eventStream.clockSync());
+    const std::string line = str.str();
+    CHECK(line.substr(0, 2) == line.substr(3, 2));
+    ++eventCount;
+  }
+  CHECK(eventCount != 0);
+  CHECK(entryStream.skippedFrames() != 0);
+}
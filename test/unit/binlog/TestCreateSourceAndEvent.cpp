@@ -166,6 +166,32 @@ TEST_CASE("two_threads")
   CHECK(streamToEvents(stream, "%m") == expectedEvents);
 }
 
+TEST_CASE("args_evaluated_once")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+
+  int counter = 0;
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, category, 0, "{}", ++counter);
+  CHECK(counter == 1);
+  CHECK(getEvents(session, "%m") == std::vector<std::string>{"1"});
+}
+
+TEST_CASE("priority_lane")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+  writer.setPriorityLane(binlog::Severity::error, 128);
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, category, 0, "Info");
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, category, 0, "Error");
+
+  // the event of the priority lane is consumed first
+  TestStream stream;
+  session.consume(stream);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"Error", "Info"});
+}
+
 static_assert(binlog::detail::count_placeholders("") == 0, "");
 static_assert(binlog::detail::count_placeholders("foo") == 0, "");
 static_assert(binlog::detail::count_placeholders("foo {") == 0, "");
@@ -89,3 +89,45 @@ TEST_CASE("allow_some")
   };
   CHECK(filterEvents(session, filter) == expectedEvents2);
 }
+
+TEST_CASE("allow_some_by_view")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventFilter filter([](const binlog::EventSourceView& source){
+    return source.formatString.find("keep") != mserialize::string_view::npos;
+  });
+
+  BINLOG_INFO_W(writer, "drop {}", 1);
+  BINLOG_INFO_W(writer, "keep {}", 2);
+  BINLOG_WARN_W(writer, "drop {}", 3);
+  BINLOG_WARN_W(writer, "keep {}", 4);
+
+  const std::vector<std::string> expectedEvents{
+    "INFO keep 2", "WARN keep 4",
+  };
+  CHECK(filterEvents(session, filter) == expectedEvents);
+}
+
+TEST_CASE("allow_some_delta_encoded")
+{
+  binlog::Session session;
+  session.setClockDeltaEncoding(true);
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventFilter filter([](const binlog::EventSource& source){ return source.severity >= binlog::Severity::info; });
+
+  BINLOG_DEBUG_W(writer, "Hello");
+  CHECK(filterEvents(session, filter) == std::vector<std::string>{});
+
+  for (int i = 0; i < 4; ++i)
+  {
+    BINLOG_DEBUG_W(writer, "i={}", i);
+    BINLOG_INFO_W(writer, "i={}", i);
+  }
+  const std::vector<std::string> expectedEvents{
+    "INFO i=0", "INFO i=1", "INFO i=2", "INFO i=3",
+  };
+  CHECK(filterEvents(session, filter) == expectedEvents);
+}
@@ -427,3 +427,47 @@ TEST_CASE("unknown_specials_are_ignored")
   REQUIRE(e1->source != nullptr);
   CHECK(*e1->source == eventSource);
 }
+
+TEST_CASE("event_source_view")
+{
+  const binlog::EventSource eventSource = testEventSource(123, "foo");
+
+  TestStream stream;
+  serializeSizePrefixedTagged(eventSource, stream);
+
+  binlog::Range payload = stream.nextEntryPayload();
+  CHECK(payload.read<std::uint64_t>() == std::uint64_t(binlog::EventSource::Tag));
+  const char* payloadBegin = payload.view(0);
+  const char* payloadEnd = payloadBegin + payload.size();
+
+  const binlog::EventSourceView view = binlog::deserializeEventSourceView(payload);
+  CHECK(payload.empty());
+  CHECK(view.id == eventSource.id);
+  CHECK(view.severity == eventSource.severity);
+  CHECK(view.category == eventSource.category);
+  CHECK(view.function == eventSource.function);
+  CHECK(view.file == eventSource.file);
+  CHECK(view.line == eventSource.line);
+  CHECK(view.formatString == eventSource.formatString);
+  CHECK(view.argumentTags == eventSource.argumentTags);
+
+  // strings are not copied
+  CHECK(view.formatString.data() > payloadBegin);
+  CHECK(view.formatString.data() < payloadEnd);
+
+  CHECK(binlog::toEventSource(view) == eventSource);
+}
+
+TEST_CASE("event_source_view_truncated")
+{
+  const binlog::EventSource eventSource = testEventSource(123, "foo");
+
+  TestStream stream;
+  serializeSizePrefixedTagged(eventSource, stream);
+
+  binlog::Range payload = stream.nextEntryPayload();
+  payload.read<std::uint64_t>(); // tag
+  const std::size_t size = payload.size();
+  binlog::Range truncated(payload.view(size), size - 1);
+  CHECK_THROWS_AS(binlog::deserializeEventSourceView(truncated), std::runtime_error);
+}
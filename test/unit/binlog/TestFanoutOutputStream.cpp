@@ -0,0 +1,188 @@
+#include <binlog/FanoutOutputStream.hpp>
+
+#include <binlog/Entries.hpp>
+#include <binlog/EventFilter.hpp>
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/Severity.hpp>
+#include <binlog/advanced_log_macros.hpp>
+
+#include "test_utils.hpp"
+
+#include <doctest/doctest.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+binlog::FanoutOutputStream::Sink toStream(TestStream& stream)
+{
+  return [&stream](const char* buffer, std::size_t size)
+  {
+    stream.write(buffer, std::streamsize(size));
+  };
+}
+
+/** Blocks the sink until opened */
+class Gate
+{
+public:
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return _open; });
+  }
+
+  void open()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _open = true;
+    }
+    _cv.notify_all();
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  bool _open = false;
+};
+
+std::vector<std::string> expectedEvents(int begin, int end)
+{
+  std::vector<std::string> result;
+  for (int i = begin; i < end; ++i) { result.push_back("Hello " + std::to_string(i)); }
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("fanout_to_sinks")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  TestStream all;
+  TestStream errors;
+  binlog::EventFilter filter([](const binlog::EventSourceView& source) {
+    return source.severity >= binlog::Severity::error;
+  });
+
+  binlog::FanoutOutputStream out(64);
+  CHECK(out.addSink(toStream(all), binlog::FanoutOutputStream::OverflowPolicy::block) == 0);
+  CHECK(out.addSink(
+    [&](const char* buffer, std::size_t size) { filter.writeAllowed(buffer, size, errors); },
+    binlog::FanoutOutputStream::OverflowPolicy::block
+  ) == 1);
+  CHECK(out.sinkCount() == 2);
+
+  for (int i = 0; i < 10; ++i)
+  {
+    BINLOG_INFO_W(writer, "Hello {}", i);
+    BINLOG_ERROR_W(writer, "Hello {}", i);
+    session.consume(out);
+    out.flush();
+  }
+  out.drain();
+
+  std::vector<std::string> expectedAll;
+  for (int i = 0; i < 10; ++i)
+  {
+    expectedAll.push_back("INFO Hello " + std::to_string(i));
+    expectedAll.push_back("ERRO Hello " + std::to_string(i));
+  }
+  CHECK(streamToEvents(all, "%S %m") == expectedAll);
+
+  std::vector<std::string> expectedErrors;
+  for (int i = 0; i < 10; ++i) { expectedErrors.push_back("ERRO Hello " + std::to_string(i)); }
+  CHECK(streamToEvents(errors, "%S %m") == expectedErrors);
+
+  CHECK(out.droppedBytes(0) == 0);
+  CHECK(out.droppedBytes(1) == 0);
+  CHECK(out.error(0) == nullptr);
+
+  CHECK_THROWS_AS(out.addSink(toStream(all), binlog::FanoutOutputStream::OverflowPolicy::drop), std::logic_error);
+}
+
+TEST_CASE("fanout_drop_keeps_metadata")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  TestStream primary;
+  TestStream secondary;
+  Gate gate;
+
+  binlog::FanoutOutputStream out;
+  out.addSink(toStream(primary), binlog::FanoutOutputStream::OverflowPolicy::block);
+  out.addSink(
+    [&](const char* buffer, std::size_t size) {
+      gate.wait();
+      secondary.write(buffer, std::streamsize(size));
+    },
+    binlog::FanoutOutputStream::OverflowPolicy::drop,
+    1
+  );
+
+  // the secondary sink is blocked, the primary is not slowed down
+  for (int i = 0; i < 100; ++i)
+  {
+    BINLOG_INFO_W(writer, "Hello {}", i);
+    session.consume(out);
+    out.flush();
+  }
+  CHECK(out.droppedBytes(1) != 0);
+
+  // the backlog is full, the rest is dropped, but the metadata is retained
+  gate.open();
+  out.drain();
+
+  // events written after the drops, of a new source, are readable
+  BINLOG_INFO_W(writer, "Hello {}", 100);
+  session.consume(out);
+  out.drain();
+
+  CHECK(streamToEvents(primary, "%m") == expectedEvents(0, 101));
+  CHECK(out.droppedBytes(0) == 0);
+
+  CHECK(countTags(secondary, binlog::EventSource::Tag) == 2);
+  const std::vector<std::string> events = streamToEvents(secondary, "%m");
+  REQUIRE(events.size() >= 2);
+  CHECK(events.size() < 101);
+  CHECK(events.front() == "Hello 0");
+  CHECK(events.back() == "Hello 100");
+}
+
+TEST_CASE("fanout_sink_error")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  TestStream primary;
+
+  binlog::FanoutOutputStream out;
+  out.addSink(toStream(primary), binlog::FanoutOutputStream::OverflowPolicy::block);
+  out.addSink(
+    [](const char*, std::size_t) { throw std::runtime_error("sink failed"); },
+    binlog::FanoutOutputStream::OverflowPolicy::block
+  );
+
+  for (int i = 0; i < 3; ++i)
+  {
+    BINLOG_INFO_W(writer, "Hello {}", i);
+    session.consume(out);
+    out.flush();
+  }
+  out.drain();
+
+  CHECK(streamToEvents(primary, "%m") == expectedEvents(0, 3));
+  CHECK(out.error(0) == nullptr);
+  REQUIRE(out.error(1) != nullptr);
+  CHECK_THROWS_WITH_AS(std::rethrow_exception(out.error(1)), "sink failed", std::runtime_error);
+  CHECK(out.droppedBytes(1) != 0);
+}
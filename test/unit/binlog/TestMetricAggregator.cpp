@@ -0,0 +1,184 @@
+#include <binlog/MetricAggregator.hpp>
+
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/advanced_log_macros.hpp>
+
+#include "test_utils.hpp"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+auto aggregatorStream(binlog::MetricAggregator& aggregator)
+{
+  return transformStream([&aggregator](const char* buffer, std::size_t size, TestStream& stream) {
+    return aggregator.write(buffer, size, stream);
+  });
+}
+
+std::vector<std::string> aggregateEvents(binlog::Session& session, binlog::MetricAggregator& aggregator)
+{
+  auto out = aggregatorStream(aggregator);
+  session.consume(out);
+  aggregator.flush(out.stream);
+  return streamToEvents(out.stream, "%m");
+}
+
+int selectLatency(const binlog::EventSourceView& source)
+{
+  return (source.category == "latency") ? 1 : -1;
+}
+
+// summaries of the logged latencies: 1..100 in the first interval, 7 in the second
+const std::vector<std::string> g_summaries{
+  "order=* latency=* (count: 100, min: 1, max: 100, mean: 50.5, p50: 51, p90: 90, p99: 98)",
+  "latency=* (count: 1, min: 7, max: 7, mean: 7, p50: 7, p90: 7, p99: 7)",
+};
+
+} // namespace
+
+TEST_CASE("aggregate_none")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::MetricAggregator aggregator([](const binlog::EventSourceView&) { return -1; }, std::chrono::seconds(1));
+
+  BINLOG_INFO_W(writer, "Hello {}", 1);
+  BINLOG_INFO_W(writer, "Hello {}", 2);
+  CHECK(aggregateEvents(session, aggregator) == std::vector<std::string>{"Hello 1", "Hello 2"});
+}
+
+TEST_CASE("aggregate_intervals")
+{
+  binlog::Session session;
+  session.setClockSync(binlog::ClockSync{0, 1000000000, 0, 0, "UTC"});
+  binlog::SessionWriter writer(session, 1 << 16);
+
+  binlog::MetricAggregator aggregator(
+    [](const binlog::EventSourceView& source) {
+      // last argument: each argument tag is a single character
+      return (source.category == "latency") ? int(source.argumentTags.size()) - 1 : -1;
+    },
+    std::chrono::microseconds(1)
+  );
+
+  for (int i = 1; i <= 100; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, std::uint64_t(1000 + i), "order={} latency={}", i * 2, i);
+  }
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 1500, "Hello");
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, 2500, "latency={}", std::uint64_t(7));
+
+  std::vector<std::string> expected{"Hello"};
+  expected.insert(expected.end(), g_summaries.begin(), g_summaries.end());
+  CHECK(aggregateEvents(session, aggregator) == expected);
+}
+
+TEST_CASE("aggregate_keep_events")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::MetricAggregator aggregator(selectLatency, std::chrono::microseconds(1), true);
+
+  for (int i = 1; i <= 2; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, std::uint64_t(1000 + i), "order={} latency={}", i, i * 10);
+  }
+
+  const std::vector<std::string> expected{
+    "order=1 latency=10",
+    "order=2 latency=20",
+    "order=* latency=* (count: 2, min: 10, max: 20, mean: 15, p50: 10.25, p90: 20, p99: 20)",
+  };
+  CHECK(aggregateEvents(session, aggregator) == expected);
+}
+
+TEST_CASE("aggregate_delta_encoded")
+{
+  binlog::Session session;
+  session.setClockDeltaEncoding(true);
+  binlog::SessionWriter writer(session, 1 << 16);
+
+  binlog::MetricAggregator aggregator(
+    [](const binlog::EventSourceView& source) {
+      // last argument: each argument tag is a single character
+      return (source.category == "latency") ? int(source.argumentTags.size()) - 1 : -1;
+    },
+    std::chrono::microseconds(1)
+  );
+
+  for (int i = 1; i <= 100; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, std::uint64_t(1000 + i), "order={} latency={}", i * 2, i);
+  }
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 1500, "Hello");
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, 2500, "latency={}", std::uint64_t(7));
+
+  std::vector<std::string> expected{"Hello"};
+  expected.insert(expected.end(), g_summaries.begin(), g_summaries.end());
+  CHECK(aggregateEvents(session, aggregator) == expected);
+}
+
+TEST_CASE("aggregate_writer_prop_batch_size")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::MetricAggregator aggregator(selectLatency, std::chrono::microseconds(1));
+  auto out = aggregatorStream(aggregator);
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, 1100, "{} latency={}", 1, 10);
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 2100, "Hello");
+  session.consume(out);
+
+  // the events of the WriterProp are changed, their size is not known
+  CHECK(writerPropBatchSizes(out.stream) == std::vector<std::uint64_t>{0});
+  CHECK(streamToEvents(out.stream, "%m") == std::vector<std::string>{"Hello"});
+}
+
+TEST_CASE("aggregate_completed_intervals_on_consume")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::MetricAggregator aggregator(selectLatency, std::chrono::microseconds(1));
+  auto out = aggregatorStream(aggregator);
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, latency, 1100, "{} latency={}", 1, 10);
+  session.consume(out);
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 2100, "Hello");
+  session.consume(out);
+  session.consume(out); // no data, no WriterProp
+
+  // the first interval is complete, summarized before the next WriterProp
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 2200, "World");
+  session.consume(out);
+
+  const std::vector<std::string> expected{
+    "Hello",
+    "* latency=* (count: 1, min: 10, max: 10, mean: 10, p50: 10, p90: 10, p99: 10)",
+    "World",
+  };
+  CHECK(streamToEvents(out.stream, "%m") == expected);
+}
+
+TEST_CASE("aggregate_not_arithmetic")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::MetricAggregator aggregator([](const binlog::EventSourceView&) { return 0; }, std::chrono::seconds(1));
+
+  BINLOG_INFO_W(writer, "Hello {}", std::string("World"));
+  BINLOG_INFO_W(writer, "Hello");
+  CHECK(aggregateEvents(session, aggregator) == std::vector<std::string>{"Hello World", "Hello"});
+}
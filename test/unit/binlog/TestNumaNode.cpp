@@ -0,0 +1,10 @@
+#include <binlog/NumaNode.hpp>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("current_numa_node")
+{
+  const std::size_t count = binlog::numaNodeCount();
+  CHECK(count >= 1);
+  CHECK(binlog::currentNumaNode() < count);
+}
@@ -1,12 +1,15 @@
 #include <binlog/PrettyPrinter.hpp>
 
 #include <binlog/Entries.hpp>
+#include <binlog/EntryStream.hpp>
+#include <binlog/EventStream.hpp>
 #include <binlog/Range.hpp>
 
 #include <mserialize/serialize.hpp>
 
 #include <doctest/doctest.h>
 
+#include <cstdint>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -42,6 +45,33 @@ struct TestcaseBase
   }
 };
 
+/**
+ * Read `entry`, `eventSource` and an event of it with `arguments` by an EventStream,
+ * @returns the message of the event printed with the tables of the EventStream.
+ */
+template <typename Entry>
+std::string printWithEntry(const Entry& entry, const binlog::EventSource& eventSource, const std::string& arguments)
+{
+  std::ostringstream entries;
+  binlog::serializeSizePrefixedTagged(entry, entries);
+  binlog::serializeSizePrefixedTagged(eventSource, entries);
+  mserialize::serialize(std::uint32_t(2 * sizeof(std::uint64_t) + arguments.size()), entries);
+  mserialize::serialize(eventSource.id, entries);
+  mserialize::serialize(std::uint64_t(0), entries); // clock
+  entries.write(arguments.data(), std::streamsize(arguments.size()));
+  const std::string buffer = entries.str();
+
+  binlog::RangeEntryStream entryStream(binlog::Range(buffer.data(), buffer.size()));
+  binlog::EventStream eventStream;
+  const binlog::Event* event = eventStream.nextEvent(entryStream);
+  REQUIRE(event != nullptr);
+
+  binlog::PrettyPrinter pp("%m", "");
+  std::ostringstream str;
+  pp.printEvent(str, *event, eventStream);
+  return str.str();
+}
+
 } // namespace
 
 TEST_CASE_FIXTURE(TestcaseBase, "empty_fmt")
@@ -228,3 +258,56 @@ TEST_CASE_FIXTURE(TestcaseBase, "inline_time_utc_if_u")
     "1970-01-01 00:00:00.000000789 +0000 UTC"  // %m
   );
 }
+
+TEST_CASE("literal")
+{
+  std::ostringstream argsBufferStream;
+  mserialize::serialize(std::uint64_t(0x1234), argsBufferStream);
+  mserialize::serialize(std::uint64_t(0x5678), argsBufferStream);
+  const std::string argsBuffer = argsBufferStream.str();
+
+  const binlog::EventSource eventSource{
+    123, binlog::Severity::info, "cat", "func", "file", 456, "a: {}, b: {}",
+    "{binlog::literal`value'L}{binlog::literal`value'L}"
+  };
+  const binlog::LiteralString literal{0x1234, "foo"};
+
+  // unknown addresses are shown as addresses
+  CHECK(printWithEntry(literal, eventSource, argsBuffer) == "a: foo, b: 0x5678");
+}
+
+TEST_CASE("interned")
+{
+  std::ostringstream argsBufferStream;
+  mserialize::serialize(std::uint64_t(1), argsBufferStream);
+  mserialize::serialize(std::uint64_t(2), argsBufferStream);
+  const std::string argsBuffer = argsBufferStream.str();
+
+  const binlog::EventSource eventSource{
+    123, binlog::Severity::info, "cat", "func", "file", 456, "a: {}, b: {}",
+    "{binlog::interned`id'L}{binlog::interned`id'L}"
+  };
+  const binlog::InternedString interned{1, "foo"};
+
+  // unknown ids are shown as ids
+  CHECK(printWithEntry(interned, eventSource, argsBuffer) == "a: foo, b: {interned:2}");
+}
+
+TEST_CASE("error_code")
+{
+  std::ostringstream argsBufferStream;
+  mserialize::serialize(std::uint64_t(0x1234), argsBufferStream);
+  mserialize::serialize(std::int32_t(2), argsBufferStream);
+  mserialize::serialize(std::uint64_t(0x1234), argsBufferStream);
+  mserialize::serialize(std::int32_t(3), argsBufferStream);
+  const std::string argsBuffer = argsBufferStream.str();
+
+  const binlog::EventSource eventSource{
+    123, binlog::Severity::info, "cat", "func", "file", 456, "a: {}, b: {}",
+    "{std::error_code`category'L`value'i}{std::error_code`category'L`value'i}"
+  };
+  const binlog::ErrorCodeMessage message{0x1234, 2, "No such file"};
+
+  // unknown error codes are shown as values
+  CHECK(printWithEntry(message, eventSource, argsBuffer) == "a: No such file, b: {error_code:3}");
+}
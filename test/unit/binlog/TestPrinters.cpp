@@ -1,11 +1,14 @@
 #include <printers.hpp>
 
+#include <binlog/CompressedOutputStream.hpp>
 #include <binlog/Session.hpp>
 #include <binlog/SessionWriter.hpp>
 #include <binlog/advanced_log_macros.hpp>
 
 #include <doctest/doctest.h>
 
+#include <chrono>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -77,3 +80,106 @@ TEST_CASE("print_sorted_events")
   };
   CHECK(streamToLines(txtstream) == expected);
 }
+
+TEST_CASE("print_events_in_time_range")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+  session.setClockSync(binlog::ClockSync{0, 1, 0, 0, "UTC"}); // clock value = seconds since epoch
+
+  std::stringstream binstream;
+  {
+    // small frames: some of them are skipped without decompression
+    binlog::CompressedOutputStream compressed(binstream, binlog::Codec::lz4, 64);
+    for (std::uint64_t clock = 1; clock <= 9; ++clock)
+    {
+      BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, clock, "{}", clock);
+      session.consume(compressed);
+    }
+  }
+
+  TimeRange timeRange;
+  timeRange.from = std::chrono::seconds(3);
+  timeRange.to = std::chrono::seconds(6);
+
+  std::stringstream txtstream;
+  printEvents(binstream, txtstream, "%m\n", "", 1, timeRange);
+
+  const std::vector<std::string> expected{"3", "4", "5", "6"};
+  CHECK(streamToLines(txtstream) == expected);
+}
+
+TEST_CASE("print_trace_events")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512, 7, "w");
+  session.setClockSync(binlog::ClockSync{0, 1000000000, 0, 0, "UTC"}); // clock value = ns since epoch
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 1500, "Hello {}", std::string("World"));
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::warning, cat, 1800, "Quote \" {}", std::string("\n"));
+
+  // scope events are recognized by the marker at the end of the argument tags, see timer_macros.hpp
+  const std::uint64_t spanId = session.addEventSource(binlog::EventSource{
+    0, binlog::Severity::info, "main", "f", "file", 1, "Work {} (span: {}, parent: {}, duration: {} ns)", "iLLL{binlog::span}"
+  });
+  const std::uint64_t timerId = session.addEventSource(binlog::EventSource{
+    0, binlog::Severity::info, "main", "f", "file", 2, "Timed (duration: {} ns)", "L{binlog::scope_timer}"
+  });
+  CHECK(writer.addEvent(spanId, 2000, 5, std::uint64_t(2), std::uint64_t(1), std::uint64_t(3000)));
+  CHECK(writer.addEvent(timerId, 4000, std::uint64_t(1234567)));
+
+  // without the marker, the suffix is part of the message
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 5000, "Took (duration: {} ns)", std::uint64_t(10));
+
+  std::stringstream binstream;
+  session.consume(binstream);
+
+  std::stringstream jsonstream;
+  printTraceEvents(binstream, jsonstream);
+
+  const std::vector<std::string> expected{
+    R"([)",
+    R"({"name":"thread_name","ph":"M","pid":1,"tid":7,"args":{"name":"w"}},)",
+    R"({"name":"Hello World","cat":"main","ph":"i","s":"t","ts":1.500,"pid":1,"tid":7,"args":{"severity":"INFO"}},)",
+    R"({"name":"Quote \" \n","cat":"cat","ph":"i","s":"t","ts":1.800,"pid":1,"tid":7,"args":{"severity":"WARN"}},)",
+    R"({"name":"Work 5","cat":"main","ph":"X","ts":2.000,"dur":3.000,"pid":1,"tid":7,"args":{"severity":"INFO","span":2,"parent":1}},)",
+    R"({"name":"Timed","cat":"main","ph":"X","ts":4.000,"dur":1234.567,"pid":1,"tid":7,"args":{"severity":"INFO"}},)",
+    R"_({"name":"Took (duration: 10 ns)","cat":"main","ph":"i","s":"t","ts":5.000,"pid":1,"tid":7,"args":{"severity":"INFO"}})_",
+    R"(])",
+  };
+  CHECK(streamToLines(jsonstream) == expected);
+}
+
+TEST_CASE("print_trace_events_empty")
+{
+  std::stringstream binstream;
+  std::stringstream jsonstream;
+  printTraceEvents(binstream, jsonstream);
+  CHECK(jsonstream.str() == "[\n]\n");
+}
+
+TEST_CASE("print_trace_events_invalid_utf8")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512, 7, "w");
+  session.setClockSync(binlog::ClockSync{0, 1000000000, 0, 0, "UTC"}); // clock value = ns since epoch
+
+  // valid, invalid byte, truncated sequence, surrogate, valid 4 byte sequence
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 1000,
+    "{}", std::string("\xc3\xa9 \xff \xe2\x82 \xed\xa0\x80 \xf0\x9f\x98\x80"));
+
+  std::stringstream binstream;
+  session.consume(binstream);
+
+  std::stringstream jsonstream;
+  printTraceEvents(binstream, jsonstream);
+
+  const std::vector<std::string> expected{
+    R"([)",
+    R"({"name":"thread_name","ph":"M","pid":1,"tid":7,"args":{"name":"w"}},)",
+    "{\"name\":\"\xc3\xa9 \\ufffd \\ufffd\\ufffd \\ufffd\\ufffd\\ufffd \xf0\x9f\x98\x80\","
+      R"("cat":"main","ph":"i","s":"t","ts":1.000,"pid":1,"tid":7,"args":{"severity":"INFO"}})",
+    R"(])",
+  };
+  CHECK(streamToLines(jsonstream) == expected);
+}
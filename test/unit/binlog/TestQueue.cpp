@@ -271,3 +271,26 @@ TEST_CASE("transmit_more")
     }
   }
 }
+
+TEST_CASE("transmit_more_streaming")
+{
+  // every message is written by streaming stores, if available
+  for (const unsigned queue_size : {4096U, 1U << 20})
+  {
+    for (const unsigned max_msg_size : {64U, 1000U})
+    {
+      std::vector<char> buffer(queue_size);
+      binlog::detail::Queue q(buffer.data(), queue_size);
+      binlog::detail::QueueReader r(q);
+      binlog::detail::QueueWriter w(q, /*streamingThreshold=*/ 0);
+
+      const int msg_count = 100'000;
+
+      std::thread reader(read_messages, std::ref(r), msg_count, max_msg_size);
+
+      write_messages(w, msg_count, max_msg_size);
+
+      reader.join();
+    }
+  }
+}
@@ -0,0 +1,179 @@
+#include <binlog/RepeatedEventFilter.hpp>
+
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/advanced_log_macros.hpp>
+
+#include "test_utils.hpp"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+auto filterStream(binlog::RepeatedEventFilter& filter)
+{
+  return transformStream([&filter](const char* buffer, std::size_t size, TestStream& stream) {
+    return filter.write(buffer, size, stream);
+  });
+}
+
+std::vector<std::string> filterEvents(binlog::Session& session, binlog::RepeatedEventFilter& filter)
+{
+  auto out = filterStream(filter);
+  session.consume(out);
+  filter.flush(out.stream);
+  return streamToEvents(out.stream, "%n %m");
+}
+
+// clock value = nanoseconds since epoch
+const binlog::ClockSync g_clockSync{0, 1000000000, 0, 0, "UTC"};
+
+} // namespace
+
+TEST_CASE("no_repeats")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, 1, "Connection refused: {}", 1);
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, 2, "Connection refused: {}", 2);
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 3, "Other");
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, 4, "Connection refused: {}", 2);
+
+  const std::vector<std::string> expected{
+    " Connection refused: 1",
+    " Connection refused: 2",
+    " Other",
+    " Connection refused: 2",
+  };
+  CHECK(filterEvents(session, filter) == expected);
+}
+
+TEST_CASE("collapse_repeats")
+{
+  binlog::Session session;
+  session.setClockSync(g_clockSync);
+  binlog::SessionWriter writer(session, 4096);
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+
+  for (std::uint64_t i = 0; i < 50; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, i * 1000000, "Connection refused: {}", 111);
+  }
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 60000000, "Other");
+  for (std::uint64_t i = 7; i <= 8; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, i * 10000000, "Connection refused: {}", 111);
+  }
+
+  const std::vector<std::string> expected{
+    " Connection refused: 111",
+    " Previous event repeated 49 times, last at 1970.01.01 00:00:00",
+    " Other",
+    " Connection refused: 111",
+    " Previous event repeated 1 times, last at 1970.01.01 00:00:00", // written by flush
+  };
+  CHECK(filterEvents(session, filter) == expected);
+}
+
+TEST_CASE("collapse_repeats_in_window")
+{
+  binlog::Session session;
+  session.setClockSync(g_clockSync);
+  binlog::SessionWriter writer(session, 4096);
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+
+  // a new run starts after each second
+  for (std::uint64_t i = 0; i < 5; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, i * 600000000, "Connection refused: {}", 111);
+  }
+
+  const std::vector<std::string> expected{
+    " Connection refused: 111",
+    " Previous event repeated 1 times, last at 1970.01.01 00:00:00",
+    " Connection refused: 111",
+    " Previous event repeated 1 times, last at 1970.01.01 00:00:01",
+    " Connection refused: 111",
+  };
+  CHECK(filterEvents(session, filter) == expected);
+}
+
+TEST_CASE("collapse_repeats_writer_prop_batch_size")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 4096);
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+  auto out = filterStream(filter);
+
+  for (std::uint64_t i = 0; i < 3; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, i, "Connection refused: {}", 111);
+  }
+  session.consume(out);
+
+  // the events of the WriterProp are changed, their size is not known
+  CHECK(writerPropBatchSizes(out.stream) == std::vector<std::uint64_t>{0});
+  CHECK(streamToEvents(out.stream, "%m") == std::vector<std::string>{"Connection refused: 111"});
+}
+
+TEST_CASE("collapse_repeats_per_writer")
+{
+  binlog::Session session;
+  binlog::SessionWriter w1(session, 4096, 1, "w1");
+  binlog::SessionWriter w2(session, 4096, 2, "w2");
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+  auto out = filterStream(filter);
+
+  for (std::uint64_t i = 1; i <= 3; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(w1, binlog::Severity::error, main, i, "Connection refused: {}", 1);
+    BINLOG_CREATE_SOURCE_AND_EVENT(w2, binlog::Severity::error, main, i, "Connection refused: {}", 2);
+    session.consume(out);
+  }
+
+  // the run of w1 ends by a different event,
+  // the run of w2 ends when its window is over
+  BINLOG_CREATE_SOURCE_AND_EVENT(w1, binlog::Severity::info, main, 2000000000, "Other");
+  session.consume(out);
+  BINLOG_CREATE_SOURCE_AND_EVENT(w1, binlog::Severity::error, main, 2000000001, "Connection refused: {}", 3);
+  session.consume(out);
+
+  const std::vector<std::string> expected{
+    "w1 Connection refused: 1",
+    "w2 Connection refused: 2",
+    "w1 Previous event repeated 2 times, last at 1970.01.01 00:00:00",
+    "w1 Other",
+    "w2 Previous event repeated 2 times, last at 1970.01.01 00:00:00",
+    "w1 Connection refused: 3",
+  };
+  CHECK(streamToEvents(out.stream, "%n %m") == expected);
+}
+
+TEST_CASE("collapse_repeats_delta_encoded")
+{
+  binlog::Session session;
+  session.setClockSync(g_clockSync);
+  session.setClockDeltaEncoding(true);
+  binlog::SessionWriter writer(session, 4096);
+  binlog::RepeatedEventFilter filter(std::chrono::seconds(1));
+
+  for (std::uint64_t i = 0; i < 10; ++i)
+  {
+    BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::error, main, 1000000000 + i, "Connection refused: {}", 111);
+  }
+  BINLOG_CREATE_SOURCE_AND_EVENT(writer, binlog::Severity::info, main, 1500000000, "Other");
+
+  const std::vector<std::string> expected{
+    " Connection refused: 111",
+    " Previous event repeated 9 times, last at 1970.01.01 00:00:01",
+    " Other",
+  };
+  CHECK(filterEvents(session, filter) == expected);
+}
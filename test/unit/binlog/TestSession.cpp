@@ -1,10 +1,23 @@
 #include <binlog/Session.hpp>
 
 #include <binlog/Entries.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/adapt_stderrorcode.hpp>
+
+#include <mserialize/tag.hpp>
+
+#include "test_utils.hpp"
 
 #include <doctest/doctest.h>
 
+#include <cstdint>
+#include <cstring> // memcpy
 #include <ios> // streamsize
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
 
 namespace {
 
@@ -84,4 +97,469 @@ TEST_CASE("sources_consumed_once")
   CHECK(cr.bytesConsumed == 0);
 }
 
+TEST_CASE("clock_delta_encoding")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 400);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "i";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  const std::uint64_t clocks[] = {
+    1000000, 1000000, 1000100, 999900, 0, std::uint64_t(-1), 1000000 + (std::uint64_t(1) << 40),
+  };
+
+  TestStream plain;
+  for (std::uint64_t clock : clocks) { CHECK(writer.addEvent(sourceId, clock, 123)); }
+  session.consume(plain);
+
+  session.setClockDeltaEncoding(true);
+
+  // consume a few times, to make a batch wrap around the end of the queue
+  TestStream encoded;
+  session.reconsumeMetadata(encoded);
+  for (int i = 0; i < 5; ++i)
+  {
+    for (std::uint64_t clock : clocks) { CHECK(writer.addEvent(sourceId, clock, 123)); }
+    const binlog::Session::ConsumeResult cr = session.consume(encoded);
+    CHECK(cr.bytesConsumed != 0);
+  }
+
+  CHECK(countTags(encoded, binlog::EventBatch::Tag) == 5);
+
+  const std::vector<std::string> expectedEvents{
+    "1000000 123", "1000000 123", "1000100 123", "999900 123",
+    "0 123", "18446744073709551615 123", "1099512627776 123",
+  };
+  CHECK(streamToEvents(plain, "%r %m") == expectedEvents);
+
+  std::vector<std::string> allExpectedEvents;
+  for (int i = 0; i < 5; ++i)
+  {
+    allExpectedEvents.insert(allExpectedEvents.end(), expectedEvents.begin(), expectedEvents.end());
+  }
+  CHECK(streamToEvents(encoded, "%r %m") == allExpectedEvents);
+
+  // close to each other events are smaller
+  session.setClockDeltaEncoding(false);
+  for (int i = 0; i < 8; ++i) { CHECK(writer.addEvent(sourceId, 1000000 + std::uint64_t(i), 123)); }
+  NullOstream out;
+  const std::size_t plainSize = session.consume(out).bytesConsumed;
+
+  session.setClockDeltaEncoding(true);
+  for (int i = 0; i < 8; ++i) { CHECK(writer.addEvent(sourceId, 1000000 + std::uint64_t(i), 123)); }
+  const std::size_t encodedSize = session.consume(out).bytesConsumed;
+
+  CHECK(encodedSize < plainSize);
+}
+
+TEST_CASE("clock_delta_encoding_after_special_entry")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 400);
+  session.setClockDeltaEncoding(true);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "{binlog::interned`id'L}";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  TestStream encoded;
+  session.consume(encoded); // metadata
+
+  // each batch starts with an InternedString entry
+  const std::uint64_t clockBase = std::uint64_t(1) << 60;
+  std::size_t encodedSize = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    const std::string value = "str" + std::to_string(i);
+    for (int j = 0; j < 8; ++j)
+    {
+      CHECK(writer.addEvent(sourceId, clockBase + std::uint64_t(j), binlog::interned(value)));
+    }
+    encodedSize += session.consume(encoded).bytesConsumed;
+  }
+
+  CHECK(countTags(encoded, binlog::EventBatch::Tag) == 3);
+  std::vector<std::string> expectedEvents;
+  for (int i = 0; i < 24; ++i) { expectedEvents.push_back("str" + std::to_string(i / 8)); }
+  CHECK(streamToEvents(encoded, "%m") == expectedEvents);
+
+  // the clock base is taken from the first event, not the InternedString entry
+  session.setClockDeltaEncoding(false);
+  NullOstream out;
+  std::size_t plainSize = 0;
+  for (int i = 3; i < 6; ++i)
+  {
+    const std::string value = "str" + std::to_string(i);
+    for (int j = 0; j < 8; ++j)
+    {
+      CHECK(writer.addEvent(sourceId, clockBase + std::uint64_t(j), binlog::interned(value)));
+    }
+    plainSize += session.consume(out).bytesConsumed;
+  }
+
+  CHECK(encodedSize < plainSize);
+}
+
 // addEventSource and consume are further tested in TestSessionWriter.cpp
+
+TEST_CASE("literals_consumed_once")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{} {} {}";
+  eventSource.argumentTags = "{binlog::literal`value'L}[c{binlog::literal`value'L}";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  const char* foo = "foo";
+  const char* bar = "bar";
+  auto literal = [](const char* str)
+  {
+    std::uint64_t address;
+    memcpy(&address, &str, sizeof(str));
+    return address;
+  };
+
+  TestStream stream;
+  CHECK(writer.addEvent(sourceId, 0, literal(foo), std::string("x"), literal(bar)));
+  CHECK(writer.addEvent(sourceId, 0, literal(bar), std::string("y"), literal(foo)));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::LiteralString::Tag) == 2);
+
+  CHECK(writer.addEvent(sourceId, 0, literal(foo), std::string("z"), literal(foo)));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::LiteralString::Tag) == 2);
+
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"foo x bar", "bar y foo", "foo z foo"});
+
+  // strings are consumed again with the metadata
+  TestStream rotated;
+  session.reconsumeMetadata(rotated);
+  CHECK(countTags(rotated, binlog::LiteralString::Tag) == 2);
+}
+
+TEST_CASE("error_code_messages_consumed_once")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{} {}";
+  eventSource.argumentTags = std::string(mserialize::tag<std::error_code>().data()) + mserialize::tag<std::error_code>().data();
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  const std::error_code ok;
+  const std::error_code inval = std::make_error_code(std::errc::invalid_argument);
+
+  TestStream stream;
+  CHECK(writer.addEvent(sourceId, 0, ok, inval));
+  CHECK(writer.addEvent(sourceId, 0, inval, ok));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::ErrorCodeMessage::Tag) == 2);
+
+  CHECK(writer.addEvent(sourceId, 0, inval, inval));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::ErrorCodeMessage::Tag) == 2);
+
+  const std::string okMessage = ok.message();
+  const std::string invalMessage = inval.message();
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{
+    okMessage + " " + invalMessage,
+    invalMessage + " " + okMessage,
+    invalMessage + " " + invalMessage,
+  });
+
+  // messages are consumed again with the metadata
+  TestStream rotated;
+  session.reconsumeMetadata(rotated);
+  CHECK(countTags(rotated, binlog::ErrorCodeMessage::Tag) == 2);
+}
+
+TEST_CASE("consume_shards")
+{
+  binlog::Session session;
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{} {}";
+  eventSource.argumentTags = "{binlog::literal`value'L}i";
+  const std::uint64_t sourceId1 = session.addEventSource(eventSource);
+
+  session.setShardCount(2);
+  NullOstream out;
+  CHECK_THROWS_AS(session.consumeShard(2, out), std::out_of_range);
+
+  // sources added after setShardCount are consumed by every shard as well
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "i";
+  const std::uint64_t sourceId2 = session.addEventSource(eventSource);
+
+  // channels are assigned round-robin
+  binlog::SessionWriter writer0(session, 512);
+  binlog::SessionWriter writer1(session, 512);
+
+  const char* foo = "foo";
+  std::uint64_t literal;
+  memcpy(&literal, &foo, sizeof(foo));
+
+  CHECK(writer0.addEvent(sourceId1, 0, literal, 1));
+  CHECK(writer1.addEvent(sourceId1, 0, literal, 2));
+  CHECK(writer1.addEvent(sourceId2, 0, 3));
+  CHECK(writer0.addEvent(sourceId2, 0, 4));
+
+  TestStream stream0;
+  TestStream stream1;
+  binlog::Session::ConsumeResult cr = session.consumeShard(1, stream1);
+  CHECK(cr.channelsPolled == 1);
+  cr = session.consumeShard(0, stream0);
+  CHECK(cr.channelsPolled == 1);
+
+  // each shard is self contained
+  CHECK(countTags(stream0, binlog::LiteralString::Tag) == 1);
+  CHECK(countTags(stream1, binlog::LiteralString::Tag) == 1);
+  CHECK(streamToEvents(stream0, "%m") == std::vector<std::string>{"foo 1", "4"});
+  CHECK(streamToEvents(stream1, "%m") == std::vector<std::string>{"foo 2", "3"});
+
+  // closed channels are removed by their shard
+  writer1 = binlog::SessionWriter(session, 512);
+  cr = session.consumeShard(1, stream1);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(cr.channelsRemoved == 1);
+  cr = session.consumeShard(0, stream0);
+  CHECK(cr.channelsPolled == 2);
+  CHECK(cr.channelsRemoved == 0);
+
+  // the new channel of writer1 belongs to shard 0
+  CHECK(writer1.addEvent(sourceId2, 0, 5));
+  session.consumeShard(0, stream0);
+  stream0.readPos = 0;
+  CHECK(streamToEvents(stream0, "%m") == std::vector<std::string>{"foo 1", "4", "5"});
+}
+
+TEST_CASE("reconsume_shard_metadata")
+{
+  binlog::Session session;
+  session.setShardCount(2);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{} {}";
+  eventSource.argumentTags = "{binlog::literal`value'L}i";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  binlog::SessionWriter writer0(session, 512);
+  binlog::SessionWriter writer1(session, 512);
+
+  const char* foo = "foo";
+  std::uint64_t literal;
+  memcpy(&literal, &foo, sizeof(foo));
+
+  CHECK(writer0.addEvent(sourceId, 0, literal, 1));
+  CHECK(writer1.addEvent(sourceId, 0, literal, 2));
+
+  TestStream stream0;
+  TestStream stream1;
+  session.consumeShard(0, stream0);
+  session.consumeShard(1, stream1);
+
+  NullOstream out;
+  CHECK_THROWS_AS(session.reconsumeShardMetadata(2, out), std::out_of_range);
+
+  // rotate the output of shard 1: the new output is self contained
+  TestStream rotated;
+  session.reconsumeShardMetadata(1, rotated);
+  CHECK(writer1.addEvent(sourceId, 0, literal, 3));
+  session.consumeShard(1, rotated);
+
+  CHECK(countTags(rotated, binlog::ClockSync::Tag) == 1);
+  CHECK(countTags(rotated, binlog::EventSource::Tag) == 1);
+  CHECK(countTags(rotated, binlog::LiteralString::Tag) == 1);
+  CHECK(streamToEvents(rotated, "%m") == std::vector<std::string>{"foo 3"});
+}
+
+TEST_CASE("channel_shard_selector")
+{
+  binlog::Session session;
+  session.setShardCount(2);
+
+  std::size_t nextShard = 3;
+  session.setChannelShardSelector([&nextShard]() { return nextShard; });
+
+  std::shared_ptr<binlog::Session::Channel> ch1 = session.createChannel(128);
+  std::shared_ptr<binlog::Session::Channel> ch2 = session.createChannel(128);
+  nextShard = 4;
+  std::shared_ptr<binlog::Session::Channel> ch3 = session.createChannel(128);
+
+  NullOstream out;
+  CHECK(session.consumeShard(0, out).channelsPolled == 1);
+  CHECK(session.consumeShard(1, out).channelsPolled == 2);
+
+  // back to round-robin
+  session.setChannelShardSelector({});
+  std::shared_ptr<binlog::Session::Channel> ch4 = session.createChannel(128);
+  std::shared_ptr<binlog::Session::Channel> ch5 = session.createChannel(128);
+  CHECK(session.consumeShard(0, out).channelsPolled == 2);
+  CHECK(session.consumeShard(1, out).channelsPolled == 3);
+}
+
+TEST_CASE("consume_with_budget")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer0(session, 512, 0, "w0");
+  binlog::SessionWriter writer1(session, 512, 0, "w1");
+  binlog::SessionWriter writer2(session, 512, 0, "w2");
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "i";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  CHECK(writer0.addEvent(sourceId, 0, 0));
+  CHECK(writer1.addEvent(sourceId, 0, 1));
+  CHECK(writer2.addEvent(sourceId, 0, 2));
+
+  binlog::Session::ConsumeBudget budget;
+  budget.bytes = 1;
+
+  // a single channel is polled by each call
+  TestStream stream;
+  binlog::Session::ConsumeResult cr = session.consume(stream, budget);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(cr.bytesRemaining != 0);
+  cr = session.consume(stream, budget);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(cr.bytesRemaining != 0);
+
+  // round-robin: the first channel is polled after the last
+  CHECK(writer0.addEvent(sourceId, 0, 3));
+  cr = session.consume(stream, budget);
+  CHECK(cr.bytesRemaining != 0);
+  cr = session.consume(stream, budget);
+  CHECK(cr.bytesRemaining == 0);
+
+  CHECK(streamToEvents(stream, "%n %m") == std::vector<std::string>{"w0 0", "w1 1", "w2 2", "w0 3"});
+
+  // without limits, every channel is polled
+  CHECK(writer1.addEvent(sourceId, 0, 4));
+  cr = session.consume(stream, binlog::Session::ConsumeBudget{});
+  CHECK(cr.channelsPolled == 3);
+  CHECK(cr.bytesRemaining == 0);
+  stream.readPos = 0;
+  CHECK(streamToEvents(stream, "%n %m") == std::vector<std::string>{"w0 0", "w1 1", "w2 2", "w0 3", "w1 4"});
+}
+
+TEST_CASE("consume_with_budget_replaced_channel")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer0(session, 128, 0, "w0");
+  binlog::SessionWriter writer1(session, 512, 0, "w1");
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "[c";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  const std::string large(80, 'x');
+
+  binlog::Session::ConsumeBudget budget;
+  budget.bytes = 1;
+
+  CHECK(writer0.addEvent(sourceId, 0, std::string("a")));
+  CHECK(writer1.addEvent(sourceId, 0, std::string("b")));
+  TestStream stream;
+  session.consume(stream, budget); // polls w0
+
+  // w0 switches to a new channel, its old channel still has data
+  CHECK(writer0.addEvent(sourceId, 0, std::string("c")));
+  CHECK(writer0.addEvent(sourceId, 0, large));
+
+  session.consume(stream, budget); // polls w1
+  // the next channel is the new channel of w0:
+  // it is not polled before the old one is consumed
+  binlog::Session::ConsumeResult cr = session.consume(stream, budget);
+  CHECK(cr.channelsRemoved == 1);
+  session.consume(stream, binlog::Session::ConsumeBudget{});
+
+  CHECK(streamToEvents(stream, "%n %m") == std::vector<std::string>{"w0 a", "w1 b", "w0 c", "w0 " + large});
+}
+
+TEST_CASE("deferred_consume")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource;
+  eventSource.formatString = "{}";
+  eventSource.argumentTags = "i";
+  const std::uint64_t sourceId = session.addEventSource(eventSource);
+
+  auto writeBuffers = [](const binlog::Session::DeferredConsume& dc, TestStream& out)
+  {
+    for (const binlog::Session::DeferredConsume::Buffer& buffer : dc.buffers())
+    {
+      out.write(buffer.data, std::streamsize(buffer.size));
+    }
+  };
+
+  CHECK(writer.addEvent(sourceId, 0, 1));
+  CHECK(writer.addEvent(sourceId, 0, 2));
+
+  TestStream stream;
+  binlog::Session::DeferredConsume dc;
+  binlog::Session::ConsumeResult cr = session.beginConsume(dc);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(cr.bytesConsumed == dc.size());
+
+  // metadata and WriterProp copied, events referred
+  REQUIRE(dc.buffers().size() == 2);
+  CHECK(dc.buffers()[1].size == 2 * (4 + 8 + 8 + 4));
+
+  // the channel is not polled until released
+  CHECK(writer.addEvent(sourceId, 0, 3));
+  binlog::Session::DeferredConsume dc2;
+  cr = session.beginConsume(dc2);
+  CHECK(cr.channelsPolled == 0);
+  CHECK(dc2.buffers().empty());
+  NullOstream out;
+  CHECK(session.consume(out).channelsPolled == 0);
+
+  writeBuffers(dc, stream);
+  session.endConsume(dc);
+  CHECK(dc.buffers().empty());
+
+  cr = session.beginConsume(dc2);
+  CHECK(cr.channelsPolled == 1);
+  writeBuffers(dc2, stream);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"1", "2", "3"});
+
+  // moving does not release the data, and cannot throw
+  static_assert(std::is_nothrow_move_constructible<binlog::Session::DeferredConsume>::value, "");
+
+  // data is released by the destructor as well
+  {
+    binlog::Session::DeferredConsume dc3(std::move(dc2));
+    CHECK(session.beginConsume(dc).channelsPolled == 0);
+  }
+  CHECK(writer.addEvent(sourceId, 0, 4));
+  CHECK(session.beginConsume(dc).channelsPolled == 1);
+
+  // and by assignment
+  dc = binlog::Session::DeferredConsume{};
+  CHECK(dc.buffers().empty());
+  CHECK(writer.addEvent(sourceId, 0, 5));
+  CHECK(session.beginConsume(dc2).channelsPolled == 1);
+  dc = std::move(dc2);
+  CHECK(dc2.buffers().empty());
+  CHECK(session.beginConsume(dc2).channelsPolled == 0);
+
+  // the data moved to `dc` is still referred, until released
+  TestStream stream2;
+  session.reconsumeMetadata(stream2);
+  writeBuffers(dc, stream2);
+  session.endConsume(dc);
+  CHECK(streamToEvents(stream2, "%m") == std::vector<std::string>{"5"});
+  CHECK(session.beginConsume(dc2).channelsPolled == 1);
+}
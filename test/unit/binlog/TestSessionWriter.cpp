@@ -1,6 +1,9 @@
 #include <binlog/Session.hpp>
 
 #include <binlog/SessionWriter.hpp>
+#include <binlog/detail/InternCache.hpp>
+
+#include <mserialize/make_struct_serializable.hpp>
 
 #include "test_utils.hpp"
 
@@ -12,6 +15,23 @@
 #include <thread>
 #include <vector>
 
+namespace {
+
+struct CountedGetter
+{
+  mutable int callCount = 0;
+
+  std::string value() const
+  {
+    ++callCount;
+    return "value";
+  }
+};
+
+} // namespace
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(CountedGetter, value)
+
 TEST_CASE("add_event")
 {
   binlog::Session session;
@@ -370,3 +390,518 @@ TEST_CASE("swap_writers_of_different_sessions")
   // but sb is destructed first. ASAN will detect
   // if wa accesses a destructed channel.
 }
+
+TEST_CASE("add_event_calls_getters_once")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "[c"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  const CountedGetter cg;
+  CHECK(writer.addEvent(eventSource.id, 0, cg)); // first write: finds free space
+  CHECK(writer.addEvent(eventSource.id, 0, cg)); // subsequent writes: single pass
+  CHECK(writer.addEvent(eventSource.id, 0, cg));
+
+  CHECK(cg.callCount == 3);
+  CHECK(getEvents(session, "%m") == std::vector<std::string>(3, "a=value"));
+}
+
+TEST_CASE("add_string_events_wrap_around")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 256);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "[[c"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  TestStream stream;
+  std::vector<std::string> expectedEvents;
+
+  // make the queue wrap around several times, without replacing the channel
+  for (int i = 0; i < 64; ++i)
+  {
+    const std::vector<std::string> arg{std::to_string(i), std::string(std::size_t(i % 7), 'x')};
+    CHECK(writer.addEvent(eventSource.id, 0, arg));
+
+    std::ostringstream s;
+    s << "a=[" << arg[0] << ", " << arg[1] << "]";
+    expectedEvents.push_back(s.str());
+
+    if (i % 3 == 0)
+    {
+      const binlog::Session::ConsumeResult cr = session.consume(stream);
+      CHECK(cr.channelsPolled == 1);
+    }
+  }
+
+  session.consume(stream);
+  CHECK(streamToEvents(stream, "%m") == expectedEvents);
+}
+
+TEST_CASE("add_string_event_larger_than_queue")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={} b={}", "[ci"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  // does not fit in the free space: falls back to two pass, replaces channel
+  const std::string big(300, 'x');
+  CHECK(writer.addEvent(eventSource.id, 0, big, 1));
+  CHECK(writer.addEvent(eventSource.id, 0, std::string("small"), 2));
+
+  const std::vector<std::string> expectedEvents{
+    "a=" + big + " b=1",
+    "a=small b=2",
+  };
+  CHECK(getEvents(session, "%m") == expectedEvents);
+}
+
+TEST_CASE("add_string_event_streaming")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+  writer.setStreamingThreshold(64);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={} b={}", "[ci"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  // the threshold is kept when the channel is replaced
+  const std::string big(300, 'x');
+  CHECK(writer.addEvent(eventSource.id, 0, big, 1));
+  CHECK(writer.addEvent(eventSource.id, 0, std::string("small"), 2));
+  CHECK(writer.addEvent(eventSource.id, 0, big + "y", 3));
+
+  const std::vector<std::string> expectedEvents{
+    "a=" + big + " b=1",
+    "a=small b=2",
+    "a=" + big + "y b=3",
+  };
+  CHECK(getEvents(session, "%m") == expectedEvents);
+}
+
+TEST_CASE("shared_writer_add_event")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer = binlog::SessionWriter::shared(session);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={} b={}", "i[c"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  CHECK(writer.addEvent(eventSource.id, 0, 456, std::string("foo")));
+  CHECK(writer.addEvent(eventSource.id, 0, 789, std::string("bar")));
+
+  TestStream stream;
+  const binlog::Session::ConsumeResult cr = session.consume(stream);
+
+  // the writer does not create a channel
+  CHECK(cr.channelsPolled == 0);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"a=456 b=foo", "a=789 b=bar"});
+}
+
+TEST_CASE("shared_writer_upgrade")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer = binlog::SessionWriter::shared(session, 128);
+  writer.setId(7);
+  writer.setName("Seven");
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "i"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  // each event is 24 bytes: 5 go to the shared queue, the rest to a channel
+  std::vector<std::string> expectedEvents;
+  for (int i = 0; i < 10; ++i)
+  {
+    CHECK(writer.addEvent(eventSource.id, 0, i));
+    expectedEvents.push_back((i < 5 ? "0  a=" : "7 Seven a=") + std::to_string(i));
+  }
+
+  TestStream stream;
+  const binlog::Session::ConsumeResult cr = session.consume(stream);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(streamToEvents(stream, "%t %n %m") == expectedEvents);
+}
+
+TEST_CASE("shared_writer_queue_is_full")
+{
+  binlog::Session session;
+  session.sharedQueue(256);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "[c"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  binlog::SessionWriter writer = binlog::SessionWriter::shared(session);
+
+  // the shared queue fills up before the threshold is reached: writer creates a channel
+  std::vector<std::string> expectedEvents;
+  for (int i = 0; i < 32; ++i)
+  {
+    CHECK(writer.addEvent(eventSource.id, 0, std::string(std::size_t(i), 'x')));
+    expectedEvents.push_back("a=" + std::string(std::size_t(i), 'x'));
+  }
+
+  TestStream stream;
+  const binlog::Session::ConsumeResult cr = session.consume(stream);
+  CHECK(cr.channelsPolled == 1);
+  CHECK(streamToEvents(stream, "%m") == expectedEvents);
+}
+
+TEST_CASE("shared_writers_from_threads")
+{
+  binlog::Session session;
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={} {}", "ci"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  // many short lived threads, writing a few events each
+  auto writeEvents = [&eventSource, &session](char name)
+  {
+    binlog::SessionWriter writer = binlog::SessionWriter::shared(session);
+    for (int i = 0; i < 10; ++i)
+    {
+      while (! writer.addEvent(eventSource.id, 0, name, i)) { std::this_thread::yield(); }
+    }
+  };
+
+  TestStream out;
+  for (char name = 'A'; name <= 'Z'; ++name)
+  {
+    std::thread a(writeEvents, name);
+    std::thread b(writeEvents, char(name + 32));
+    session.consume(out);
+    a.join();
+    b.join();
+  }
+
+  const binlog::Session::ConsumeResult cr = session.consume(out);
+  CHECK(cr.channelsPolled == 0);
+
+  std::vector<std::string> events = streamToEvents(out, "%m");
+
+  // order of events is not specified across threads: sort them by thread name
+  std::stable_sort(
+    events.begin(), events.end(),
+    [](const std::string& a, const std::string& b) { return a[2] < b[2]; }
+  );
+
+  std::vector<std::string> expectedEvents;
+  for (char name = 'A'; name <= 'z'; ++name)
+  {
+    if (name > 'Z' && name < 'a') { continue; }
+    for (int i = 0; i < 10; ++i)
+    {
+      expectedEvents.push_back(std::string("a=") + name + " " + std::to_string(i));
+    }
+  }
+
+  CHECK(events == expectedEvents);
+}
+
+TEST_CASE("adaptive_sizing_grow")
+{
+  binlog::Session session;
+  session.setAdaptiveChannelSizing(128, 4096, 4);
+  binlog::SessionWriter writer(session); // queue of 128 bytes
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "i"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  std::vector<std::string> expectedEvents;
+  auto addEvents = [&](int from, int to)
+  {
+    for (int i = from; i < to; ++i)
+    {
+      CHECK(writer.addEvent(eventSource.id, 0, i));
+      expectedEvents.push_back("a=" + std::to_string(i));
+    }
+  };
+
+  TestStream stream;
+
+  // queue is more than half full: consumer creates a replacement
+  addEvents(0, 4);
+  CHECK(session.consume(stream).channelsPolled == 1);
+  CHECK(session.consume(stream).channelsPolled == 1); // the replacement is polled after the old channel is removed
+
+  // queue overflows: writer takes the replacement, instead of creating a new channel
+  addEvents(4, 14);
+  binlog::Session::ConsumeResult cr = session.consume(stream);
+  CHECK(cr.channelsPolled == 2);
+  CHECK(cr.channelsRemoved == 1);
+
+  CHECK(streamToEvents(stream, "%m") == expectedEvents);
+}
+
+TEST_CASE("adaptive_sizing_grow_taken_late")
+{
+  binlog::Session session;
+  session.setAdaptiveChannelSizing(128, 4096, 4);
+  binlog::SessionWriter writer(session); // queue of 128 bytes
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "i"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  std::vector<std::string> expectedEvents;
+  auto addEvents = [&](int from, int to)
+  {
+    for (int i = from; i < to; ++i)
+    {
+      CHECK(writer.addEvent(eventSource.id, 0, i));
+      expectedEvents.push_back("a=" + std::to_string(i));
+    }
+  };
+
+  TestStream stream;
+
+  // queue is more than half full: consumer creates a replacement
+  addEvents(0, 4);
+  CHECK(session.consume(stream).channelsPolled == 1);
+
+  // the replacement is not taken for more than a window:
+  // it is not polled while the old channel is in use, and not found too large
+  for (int i = 0; i < 10; ++i)
+  {
+    CHECK(session.consume(stream).channelsPolled == 1);
+  }
+
+  // queue overflows: writer takes the grown replacement
+  addEvents(4, 14);
+  binlog::Session::ConsumeResult cr = session.consume(stream);
+  CHECK(cr.channelsPolled == 2);
+  CHECK(cr.channelsRemoved == 1);
+
+  // the grown queue is used, without being replaced
+  addEvents(14, 20);
+  for (int i = 0; i < 4; ++i)
+  {
+    CHECK(session.consume(stream).channelsPolled == 1);
+  }
+
+  CHECK(streamToEvents(stream, "%m") == expectedEvents);
+}
+
+TEST_CASE("adaptive_sizing_shrink")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 1024);
+  writer.setName("W");
+  session.setAdaptiveChannelSizing(128, 4096, 4);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "i"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  TestStream stream;
+  std::vector<std::string> expectedEvents;
+  for (int i = 0; i < 100; ++i)
+  {
+    CHECK(writer.addEvent(eventSource.id, 0, i));
+    expectedEvents.push_back("W a=" + std::to_string(i));
+
+    if (i % 2 == 1) { session.consume(stream); }
+  }
+
+  // the writer took the smaller replacement, the original channel is removed
+  CHECK(session.consume(stream).channelsPolled == 1);
+  CHECK(streamToEvents(stream, "%n %m") == expectedEvents);
+}
+
+TEST_CASE("adaptive_sizing_disabled")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 128);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "i"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  TestStream stream;
+  for (int i = 0; i < 16; ++i)
+  {
+    CHECK(writer.addEvent(eventSource.id, 0, i));
+    CHECK(session.consume(stream).channelsPolled == 1);
+  }
+}
+
+TEST_CASE("add_interned_strings")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={} b={}",
+    "{binlog::interned`id'L}{binlog::interned`id'L}"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  const std::string foo = "foo";
+  TestStream stream;
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned(foo), binlog::interned("bar")));
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("bar"), binlog::interned(foo)));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::InternedString::Tag) == 2);
+
+  // seen strings are not written again
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned(foo), binlog::interned(foo)));
+  session.consume(stream);
+  CHECK(countTags(stream, binlog::InternedString::Tag) == 2);
+
+  // after log rotation, strings are written again by the session, not by the writer
+  TestStream rotated;
+  session.reconsumeMetadata(rotated);
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned(foo), binlog::interned("baz")));
+  session.consume(rotated);
+  CHECK(countTags(rotated, binlog::InternedString::Tag) == 3);
+
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"a=foo b=bar", "a=bar b=foo", "a=foo b=foo"});
+  CHECK(streamToEvents(rotated, "%m") == std::vector<std::string>{"a=foo b=baz"});
+}
+
+TEST_CASE("interned_strings_after_rotation")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "{binlog::interned`id'L}"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  TestStream stream;
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("foo")));
+  session.consume(stream);
+
+  // queued before the rotation, consumed after it: refers to the string by id only
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("foo")));
+
+  TestStream rotated;
+  session.reconsumeMetadata(rotated);
+  session.consume(rotated);
+
+  // logged after the rotation: the writer does not write the string again
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("foo")));
+  session.consume(rotated);
+
+  // the new output is self contained
+  CHECK(countTags(rotated, binlog::InternedString::Tag) == 1);
+  CHECK(streamToEvents(rotated, "%m") == std::vector<std::string>{"a=foo", "a=foo"});
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"a=foo"});
+}
+
+TEST_CASE("interned_string_ids_reused")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "a={}", "{binlog::interned`id'L}"
+  };
+  eventSource.id = session.addEventSource(eventSource);
+
+  // find a string that evicts "foo" from the cache of the writer
+  binlog::detail::InternCache cache;
+  std::string bar;
+  for (int i = 0; bar.empty(); ++i)
+  {
+    const std::string candidate = "bar" + std::to_string(i);
+    if (&cache.slot(candidate) == &cache.slot("foo")) { bar = candidate; }
+  }
+
+  TestStream stream;
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("foo")));
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned(bar)));
+  session.consume(stream);
+  CHECK(writer.addEvent(eventSource.id, 0, binlog::interned("foo")));
+  session.consume(stream);
+
+  // every string is written with the id of the slot
+  CHECK(countTags(stream, binlog::InternedString::Tag) == 3);
+  CHECK(session.newInternedStringId() == 2);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"a=foo", "a=" + bar, "a=foo"});
+
+  // only the last string of the id is kept
+  TestStream rotated;
+  session.reconsumeMetadata(rotated);
+  CHECK(countTags(rotated, binlog::InternedString::Tag) == 1);
+}
+
+TEST_CASE("priority_lane")
+{
+  binlog::Session session;
+  binlog::SessionWriter bulkWriter(session, 512, 1, "bulk");
+  binlog::SessionWriter writer(session, 512, 2, "writer");
+  writer.setPriorityLane(binlog::Severity::error, 512);
+
+  binlog::EventSource eventSource{
+    0, binlog::Severity::info, "cat", "fun", "file", 123, "{} {}", "[c{binlog::interned`id'L}"
+  };
+  const std::uint64_t infoId = session.addEventSource(eventSource);
+  eventSource.severity = binlog::Severity::error;
+  const std::uint64_t errorId = session.addEventSource(eventSource);
+
+  const binlog::Severity info = binlog::Severity::info;
+  const binlog::Severity error = binlog::Severity::error;
+  CHECK(bulkWriter.addEvent(error, infoId, 0, std::string("bulk"), binlog::interned("a")));
+  CHECK(writer.addEvent(info, infoId, 0, std::string("info"), binlog::interned("a")));
+  CHECK(writer.addEvent(error, errorId, 0, std::string("error"), binlog::interned("a")));
+  CHECK(writer.addEvent(info, infoId, 0, std::string("info"), binlog::interned("b")));
+  CHECK(writer.addEvent(error, errorId, 0, std::string("error"), binlog::interned("b")));
+
+  // priority lanes are consumed first, with the id and name of the writer,
+  // the interned strings are written to both lanes
+  TestStream stream;
+  CHECK(session.consume(stream).channelsPolled == 3);
+  CHECK(streamToEvents(stream, "%S %n %m") == std::vector<std::string>{
+    "ERRO writer error a",
+    "ERRO writer error b",
+    "INFO bulk bulk a",
+    "INFO writer info a",
+    "INFO writer info b",
+  });
+
+  // a new priority lane closes the old one
+  writer.setPriorityLane(binlog::Severity::warning, 512);
+  writer.setName("renamed");
+  CHECK(writer.addEvent(error, errorId, 0, std::string("error"), binlog::interned("a")));
+  CHECK(writer.addEvent(info, infoId, 0, std::string("info"), binlog::interned("a")));
+
+  stream.readPos = 0;
+  const binlog::Session::ConsumeResult cr = session.consume(stream);
+  CHECK(cr.channelsPolled == 4);
+  CHECK(cr.channelsRemoved == 1);
+  CHECK(streamToEvents(stream, "%S %n %m") == std::vector<std::string>{
+    "ERRO writer error a",
+    "ERRO writer error b",
+    "INFO bulk bulk a",
+    "INFO writer info a",
+    "INFO writer info b",
+    "ERRO renamed error a",
+    "INFO renamed info a",
+  });
+}
@@ -0,0 +1,170 @@
+#include <binlog/detail/SharedQueue.hpp>
+#include <binlog/detail/VectorOutputStream.hpp>
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool writeq(binlog::detail::SharedQueue& q, const std::string& data)
+{
+  binlog::detail::SharedQueueWriter w(q);
+  if (! w.beginWrite(data.size())) { return false; }
+
+  w.writeBuffer(data.data(), data.size());
+  w.endWrite();
+  return true;
+}
+
+std::string readq(binlog::detail::SharedQueue& q)
+{
+  binlog::detail::VectorOutputStream out;
+  q.read(out);
+  return std::string(out.data(), out.vector.size());
+}
+
+} // namespace
+
+TEST_CASE("shared_capacity")
+{
+  binlog::detail::SharedQueue q(1000);
+  CHECK(q.capacity() == 1024);
+}
+
+TEST_CASE("shared_empty")
+{
+  binlog::detail::SharedQueue q(1024);
+  CHECK(readq(q).empty());
+}
+
+TEST_CASE("shared_write_read")
+{
+  binlog::detail::SharedQueue q(1024);
+
+  CHECK(writeq(q, "foo"));
+  CHECK(writeq(q, "barbazqux"));
+  CHECK(readq(q) == "foobarbazqux");
+  CHECK(readq(q).empty());
+}
+
+TEST_CASE("shared_uncommitted")
+{
+  binlog::detail::SharedQueue q(1024);
+
+  CHECK(writeq(q, "foo"));
+
+  char* reserved = q.reserve(3);
+  REQUIRE(reserved != nullptr);
+  memcpy(reserved, "bar", 3);
+
+  CHECK(writeq(q, "baz"));
+
+  // reading stops at the first uncommitted record
+  CHECK(readq(q) == "foo");
+
+  q.commit(reserved);
+  CHECK(readq(q) == "barbaz");
+}
+
+TEST_CASE("shared_full")
+{
+  binlog::detail::SharedQueue q(64);
+
+  // each record takes 8 bytes of header + 8 bytes of data
+  for (int i = 0; i < 4; ++i)
+  {
+    CHECK(writeq(q, "12345678"));
+  }
+  CHECK(! writeq(q, "x"));
+
+  CHECK(readq(q).size() == 32);
+  CHECK(writeq(q, "x"));
+}
+
+TEST_CASE("shared_too_large")
+{
+  binlog::detail::SharedQueue q(64);
+  CHECK(! writeq(q, std::string(25, 'x')));
+  CHECK(writeq(q, std::string(24, 'x')));
+}
+
+TEST_CASE("shared_wrap_around")
+{
+  binlog::detail::SharedQueue q(128);
+
+  std::string expected;
+  std::string actual;
+
+  for (std::size_t i = 0; i < 100; ++i)
+  {
+    const std::string data(i % 37, char('a' + i % 26));
+    if (! writeq(q, data))
+    {
+      actual += readq(q);
+      REQUIRE(writeq(q, data));
+    }
+    expected += data;
+  }
+
+  actual += readq(q);
+  CHECK(actual == expected);
+}
+
+TEST_CASE("shared_concurrent_write_read")
+{
+  binlog::detail::SharedQueue q(4096);
+
+  const int writerCount = 4;
+  const std::uint32_t msgCount = 10000;
+
+  auto writeMessages = [&q](std::uint32_t writer)
+  {
+    for (std::uint32_t i = 0; i < msgCount; ++i)
+    {
+      const std::uint32_t msg[2] = {writer, i};
+      binlog::detail::SharedQueueWriter w(q);
+      while (! w.beginWrite(sizeof(msg))) { std::this_thread::yield(); }
+      w.writeBuffer(msg, sizeof(msg));
+      w.endWrite();
+    }
+  };
+
+  std::vector<std::thread> writers;
+  for (int i = 0; i < writerCount; ++i)
+  {
+    writers.emplace_back(writeMessages, std::uint32_t(i));
+  }
+
+  // messages of a single writer must be read in order
+  std::vector<std::uint32_t> nextMessage(writerCount, 0);
+  std::uint32_t readCount = 0;
+  bool inOrder = true;
+
+  binlog::detail::VectorOutputStream out;
+  while (readCount < writerCount * msgCount)
+  {
+    out.clear();
+    q.read(out);
+    if (out.vector.empty()) { std::this_thread::yield(); }
+
+    for (std::size_t pos = 0; pos < out.vector.size(); pos += 2 * sizeof(std::uint32_t))
+    {
+      std::uint32_t msg[2];
+      memcpy(msg, out.data() + pos, sizeof(msg));
+      inOrder = inOrder && msg[0] < writerCount && nextMessage[msg[0]] == msg[1];
+      nextMessage[msg[0] % writerCount]++;
+      readCount++;
+    }
+  }
+
+  for (std::thread& writer : writers) { writer.join(); }
+
+  CHECK(inOrder);
+  CHECK(readq(q).empty());
+}
@@ -0,0 +1,114 @@
+#include <binlog/timer_macros.hpp>
+
+#include "test_utils.hpp"
+
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+
+#include <doctest/doctest.h>
+
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void timedFunction(binlog::SessionWriter& writer)
+{
+  BINLOG_SCOPE_TIMER_WC(writer, my_cat, "Timed");
+}
+
+} // namespace
+
+TEST_CASE("scope_timer")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  timedFunction(writer);
+
+  // the argument tags end with the marker of scope events
+  const std::vector<std::string> events = getEvents(session, "%S %C %M %m %T");
+  REQUIRE(events.size() == 1);
+  CHECK(std::regex_match(events[0], std::regex(R"(INFO my_cat timedFunction Timed \(duration: \d+ ns\) L\{binlog::scope_timer\})")));
+}
+
+TEST_CASE("scope_timer_args_evaluated_on_exit")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  {
+    int counter = 1;
+    BINLOG_SCOPE_TIMER_W(writer, "Counter: {} {}", counter, std::string("x"));
+    counter = 2;
+  }
+
+  const std::vector<std::string> events = getEvents(session, "%m");
+  REQUIRE(events.size() == 1);
+  CHECK(std::regex_match(events[0], std::regex(R"(Counter: 2 x \(duration: \d+ ns\))")));
+}
+
+TEST_CASE("scope_timer_disabled")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+  session.setMinSeverity(binlog::Severity::warning);
+
+  int evaluated = 0;
+  {
+    BINLOG_SCOPE_TIMER_W(writer, "Not evaluated {}", ++evaluated);
+  }
+
+  CHECK(evaluated == 0);
+  CHECK(getEvents(session, "%m").empty());
+}
+
+TEST_CASE("scope_timer_args_throw")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  const auto fail = []() -> int { throw std::runtime_error("fail"); };
+  {
+    BINLOG_SCOPE_TIMER_W(writer, "Failed {}", fail());
+  }
+  {
+    BINLOG_SPAN_W(writer, "Failed {}", fail());
+  }
+  {
+    BINLOG_SPAN_W(writer, "Next");
+  }
+
+  // the span is closed even if its event is dropped
+  const std::vector<std::string> events = getEvents(session, "%m");
+  REQUIRE(events.size() == 1);
+  CHECK(std::regex_match(events[0], std::regex(R"(Next \(span: 2, parent: 0, duration: \d+ ns\))")));
+}
+
+TEST_CASE("nested_spans")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+
+  {
+    BINLOG_SPAN_W(writer, "Outer");
+    {
+      BINLOG_SPAN_WC(writer, my_cat, "Inner {}", 1);
+    }
+    {
+      BINLOG_SPAN_WC(writer, my_cat, "Inner {}", 2);
+    }
+  }
+  {
+    BINLOG_SPAN_W(writer, "Next");
+  }
+
+  const std::vector<std::string> events = getEvents(session, "%C %m");
+  REQUIRE(events.size() == 4);
+  CHECK(std::regex_match(events[0], std::regex(R"(my_cat Inner 1 \(span: 2, parent: 1, duration: \d+ ns\))")));
+  CHECK(std::regex_match(events[1], std::regex(R"(my_cat Inner 2 \(span: 3, parent: 1, duration: \d+ ns\))")));
+  CHECK(std::regex_match(events[2], std::regex(R"(main Outer \(span: 1, parent: 0, duration: \d+ ns\))")));
+  CHECK(std::regex_match(events[3], std::regex(R"(main Next \(span: 4, parent: 0, duration: \d+ ns\))")));
+}
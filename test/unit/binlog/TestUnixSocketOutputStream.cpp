@@ -0,0 +1,137 @@
+#include <binlog/UnixSocketOutputStream.hpp>
+
+#include <binlog/Session.hpp>
+#include <binlog/SessionWriter.hpp>
+#include <binlog/advanced_log_macros.hpp>
+
+#include "test_utils.hpp"
+
+#include <doctest/doctest.h>
+
+#include <cstring> // memcpy
+#include <string>
+#include <vector>
+
+#include <sys/socket.h> // NOLINT
+#include <sys/un.h> // NOLINT sockaddr_un
+#include <unistd.h> // NOLINT
+
+namespace {
+
+/** A collector accepting a single connection at a time */
+class TestCollector
+{
+public:
+  explicit TestCollector(std::string path)
+    :_path(std::move(path))
+  {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, _path.data(), _path.size());
+
+    ::unlink(_path.c_str());
+    _listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(::bind(_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    REQUIRE(::listen(_listener, 1) == 0);
+  }
+
+  ~TestCollector()
+  {
+    disconnect();
+    ::close(_listener);
+    ::unlink(_path.c_str());
+  }
+
+  TestCollector(const TestCollector&) = delete;
+  void operator=(const TestCollector&) = delete;
+
+  /** Accept a connection if there's none, read the available data to `out` */
+  void receive(TestStream& out)
+  {
+    if (_socket < 0) { _socket = ::accept(_listener, nullptr, nullptr); }
+    REQUIRE(_socket >= 0);
+
+    char buffer[4096];
+    ssize_t size = 0;
+    while ((size = ::recv(_socket, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+    {
+      out.write(buffer, size);
+    }
+  }
+
+  void disconnect()
+  {
+    if (_socket >= 0) { ::close(_socket); }
+    _socket = -1;
+  }
+
+private:
+  std::string _path;
+  int _listener = -1;
+  int _socket = -1;
+};
+
+std::string socketPath()
+{
+  return "binlog_test_" + std::to_string(::getpid()) + ".sock";
+}
+
+} // namespace
+
+TEST_CASE("unix_socket_stream_consume")
+{
+  TestCollector collector(socketPath());
+
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+  binlog::UnixSocketOutputStream out(socketPath());
+  CHECK(! out.connected());
+
+  BINLOG_INFO_W(writer, "Hello {}", 1);
+  BINLOG_INFO_W(writer, "Hello {}", 2);
+  out.consume(session);
+  CHECK(out.connected());
+
+  TestStream stream;
+  collector.receive(stream);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"Hello 1", "Hello 2"});
+  CHECK(out.droppedBytes() == 0);
+}
+
+TEST_CASE("unix_socket_stream_replay_metadata")
+{
+  binlog::Session session;
+  binlog::SessionWriter writer(session, 512);
+  binlog::UnixSocketOutputStream out(socketPath(), 256);
+
+  // a single call site: its event source is written only once
+  const auto logHello = [&writer](int value) { BINLOG_INFO_W(writer, "Hello {}", value); };
+
+  // no collector, buffer is too small: data is dropped
+  for (int i = 0; i < 16; ++i) { logHello(i); }
+  out.consume(session);
+  CHECK(! out.connected());
+  CHECK(out.droppedBytes() != 0);
+
+  // metadata is replayed, before the new events
+  TestCollector collector(socketPath());
+  logHello(100);
+  out.consume(session);
+  CHECK(out.connected());
+
+  TestStream stream;
+  collector.receive(stream);
+  CHECK(streamToEvents(stream, "%m") == std::vector<std::string>{"Hello 100"});
+
+  // connection lost: the next connection starts with the metadata
+  collector.disconnect();
+  logHello(101);
+  out.consume(session); // fails to send, disconnects
+  logHello(102);
+  out.consume(session);
+  CHECK(out.connected());
+
+  TestStream stream2;
+  collector.receive(stream2);
+  CHECK(streamToEvents(stream2, "%m") == std::vector<std::string>{"Hello 102"});
+}
@@ -0,0 +1,37 @@
+#include <binlog/detail/Crc32c.hpp>
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <string>
+
+TEST_CASE("empty")
+{
+  CHECK(binlog::detail::crc32c(nullptr, 0) == 0);
+}
+
+TEST_CASE("check_values")
+{
+  // test vectors from RFC 3720, B.4.
+  const std::string digits = "123456789";
+  CHECK(binlog::detail::crc32c(digits.data(), digits.size()) == 0xE3069283);
+
+  const std::string zeros(32, '\0');
+  CHECK(binlog::detail::crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+
+  const std::string ones(32, '\xFF');
+  CHECK(binlog::detail::crc32c(ones.data(), ones.size()) == 0x62A8AB43);
+}
+
+TEST_CASE("incremental")
+{
+  std::string input;
+  for (int i = 0; i < 100; ++i) { input += char(i * 7); }
+
+  const std::uint32_t whole = binlog::detail::crc32c(input.data(), input.size());
+  for (std::size_t split = 0; split <= input.size(); split += 9)
+  {
+    const std::uint32_t first = binlog::detail::crc32c(input.data(), split);
+    CHECK(binlog::detail::crc32c(input.data() + split, input.size() - split, first) == whole);
+  }
+}
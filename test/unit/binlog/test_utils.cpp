@@ -1,9 +1,11 @@
 #include "test_utils.hpp"
 
-#include <binlog/Entries.hpp> // Event
+#include <binlog/Entries.hpp> // Event, WriterProp
 #include <binlog/EventStream.hpp>
 #include <binlog/PrettyPrinter.hpp>
 
+#include <mserialize/deserialize.hpp>
+
 #include <doctest/doctest.h>
 
 #include <ctime>
@@ -36,7 +38,7 @@ std::vector<std::string> streamToEvents(TestStream& input, const char* eventForm
   while (const binlog::Event* event = eventStream.nextEvent(input))
   {
     std::ostringstream str;
-    pp.printEvent(str, *event, eventStream.writerProp(), eventStream.clockSync());
+    pp.printEvent(str, *event, eventStream);
     result.push_back(str.str());
   }
 
@@ -75,3 +77,24 @@ std::size_t countTags(TestStream& input, std::uint64_t tagToCount)
 
   return result;
 }
+
+std::vector<std::uint64_t> writerPropBatchSizes(TestStream& input)
+{
+  std::vector<std::uint64_t> result;
+  const std::size_t oldReadPos = input.readPos;
+
+  while (binlog::Range payload = input.nextEntryPayload())
+  {
+    const std::uint64_t tag = payload.read<std::uint64_t>();
+    if (tag == binlog::WriterProp::Tag)
+    {
+      binlog::WriterProp writerProp;
+      mserialize::deserialize(writerProp, payload);
+      result.push_back(writerProp.batchSize);
+    }
+  }
+
+  input.readPos = oldReadPos;
+
+  return result;
+}
@@ -4,10 +4,14 @@
 #include <binlog/EntryStream.hpp>
 #include <binlog/Session.hpp>
 
+#include <doctest/doctest.h>
+
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <ios>
 #include <string>
+#include <utility>
 #include <vector>
 
 /** EntryStream that also models mserialize::OutputStream */
@@ -21,6 +25,33 @@ struct TestStream : binlog::EntryStream
   binlog::Range nextEntryPayload() override;
 };
 
+/**
+ * Models mserialize::OutputStream: passes the written entries
+ * to `transform` (e.g: an EventFilter), that writes the result to `stream`
+ * and returns the number of bytes written.
+ */
+template <typename Transform>
+struct TransformStream
+{
+  Transform transform;
+  TestStream stream;
+
+  TransformStream& write(const char* buffer, std::streamsize size)
+  {
+    const std::size_t oldSize = stream.buffer.size();
+    const std::size_t writeSize = transform(buffer, std::size_t(size), stream);
+    CHECK(oldSize + writeSize == stream.buffer.size());
+    return *this;
+  }
+};
+
+/** @returns a TransformStream that writes to an empty stream by `transform(buffer, size, stream)` */
+template <typename Transform>
+TransformStream<Transform> transformStream(Transform transform)
+{
+  return TransformStream<Transform>{std::move(transform), {}};
+}
+
 /** Pretty print the events of a binlog stream `input` according to `eventFormat` */
 std::vector<std::string> streamToEvents(TestStream& input, const char* eventFormat);
 
@@ -33,4 +64,7 @@ std::string timePointToString(std::chrono::system_clock::time_point tp);
 /** Count the binlog entries in `input` with tag = `tagToCount` */
 std::size_t countTags(TestStream& input, std::uint64_t tagToCount);
 
+/** @returns the batchSize of each WriterProp entry in `input` */
+std::vector<std::uint64_t> writerPropBatchSizes(TestStream& input);
+
 #endif // TEST_UNIT_BINLOG_TEST_UTILS_HPP
@@ -773,3 +773,134 @@ TEST_CASE("template_with_value_args")
   roundtrip_into(in, out);
   CHECK(in == out);
 }
+
+// bitwise serializable structs
+
+struct Quote
+{
+  std::int64_t px = 0;
+  std::int32_t qty = 0;
+  std::int32_t side = 0;
+
+  friend bool operator==(const Quote& a, const Quote& b)
+  {
+    return a.px == b.px && a.qty == b.qty && a.side == b.side;
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const Quote& q)
+  {
+    return out << "Quote{ px: " << q.px << ", qty: " << q.qty << ", side: " << q.side << " }";
+  }
+};
+
+struct ReorderedQuote
+{
+  std::int64_t px = 0;
+  std::int32_t qty = 0;
+  std::int32_t side = 0;
+
+  friend bool operator==(const ReorderedQuote& a, const ReorderedQuote& b)
+  {
+    return a.px == b.px && a.qty == b.qty && a.side == b.side;
+  }
+};
+
+struct PaddedQuote
+{
+  std::int64_t px = 0;
+  std::int32_t qty = 0;
+
+  friend bool operator==(const PaddedQuote& a, const PaddedQuote& b)
+  {
+    return a.px == b.px && a.qty == b.qty;
+  }
+};
+
+struct QuotePair
+{
+  Quote bid;
+  Quote ask;
+
+  friend bool operator==(const QuotePair& a, const QuotePair& b)
+  {
+    return a.bid == b.bid && a.ask == b.ask;
+  }
+};
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(Quote, px, qty, side)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(Quote, px, qty, side)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(ReorderedQuote, side, px, qty)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(ReorderedQuote, side, px, qty)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(PaddedQuote, px, qty)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(PaddedQuote, px, qty)
+
+MSERIALIZE_MAKE_STRUCT_SERIALIZABLE(QuotePair, bid, ask)
+MSERIALIZE_MAKE_STRUCT_DESERIALIZABLE(QuotePair, bid, ask)
+
+static_assert(mserialize::detail::maybe_bitwise_serializable<Quote>::value, "");
+static_assert(mserialize::detail::maybe_bitwise_serializable<ReorderedQuote>::value, "");
+static_assert(mserialize::detail::maybe_bitwise_serializable<QuotePair>::value, "");
+static_assert(! mserialize::detail::maybe_bitwise_serializable<PaddedQuote>::value, "");
+static_assert(! mserialize::detail::maybe_bitwise_serializable<Person>::value, "");
+static_assert(! mserialize::detail::maybe_bitwise_serializable<Vehicle>::value, "");
+
+static_assert(mserialize::detail::is_sequence_batch_serializable<std::vector<Quote>>::value, "");
+static_assert(mserialize::detail::is_sequence_batch_serializable<std::array<QuotePair, 4>>::value, "");
+static_assert(! mserialize::detail::is_sequence_batch_serializable<std::vector<PaddedQuote>>::value, "");
+
+TEST_CASE("bitwise_struct")
+{
+  const Quote in{-123456789012, 100, 1};
+  const Quote out = roundtrip(in);
+  CHECK(in == out);
+  CHECK(mserialize::serialized_size(in) == sizeof(Quote));
+}
+
+TEST_CASE("bitwise_struct_member_order")
+{
+  // members are adapted in a different order than declared,
+  // the serialized form must follow the adapted order.
+  const ReorderedQuote in{-5, 6, 7};
+
+  std::stringstream stream;
+  stream.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+  mserialize::serialize(in, stream);
+
+  std::int32_t side = 0;
+  std::int64_t px = 0;
+  std::int32_t qty = 0;
+  mserialize::deserialize(side, stream);
+  mserialize::deserialize(px, stream);
+  mserialize::deserialize(qty, stream);
+  CHECK(side == 7);
+  CHECK(px == -5);
+  CHECK(qty == 6);
+
+  const ReorderedQuote out = roundtrip(in);
+  CHECK(in == out);
+}
+
+TEST_CASE("padded_struct")
+{
+  const PaddedQuote in{-8, 9};
+  const PaddedQuote out = roundtrip(in);
+  CHECK(in == out);
+  CHECK(mserialize::serialized_size(in) == sizeof(std::int64_t) + sizeof(std::int32_t));
+}
+
+TEST_CASE("sequence_of_bitwise_structs")
+{
+  const std::vector<Quote> in{{1, 2, 3}, {-4, -5, -6}, {7, 8, 9}};
+  const std::vector<Quote> out = roundtrip(in);
+  CHECK(in == out);
+
+  const std::vector<QuotePair> in2{{{1, 2, 3}, {4, 5, 6}}, {{-1, -2, -3}, {-4, -5, -6}}};
+  const std::vector<QuotePair> out2 = roundtrip(in2);
+  CHECK(in2 == out2);
+
+  const std::vector<ReorderedQuote> in3{{1, 2, 3}, {4, 5, 6}};
+  const std::vector<ReorderedQuote> out3 = roundtrip(in3);
+  CHECK(in3 == out3);
+}
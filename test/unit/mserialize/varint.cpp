@@ -0,0 +1,172 @@
+#include "test_streams.hpp"
+
+#include <mserialize/detail/varint.hpp>
+#include <mserialize/visit.hpp>
+
+#include <doctest/doctest.h>
+
+#include <algorithm> // copy
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// InputStream which exposes the underlying buffer,
+// to exercise the SWAR decoder
+class ViewStream
+{
+  const char* _begin;
+  const char* _end;
+
+public:
+  explicit ViewStream(const std::string& buffer)
+    :_begin(buffer.data()),
+     _end(buffer.data() + buffer.size())
+  {}
+
+  std::size_t size() const { return std::size_t(_end - _begin); }
+
+  const char* view(std::size_t size)
+  {
+    if (size > this->size()) { throw std::runtime_error("ViewStream overflow"); }
+    const char* result = _begin;
+    _begin += size;
+    return result;
+  }
+
+  ViewStream& read(char* buf, std::streamsize size)
+  {
+    const char* src = view(std::size_t(size));
+    std::copy(src, src + size, buf);
+    return *this;
+  }
+};
+
+static_assert(mserialize::detail::has_contiguous_view<ViewStream>::value, "");
+static_assert(! mserialize::detail::has_contiguous_view<InputStream>::value, "");
+
+std::string encode(std::uint64_t v)
+{
+  char buffer[mserialize::detail::max_varint_size];
+  char* end = mserialize::detail::write_varint(v, buffer);
+  return std::string(buffer, end);
+}
+
+const std::vector<std::uint64_t> g_values{
+  0, 1, 127, 128, 255, 300, 16383, 16384,
+  (std::uint64_t(1) << 49) - 1, std::uint64_t(1) << 49,
+  (std::uint64_t(1) << 56) - 1, std::uint64_t(1) << 56,
+  (std::uint64_t(1) << 63) - 1, std::uint64_t(1) << 63,
+  std::numeric_limits<std::uint64_t>::max(),
+};
+
+struct IntegerVisitor
+{
+  std::uint64_t u = 0;
+  std::int64_t s = 0;
+
+  void visit(std::uint64_t v) { u = v; }
+  void visit(std::int64_t v) { s = v; }
+
+  template <typename T>
+  void visit(T) { FAIL("Unexpected visit of T"); }
+
+  template <typename T>
+  bool visit(T, ViewStream&) { FAIL("Unexpected visit of T"); return false; }
+};
+
+} // namespace
+
+TEST_CASE("zigzag")
+{
+  using mserialize::detail::zigzag_encode;
+  using mserialize::detail::zigzag_decode;
+
+  CHECK(zigzag_encode(0) == 0);
+  CHECK(zigzag_encode(-1) == 1);
+  CHECK(zigzag_encode(1) == 2);
+  CHECK(zigzag_encode(-2) == 3);
+  CHECK(zigzag_encode(std::numeric_limits<std::int64_t>::max()) == std::numeric_limits<std::uint64_t>::max() - 1);
+  CHECK(zigzag_encode(std::numeric_limits<std::int64_t>::min()) == std::numeric_limits<std::uint64_t>::max());
+
+  for (const std::int64_t v : {std::int64_t(0), std::int64_t(-1), std::int64_t(123), std::int64_t(-123456789),
+         std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min()})
+  {
+    CHECK(zigzag_decode(zigzag_encode(v)) == v);
+  }
+}
+
+TEST_CASE("varint_encoding")
+{
+  CHECK(encode(0) == std::string(1, '\0'));
+  CHECK(encode(1) == "\x01");
+  CHECK(encode(127) == "\x7F");
+  CHECK(encode(128) == "\x80\x01");
+  CHECK(encode(300) == "\xAC\x02");
+
+  for (const std::uint64_t v : g_values)
+  {
+    CHECK(encode(v).size() == mserialize::detail::varint_size(v));
+  }
+
+  CHECK(mserialize::detail::varint_size(std::numeric_limits<std::uint64_t>::max()) == mserialize::detail::max_varint_size);
+}
+
+TEST_CASE("varint_read_bytewise")
+{
+  for (const std::uint64_t v : g_values)
+  {
+    std::stringstream stream(encode(v) + "tail");
+    InputStream istream{stream};
+    CHECK(mserialize::detail::read_varint(istream) == v);
+
+    std::string tail(4, ' ');
+    istream.read(&tail[0], 4);
+    CHECK(tail == "tail");
+  }
+}
+
+TEST_CASE("varint_read_view")
+{
+  // with enough trailing bytes, short values take the SWAR path,
+  // without them, every value takes the bytewise path.
+  for (const std::string& padding : {std::string(8, '\xFF'), std::string()})
+  {
+    for (const std::uint64_t v : g_values)
+    {
+      const std::string buffer = encode(v) + padding;
+      ViewStream istream(buffer);
+      CHECK(mserialize::detail::read_varint(istream) == v);
+      CHECK(istream.size() == padding.size());
+    }
+  }
+}
+
+TEST_CASE("varint_too_long")
+{
+  const std::string buffer(11, '\x80');
+
+  std::stringstream stream(buffer);
+  InputStream istream{stream};
+  CHECK_THROWS_AS(mserialize::detail::read_varint(istream), std::runtime_error);
+
+  ViewStream vstream(buffer);
+  CHECK_THROWS_AS(mserialize::detail::read_varint(vstream), std::runtime_error);
+}
+
+TEST_CASE("visit_varint")
+{
+  const std::string buffer = encode(300) + encode(mserialize::detail::zigzag_encode(-300));
+  ViewStream istream(buffer);
+
+  IntegerVisitor visitor;
+  mserialize::visit("v", visitor, istream);
+  mserialize::visit("z", visitor, istream);
+  CHECK(visitor.u == 300);
+  CHECK(visitor.s == -300);
+}